@@ -0,0 +1,273 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Benchmarks of reading synthetic ROS 1 bags through the storage plugin and of converting their
+// messages. The options of the storage are read from the environment as usual, so e.g.
+//   ROSBAG2_BAG_V2_PREFETCH_CHUNKS=4 rosbag2_bag_v2_benchmarks
+// measures prefetching. Google benchmark flags such as --benchmark_filter=read_next apply.
+
+#include <benchmark/benchmark.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "boost/make_shared.hpp"
+#include "ros/message_traits.h"
+#include "rosbag/bag.h"
+#include "rosbag2_cpp/types/introspection_message.hpp"
+#include "rosbag2_storage/serialized_bag_message.hpp"
+#include "std_msgs/String.h"
+#include "std_msgs/msg/string.hpp"
+
+#include "rosbag2_bag_v2_plugins/converter/rosbag_v2_deserializer.hpp"
+#include "rosbag2_bag_v2_plugins/storage/rosbag_v2_storage.hpp"
+
+namespace
+{
+
+// Every bag holds about this much message data, so that small messages make for many messages
+constexpr size_t BAG_MESSAGE_BYTES = 16 * 1024 * 1024;
+constexpr size_t MIN_MESSAGE_COUNT = 16;
+
+struct SyntheticBagOptions
+{
+  size_t topic_count;
+  size_t connections_per_topic;
+  size_t message_size;
+  rosbag::compression::CompressionType compression;
+
+  size_t get_message_count() const
+  {
+    return std::max(BAG_MESSAGE_BYTES / std::max<size_t>(message_size, 1), MIN_MESSAGE_COUNT);
+  }
+
+  bool operator<(const SyntheticBagOptions & other) const
+  {
+    return std::tie(topic_count, connections_per_topic, message_size, compression) <
+           std::tie(
+      other.topic_count, other.connections_per_topic, other.message_size, other.compression);
+  }
+};
+
+SyntheticBagOptions get_bag_options(const benchmark::State & state)
+{
+  return {
+    static_cast<size_t>(state.range(0)),
+    static_cast<size_t>(state.range(1)),
+    static_cast<size_t>(state.range(2)),
+    static_cast<rosbag::compression::CompressionType>(state.range(3))};
+}
+
+/**
+ * Bags of std_msgs/String messages written with rosbag_storage into a temporary directory, each
+ * one once per process. Messages are spread evenly over the topics and connections of a bag.
+ */
+class SyntheticBags
+{
+public:
+  static SyntheticBags & get_instance()
+  {
+    static SyntheticBags bags;
+    return bags;
+  }
+
+  ~SyntheticBags()
+  {
+    for (const auto & bag : bag_paths_) {
+      std::remove(bag.second.c_str());
+    }
+    rmdir(directory_.c_str());
+  }
+
+  const std::string & get_path(const SyntheticBagOptions & options)
+  {
+    auto it = bag_paths_.find(options);
+    if (it == bag_paths_.end()) {
+      it = bag_paths_.emplace(options, write_bag(options)).first;
+    }
+    return it->second;
+  }
+
+private:
+  SyntheticBags()
+  {
+    auto temporary_directory = std::getenv("TMPDIR");
+    std::string directory_template =
+      std::string(temporary_directory ? temporary_directory : "/tmp") +
+      "/rosbag2_bag_v2_benchmarks_XXXXXX";
+    if (!mkdtemp(&directory_template[0])) {
+      throw std::runtime_error("Could not create a directory for the benchmark bags");
+    }
+    directory_ = directory_template;
+  }
+
+  std::string write_bag(const SyntheticBagOptions & options) const
+  {
+    auto path = directory_ + "/bag_" + std::to_string(bag_paths_.size()) + ".bag";
+    rosbag::Bag bag;
+    bag.open(path, rosbag::bagmode::Write);
+    bag.setCompression(options.compression);
+
+    // rosbag_storage creates a connection per distinct connection header of a topic
+    std::vector<boost::shared_ptr<ros::M_string>> connection_headers;
+    for (size_t i = 0; i < options.connections_per_topic; ++i) {
+      auto header = boost::make_shared<ros::M_string>();
+      (*header)["callerid"] = "/writer_" + std::to_string(i);
+      (*header)["type"] = ros::message_traits::datatype<std_msgs::String>();
+      (*header)["md5sum"] = ros::message_traits::md5sum<std_msgs::String>();
+      (*header)["message_definition"] = ros::message_traits::definition<std_msgs::String>();
+      connection_headers.push_back(header);
+    }
+
+    std_msgs::String message;
+    auto message_count = options.get_message_count();
+    for (size_t i = 0; i < message_count; ++i) {
+      // Varying content keeps compressed bags from shrinking to nothing
+      message.data.assign(options.message_size, static_cast<char>('a' + i % 26));
+      auto topic = "/topic_" + std::to_string(i % options.topic_count);
+      auto time = ros::Time().fromNSec(1000000000ull + i * 1000000ull);
+      bag.write(
+        topic, time, message,
+        connection_headers[(i / options.topic_count) % options.connections_per_topic]);
+    }
+    bag.close();
+    return path;
+  }
+
+  std::string directory_;
+  std::map<SyntheticBagOptions, std::string> bag_paths_;
+};
+
+std::unique_ptr<rosbag2_bag_v2_plugins::RosbagV2Storage> open_storage(const std::string & path)
+{
+  auto storage = std::make_unique<rosbag2_bag_v2_plugins::RosbagV2Storage>();
+  storage->open(path, rosbag2_storage::storage_interfaces::IOFlag::READ_ONLY);
+  return storage;
+}
+
+void set_processed(benchmark::State & state, const SyntheticBagOptions & options)
+{
+  auto message_count = static_cast<int64_t>(options.get_message_count());
+  state.SetItemsProcessed(state.iterations() * message_count);
+  state.SetBytesProcessed(
+    state.iterations() * message_count * static_cast<int64_t>(options.message_size));
+}
+
+void open(benchmark::State & state)
+{
+  const auto & path = SyntheticBags::get_instance().get_path(get_bag_options(state));
+  for (auto _ : state) {
+    auto storage = open_storage(path);
+    benchmark::DoNotOptimize(storage);
+    // Closing the bag, e.g. stopping the prefetch threads, is not timed
+    state.PauseTiming();
+    storage.reset();
+    state.ResumeTiming();
+  }
+}
+
+void get_metadata(benchmark::State & state)
+{
+  const auto & path = SyntheticBags::get_instance().get_path(get_bag_options(state));
+  for (auto _ : state) {
+    // The metadata is computed once per opened bag
+    state.PauseTiming();
+    auto storage = open_storage(path);
+    state.ResumeTiming();
+    benchmark::DoNotOptimize(storage->get_metadata());
+    state.PauseTiming();
+    storage.reset();
+    state.ResumeTiming();
+  }
+}
+
+void read_next(benchmark::State & state)
+{
+  auto options = get_bag_options(state);
+  const auto & path = SyntheticBags::get_instance().get_path(options);
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto storage = open_storage(path);
+    state.ResumeTiming();
+    while (storage->has_next()) {
+      benchmark::DoNotOptimize(storage->read_next());
+    }
+    state.PauseTiming();
+    storage.reset();
+    state.ResumeTiming();
+  }
+  set_processed(state, options);
+}
+
+void deserialize(benchmark::State & state)
+{
+  auto options = get_bag_options(state);
+  auto storage = open_storage(SyntheticBags::get_instance().get_path(options));
+  if (storage->get_options().serialization_format != "rosbag_v2") {
+    state.SkipWithError("Only messages in the rosbag_v2 serialization format are deserialized");
+    return;
+  }
+  std::vector<std::shared_ptr<rosbag2_storage::SerializedBagMessage>> messages;
+  while (storage->has_next()) {
+    messages.push_back(storage->read_next());
+  }
+
+  rosbag2_bag_v2_plugins::RosbagV2Deserializer deserializer;
+  std_msgs::msg::String ros_message;
+  auto introspection_message = std::make_shared<rosbag2_cpp::rosbag2_introspection_message_t>();
+  introspection_message->message = &ros_message;
+  for (auto _ : state) {
+    for (const auto & message : messages) {
+      deserializer.deserialize(message, nullptr, introspection_message);
+    }
+    benchmark::ClobberMemory();
+  }
+  set_processed(state, options);
+}
+
+void synthetic_bags(benchmark::internal::Benchmark * benchmark)
+{
+  benchmark->ArgNames({"topics", "connections", "message_size", "compression"});
+  for (auto compression : {rosbag::compression::Uncompressed, rosbag::compression::BZ2,
+      rosbag::compression::LZ4})
+  {
+    benchmark->Args({1, 1, 1024, compression});
+  }
+  // Many small messages, few large ones
+  benchmark->Args({1, 1, 64, rosbag::compression::Uncompressed});
+  benchmark->Args({1, 1, 1024 * 1024, rosbag::compression::Uncompressed});
+  // Many topics and many connections, which mostly affect opening the bag
+  benchmark->Args({100, 1, 1024, rosbag::compression::Uncompressed});
+  benchmark->Args({10, 50, 1024, rosbag::compression::Uncompressed});
+  benchmark->Unit(benchmark::kMillisecond);
+}
+
+}  // namespace
+
+BENCHMARK(open)->Apply(synthetic_bags);
+BENCHMARK(get_metadata)->Apply(synthetic_bags);
+BENCHMARK(read_next)->Apply(synthetic_bags);
+BENCHMARK(deserialize)->Apply(synthetic_bags);
+
+BENCHMARK_MAIN();
@@ -17,16 +17,352 @@ import os
 import sys
 
 from ros1_bridge import generate_messages
+from ros1_bridge import load_ros1_message
+from ros1_bridge import load_ros2_message
 from rosidl_cmake import expand_template
+from rosidl_parser.definition import AbstractNestedType
+from rosidl_parser.definition import Array
+from rosidl_parser.definition import BasicType
+from rosidl_parser.definition import NamespacedType
+from rosidl_parser.definition import UnboundedSequence
+from rosidl_parser.definition import UnboundedString
 
+# Wire representation (kind, size in bytes) of primitive types. Only fields of the same
+# representation can be copied from ROS 1 into CDR as they are.
+ROS1_PRIMITIVE_TYPES = {
+    'bool': ('bool', 1),
+    'byte': ('integer', 1),
+    'char': ('integer', 1),
+    'int8': ('integer', 1),
+    'uint8': ('integer', 1),
+    'int16': ('integer', 2),
+    'uint16': ('integer', 2),
+    'int32': ('integer', 4),
+    'uint32': ('integer', 4),
+    'int64': ('integer', 8),
+    'uint64': ('integer', 8),
+    'float32': ('float', 4),
+    'float64': ('float', 8),
+}
+ROS2_BASIC_TYPES = {
+    'boolean': ('bool', 1),
+    'octet': ('integer', 1),
+    'char': ('integer', 1),
+    'int8': ('integer', 1),
+    'uint8': ('integer', 1),
+    'int16': ('integer', 2),
+    'uint16': ('integer', 2),
+    'int32': ('integer', 4),
+    'uint32': ('integer', 4),
+    'int64': ('integer', 8),
+    'uint64': ('integer', 8),
+    'float': ('float', 4),
+    'double': ('float', 8),
+}
+# ROS 1 time and duration are two 32 bit integers, just like their builtin_interfaces counterparts
+ROS1_TIME_TYPES = {
+    'time': 'builtin_interfaces/msg/Time',
+    'duration': 'builtin_interfaces/msg/Duration',
+}
+ROS1_TIME_PLAN = 'ros1_time_cdr_plan'
+ROS1_TIME_SIZE = 8
+# Added by rosidl to messages without fields
+ROS2_EMPTY_STRUCTURE_MEMBER = 'structure_needs_at_least_one_member'
 
-def generate_cpp(output_path, template_dir):
+
+class CdrField:
+    """
+    A field of a CdrTranscoderPlan (see cdr_transcoder.hpp).
+
+    The same fields drive the generated read_ros1_message functions, which read ROS 1 messages
+    straight into ROS 2 messages (see ros1_wire_reader.hpp).
+    """
+
+    def __init__(
+        self, name, kind, primitive_size=0, array_kind='NONE', array_size=0, message_index=None,
+        presence='BOTH', ros2_name=None
+    ):
+        self.name = name
+        self.ros2_name = ros2_name
+        self.kind = kind
+        self.primitive_size = primitive_size
+        self.array_kind = array_kind
+        self.array_size = array_size
+        # Index of the mapping of a nested message, None for ROS 1 time and duration
+        self.message_index = message_index
+        if kind != 'MESSAGE':
+            self.message = 'nullptr'
+        elif message_index is None:
+            self.message = '&' + ROS1_TIME_PLAN
+        else:
+            self.message = '&cdr_plan_%d' % message_index
+        # Minimum size of the nested message on the wire, set by get_cdr_plans for other messages
+        # than ROS 1 time and duration
+        self.message_ros1_size = ROS1_TIME_SIZE if message_index is None else None
+        self.presence = presence
+
+    def get_ros1_min_size(self, get_message_ros1_size):
+        """Return the number of bytes the field takes at least in a ROS 1 message."""
+        if self.presence == 'ROS2_ONLY':
+            return 0
+        if self.array_kind == 'SEQUENCE':
+            return 4
+        if self.kind == 'PRIMITIVE':
+            size = self.primitive_size
+        elif self.kind == 'STRING':
+            size = 4
+        elif self.message_index is None:
+            size = ROS1_TIME_SIZE
+        else:
+            size = get_message_ros1_size(self.message_index)
+        if self.array_kind == 'FIXED_SIZE':
+            size *= self.array_size
+        return size
+
+    def get_read_statement(self):
+        """Return the C++ statement reading the field in read_ros1_message."""
+        if self.presence == 'ROS2_ONLY':
+            return '// Only exists in ROS 2, left as initialized'
+        if self.presence == 'ROS1_ONLY':
+            return self._get_skip_statement()
+
+        ros2_field = 'ros2_message.' + self.ros2_name
+        if self.kind != 'MESSAGE':
+            return 'reader.read(%s);' % ros2_field
+        if self.message_index is None:
+            read_function = 'read_ros1_time'
+        else:
+            read_function = 'read_ros1_message_%d' % self.message_index
+        if self.array_kind == 'NONE':
+            return '%s(reader, %s);' % (read_function, ros2_field)
+        return 'reader.read_messages(%s, &%s, %d);' % (
+            ros2_field, read_function, self.message_ros1_size)
+
+    def _get_skip_statement(self):
+        if self.kind == 'STRING':
+            if self.array_kind == 'SEQUENCE':
+                return 'reader.skip_strings(reader.read_length());'
+            return 'reader.skip_strings(%d);' % (
+                self.array_size if self.array_kind == 'FIXED_SIZE' else 1)
+        # Primitives and ROS 1 time and duration have a fixed size
+        size = self.primitive_size if self.kind == 'PRIMITIVE' else ROS1_TIME_SIZE
+        if self.array_kind == 'SEQUENCE':
+            return 'reader.skip_sequence(%d);' % size
+        if self.array_kind == 'FIXED_SIZE':
+            size *= self.array_size
+        return 'reader.skip(%d);' % size
+
+
+def mapping_sort_key(mapping):
+    ros1_type_name = '%s/%s' % (mapping.ros1_msg.package_name, mapping.ros1_msg.message_name)
+    ros2_type_name = '%s/msg/%s' % (mapping.ros2_msg.package_name, mapping.ros2_msg.message_name)
+    return (ros1_type_name, ros2_type_name)
+
+
+def get_ros1_type_name(base_type, package_name):
+    if '/' in base_type:
+        return base_type
+    if base_type == 'Header':
+        return 'std_msgs/Header'
+    return '%s/%s' % (package_name, base_type)
+
+
+def get_ros2_type_name(ros2_type):
+    if not isinstance(ros2_type, NamespacedType):
+        return None
+    return '/'.join(list(ros2_type.namespaces) + [ros2_type.name])
+
+
+def make_cdr_field(ros1_field, ros2_member, package_name, get_nested_plan):
+    """
+    Describe how to transcode a ROS 1 field into a ROS 2 member.
+
+    If ros2_member is None, the field only exists in ROS 1 and is skipped.
+    Returns None if the field cannot be transcoded without deserializing it.
+    """
+    ros2_type = ros2_member.type if ros2_member is not None else None
+    ros2_name = ros2_member.name if ros2_member is not None else None
+    presence = 'BOTH' if ros2_type is not None else 'ROS1_ONLY'
+    array_kind = 'NONE'
+    array_size = 0
+    if ros1_field.is_array:
+        if ros1_field.array_len is None:
+            if ros2_type is not None and not isinstance(ros2_type, UnboundedSequence):
+                return None
+            array_kind = 'SEQUENCE'
+        else:
+            if ros2_type is not None and (
+                not isinstance(ros2_type, Array) or ros2_type.size != ros1_field.array_len
+            ):
+                return None
+            array_kind = 'FIXED_SIZE'
+            array_size = ros1_field.array_len
+        if ros2_type is not None:
+            ros2_type = ros2_type.value_type
+    elif isinstance(ros2_type, AbstractNestedType):
+        return None
+
+    base_type = ros1_field.base_type
+    if base_type in ROS1_PRIMITIVE_TYPES:
+        if ros2_type is not None and (
+            not isinstance(ros2_type, BasicType) or
+            ROS2_BASIC_TYPES.get(ros2_type.typename) != ROS1_PRIMITIVE_TYPES[base_type]
+        ):
+            return None
+        return CdrField(
+            ros1_field.name, 'PRIMITIVE', ROS1_PRIMITIVE_TYPES[base_type][1], array_kind,
+            array_size, presence=presence, ros2_name=ros2_name)
+
+    if base_type == 'string':
+        if ros2_type is not None and not isinstance(ros2_type, UnboundedString):
+            return None
+        return CdrField(
+            ros1_field.name, 'STRING', array_kind=array_kind, array_size=array_size,
+            presence=presence, ros2_name=ros2_name)
+
+    if base_type in ROS1_TIME_TYPES:
+        if ros2_type is not None and get_ros2_type_name(ros2_type) != ROS1_TIME_TYPES[base_type]:
+            return None
+        message_index = None
+    elif ros2_type is None:
+        # Skipping nested ROS 1 messages would need a plan of the ROS 1 message alone
+        return None
+    else:
+        message_index = get_nested_plan(
+            get_ros1_type_name(base_type, package_name), get_ros2_type_name(ros2_type))
+        if message_index is None:
+            return None
+    return CdrField(
+        ros1_field.name, 'MESSAGE', array_kind=array_kind, array_size=array_size,
+        message_index=message_index, presence=presence, ros2_name=ros2_name)
+
+
+def make_cdr_fields(mapping, get_nested_plan):
+    """
+    Describe how to transcode messages of a mapping into CDR.
+
+    This requires the ROS 2 members to match the ROS 1 fields in the same order, apart from ROS 1
+    fields without a ROS 2 counterpart, like the seq of a std_msgs/Header.
+    Returns None if the messages have to be converted by the ros1_bridge factory.
+    """
+    ros1_spec = load_ros1_message(mapping.ros1_msg)
+    ros2_spec = load_ros2_message(mapping.ros2_msg)
+    if not ros1_spec or not ros2_spec:
+        return None
+
+    ros2_members_by_ros1_field = {}
+    for ros1_fields, ros2_members in mapping.fields_1_to_2.items():
+        # Manual mapping rules may map nested fields, which changes the layout
+        if len(ros1_fields) != 1 or len(ros2_members) != 1:
+            return None
+        ros2_members_by_ros1_field[ros1_fields[0].name] = ros2_members[0]
+
+    ros2_members = ros2_spec.structure.members
+    next_ros2_member = 0
+    fields = []
+    for ros1_field in ros1_spec.parsed_fields():
+        ros2_member = ros2_members_by_ros1_field.get(ros1_field.name)
+        if ros2_member is not None:
+            if (
+                next_ros2_member == len(ros2_members) or
+                ros2_members[next_ros2_member].name != ros2_member.name
+            ):
+                return None
+            next_ros2_member += 1
+        field = make_cdr_field(
+            ros1_field, ros2_member, mapping.ros1_msg.package_name, get_nested_plan)
+        if field is None:
+            return None
+        fields.append(field)
+
+    for ros2_member in ros2_members[next_ros2_member:]:
+        if ros2_member.name != ROS2_EMPTY_STRUCTURE_MEMBER:
+            return None
+        fields.append(CdrField(
+            ros2_member.name, 'PRIMITIVE', 1, presence='ROS2_ONLY', ros2_name=ros2_member.name))
+    return fields
+
+
+def get_cdr_plans(mappings):
+    """Return the fields of the CDR plan of each mapping index which has one."""
+    mapping_indices = {mapping_sort_key(m): index for index, m in enumerate(mappings)}
+    plans = {}
+
+    def get_plan(index):
+        if index not in plans:
+            # Marking the plan as missing beforehand cannot loop on recursive definitions
+            plans[index] = None
+            plans[index] = make_cdr_fields(mappings[index], get_nested_plan)
+        return plans[index]
+
+    def get_nested_plan(ros1_type_name, ros2_type_name):
+        index = mapping_indices.get((ros1_type_name, ros2_type_name))
+        if index is None or get_plan(index) is None:
+            return None
+        return index
+
+    for index in range(len(mappings)):
+        get_plan(index)
+    plans = {index: fields for index, fields in plans.items() if fields is not None}
+
+    # Nested messages cannot contain themselves, as their plan would have been missing
+    ros1_sizes = {}
+
+    def get_message_ros1_size(index):
+        if index not in ros1_sizes:
+            ros1_sizes[index] = sum(
+                field.get_ros1_min_size(get_message_ros1_size) for field in plans[index])
+        return ros1_sizes[index]
+
+    for fields in plans.values():
+        for field in fields:
+            if field.kind == 'MESSAGE' and field.message_index is not None:
+                field.message_ros1_size = get_message_ros1_size(field.message_index)
+    return plans
+
+
+def get_nested_plan_indices(mapping_index, cdr_plans):
+    """Return the index and the indices of all messages nested in the CDR plan of a mapping."""
+    indices = set()
+    pending = [mapping_index]
+    while pending:
+        index = pending.pop()
+        if index in indices or index not in cdr_plans:
+            continue
+        indices.add(index)
+        pending.extend(
+            field.message_index for field in cdr_plans[index]
+            if field.message_index is not None)
+    return indices
+
+
+def generate_cpp(output_path, template_dir, ros1_packages):
     data = generate_messages()
 
     template_file = os.path.join(template_dir, 'convert_rosbag_message.cpp.em')
-    output_file = os.path.join(output_path, 'convert_rosbag_message.cpp')
-    data_for_template = {'mappings': data['mappings']}
-    expand_template(template_file, data_for_template, output_file)
+    # Indices of the mappings name the generated functions, sorting keeps them stable from one
+    # build to the next
+    mappings = sorted(data['mappings'], key=mapping_sort_key)
+    cdr_plans = get_cdr_plans(mappings)
+
+    # One translation unit per ROS 1 package, so that packages are compiled in parallel and can be
+    # built into libraries of their own. Each one gets the mappings of its package and the plans of
+    # all messages nested in them.
+    for package_name in ros1_packages:
+        package_indices = [
+            index for index, m in enumerate(mappings)
+            if m.ros1_msg.package_name == package_name]
+        plan_indices = set()
+        for index in package_indices:
+            plan_indices |= get_nested_plan_indices(index, cdr_plans)
+        data_for_template = {
+            'package_name': package_name,
+            'mappings': mappings,
+            'package_indices': package_indices,
+            'cdr_plans': {index: cdr_plans[index] for index in plan_indices},
+        }
+        output_file = os.path.join(output_path, 'convert_rosbag_message_%s.cpp' % package_name)
+        expand_template(template_file, data_for_template, output_file)
 
 
 def main(argv=sys.argv[1:]):
@@ -41,10 +377,15 @@ def main(argv=sys.argv[1:]):
         '--template-dir',
         required=True,
         help='The location of the template file')
+    parser.add_argument(
+        '--ros1-packages',
+        nargs='*',
+        default=[],
+        help='The ROS 1 packages whose mappings are generated, one C++ file per package')
     args = parser.parse_args(argv)
 
     try:
-        return generate_cpp(args.output_path, args.template_dir)
+        return generate_cpp(args.output_path, args.template_dir, args.ros1_packages)
     except RuntimeError as e:
         print(str(e), file=sys.stderr)
         return 1
@@ -0,0 +1,77 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "borrowed_message_buffer.hpp"
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "non_owning_uint8_array.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+namespace
+{
+
+// The serialized data comes first so a pointer to it is also a pointer to the whole buffer.
+struct BorrowedMessageBuffer
+{
+  rcutils_uint8_array_t serialized_data;
+  const ConverterHandle * converter;
+};
+
+static_assert(
+  std::is_standard_layout<BorrowedMessageBuffer>::value,
+  "BorrowedMessageBuffer must be reachable from its serialized data");
+
+struct BorrowedMessageOwner
+{
+  BorrowedMessageBuffer buffer;
+  std::shared_ptr<const Chunk> chunk;
+};
+
+// The allocator state of borrowed data points here. A writable object has an address of its own,
+// unlike functions which identical code folding may merge with other functions.
+char borrowed_message_marker;
+
+}  // namespace
+
+std::shared_ptr<rcutils_uint8_array_t> make_borrowed_message_buffer(
+  std::shared_ptr<const Chunk> chunk,
+  const ChunkMessage & message,
+  const ConverterHandle * converter)
+{
+  auto owner = std::make_shared<BorrowedMessageOwner>();
+  owner->chunk = std::move(chunk);
+  owner->buffer.converter = converter;
+  owner->buffer.serialized_data = make_non_owning_uint8_array(
+    const_cast<uint8_t *>(owner->chunk->get_data() + message.data_offset),
+    message.data_length,
+    &borrowed_message_marker);
+
+  return std::shared_ptr<rcutils_uint8_array_t>(owner, &owner->buffer.serialized_data);
+}
+
+const ConverterHandle * get_borrowed_message_converter(
+  const rcutils_uint8_array_t & serialized_data)
+{
+  if (serialized_data.allocator.state != &borrowed_message_marker) {
+    return nullptr;
+  }
+  return reinterpret_cast<const BorrowedMessageBuffer *>(&serialized_data)->converter;
+}
+
+}  // namespace rosbag2_bag_v2_plugins
@@ -0,0 +1,49 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROSBAG2_BAG_V2_PLUGINS__BORROWED_MESSAGE_BUFFER_HPP_
+#define ROSBAG2_BAG_V2_PLUGINS__BORROWED_MESSAGE_BUFFER_HPP_
+
+#include <memory>
+
+#include "rcutils/types/uint8_array.h"
+
+#include "converter_handle.hpp"
+#include "storage/bag_chunk.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+/**
+ * Creates serialized data which points directly at a message inside a decompressed chunk.
+ *
+ * The returned array keeps the chunk alive. It carries no type prefix, the converter is stored
+ * alongside it instead and can be queried with get_borrowed_message_converter. The array must not
+ * be resized, its allocator refuses all allocations.
+ */
+std::shared_ptr<rcutils_uint8_array_t> make_borrowed_message_buffer(
+  std::shared_ptr<const Chunk> chunk,
+  const ChunkMessage & message,
+  const ConverterHandle * converter);
+
+/**
+ * \returns the converter of serialized data created by make_borrowed_message_buffer, or nullptr if
+ * the data was not borrowed from a chunk
+ */
+const ConverterHandle * get_borrowed_message_converter(
+  const rcutils_uint8_array_t & serialized_data);
+
+}  // namespace rosbag2_bag_v2_plugins
+
+#endif  // ROSBAG2_BAG_V2_PLUGINS__BORROWED_MESSAGE_BUFFER_HPP_
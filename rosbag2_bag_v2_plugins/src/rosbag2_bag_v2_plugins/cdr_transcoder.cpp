@@ -0,0 +1,216 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "cdr_transcoder.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "storage/bag_format.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+namespace
+{
+
+// Little endian CDR, the representation of rmw_serialize on little endian hosts
+constexpr uint8_t CDR_ENCAPSULATION_HEADER[] = {0x00, 0x01, 0x00, 0x00};
+constexpr size_t CDR_ENCAPSULATION_HEADER_LENGTH = sizeof(CDR_ENCAPSULATION_HEADER);
+
+class Ros1MessageReader
+{
+public:
+  Ros1MessageReader(const uint8_t * data, size_t length)
+  : position_(data), end_(data + length) {}
+
+  const uint8_t * read_bytes(size_t length)
+  {
+    if (remaining() < length) {
+      throw std::runtime_error("Serialized ROS 1 message is truncated");
+    }
+    auto bytes = position_;
+    position_ += length;
+    return bytes;
+  }
+
+  uint32_t read_uint32()
+  {
+    return bag_format::read_uint32(read_bytes(4));
+  }
+
+  size_t remaining() const
+  {
+    return static_cast<size_t>(end_ - position_);
+  }
+
+private:
+  const uint8_t * position_;
+  const uint8_t * end_;
+};
+
+// Appends to the CDR message, aligning every primitive to its size relative to the end of the
+// encapsulation header
+class CdrMessageWriter
+{
+public:
+  CdrMessageWriter(rcutils_uint8_array_t & message, size_t expected_length)
+  : message_(message), length_(0)
+  {
+    reserve(expected_length);
+    memcpy(advance(CDR_ENCAPSULATION_HEADER_LENGTH), CDR_ENCAPSULATION_HEADER,
+      CDR_ENCAPSULATION_HEADER_LENGTH);
+  }
+
+  void align(size_t alignment)
+  {
+    auto padding = (alignment - (length_ - CDR_ENCAPSULATION_HEADER_LENGTH) % alignment) %
+      alignment;
+    memset(advance(padding), 0, padding);
+  }
+
+  uint8_t * advance(size_t size)
+  {
+    reserve(length_ + size);
+    auto data = message_.buffer + length_;
+    length_ += size;
+    return data;
+  }
+
+  void write_uint32(uint32_t value)
+  {
+    align(4);
+    auto bytes = advance(4);
+    for (size_t i = 0; i < 4; ++i) {
+      bytes[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+  }
+
+  void finish()
+  {
+    message_.buffer_length = length_;
+  }
+
+private:
+  void reserve(size_t capacity)
+  {
+    if (capacity > message_.buffer_capacity) {
+      auto new_capacity = std::max(capacity, 2 * message_.buffer_capacity);
+      auto ret = rcutils_uint8_array_resize(&message_, new_capacity);
+      if (ret != RCUTILS_RET_OK) {
+        throw std::runtime_error("No memory available. Error code " + std::to_string(ret));
+      }
+    }
+  }
+
+  rcutils_uint8_array_t & message_;
+  size_t length_;
+};
+
+// Fields which only exist in the ROS 1 message are read without a writer
+void transcode_message(
+  const CdrTranscoderPlan & plan, Ros1MessageReader & reader, CdrMessageWriter * writer);
+
+void transcode_primitives(
+  const CdrFieldPlan & field, uint32_t count, Ros1MessageReader & reader, CdrMessageWriter * writer)
+{
+  // Elements of primitive arrays are not padded, so the whole array is copied at once
+  if (count > reader.remaining() / field.primitive_size) {
+    throw std::runtime_error("Serialized ROS 1 message is truncated");
+  }
+  auto length = static_cast<size_t>(count) * field.primitive_size;
+  auto data = reader.read_bytes(length);
+  // Like Fast-CDR, empty arrays are not aligned, as there is no element to align
+  if (writer && count > 0) {
+    writer->align(field.primitive_size);
+    memcpy(writer->advance(length), data, length);
+  }
+}
+
+void transcode_field(
+  const CdrFieldPlan & field, Ros1MessageReader & reader, CdrMessageWriter * writer)
+{
+  if (field.presence == CdrFieldPresence::ROS2_ONLY) {
+    if (writer) {
+      writer->align(field.primitive_size);
+      memset(writer->advance(field.primitive_size), 0, field.primitive_size);
+    }
+    return;
+  }
+
+  uint32_t count = 1;
+  if (field.array_kind == CdrArrayKind::FIXED_SIZE) {
+    count = field.array_size;
+  } else if (field.array_kind == CdrArrayKind::SEQUENCE) {
+    count = reader.read_uint32();
+    if (writer) {
+      writer->write_uint32(count);
+    }
+  }
+
+  switch (field.kind) {
+    case CdrFieldKind::PRIMITIVE:
+      transcode_primitives(field, count, reader, writer);
+      break;
+    case CdrFieldKind::STRING:
+      for (uint32_t i = 0; i < count; ++i) {
+        auto length = reader.read_uint32();
+        auto data = reader.read_bytes(length);
+        if (writer) {
+          // CDR strings include their null terminator
+          writer->write_uint32(length + 1);
+          auto string = writer->advance(length + 1);
+          memcpy(string, data, length);
+          string[length] = '\0';
+        }
+      }
+      break;
+    case CdrFieldKind::MESSAGE:
+      for (uint32_t i = 0; i < count; ++i) {
+        transcode_message(*field.message, reader, writer);
+      }
+      break;
+  }
+}
+
+void transcode_message(
+  const CdrTranscoderPlan & plan, Ros1MessageReader & reader, CdrMessageWriter * writer)
+{
+  for (size_t i = 0; i < plan.field_count; ++i) {
+    const auto & field = plan.fields[i];
+    auto field_writer = field.presence == CdrFieldPresence::ROS1_ONLY ? nullptr : writer;
+    transcode_field(field, reader, field_writer);
+  }
+}
+
+}  // namespace
+
+void transcode_to_cdr(
+  const CdrTranscoderPlan & plan,
+  const uint8_t * ros1_message, size_t ros1_message_length,
+  rcutils_uint8_array_t & cdr_message)
+{
+  Ros1MessageReader reader(ros1_message, ros1_message_length);
+  // Strings grow by their null terminator and fields may be padded, usually by only a few bytes
+  auto expected_length =
+    CDR_ENCAPSULATION_HEADER_LENGTH + ros1_message_length + ros1_message_length / 8 + 64;
+  CdrMessageWriter writer(cdr_message, expected_length);
+  transcode_message(plan, reader, &writer);
+  writer.finish();
+}
+
+}  // namespace rosbag2_bag_v2_plugins
@@ -0,0 +1,95 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef ROSBAG2_BAG_V2_PLUGINS__CDR_TRANSCODER_HPP_
+#define ROSBAG2_BAG_V2_PLUGINS__CDR_TRANSCODER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "rcutils/types/uint8_array.h"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+/// Serialization format of messages transcoded by transcode_to_cdr
+constexpr const char CDR_SERIALIZATION_FORMAT[] = "cdr";
+
+enum class CdrFieldKind : uint8_t
+{
+  PRIMITIVE,
+  STRING,
+  MESSAGE
+};
+
+enum class CdrArrayKind : uint8_t
+{
+  NONE,
+  FIXED_SIZE,
+  SEQUENCE
+};
+
+enum class CdrFieldPresence : uint8_t
+{
+  /// Read from the ROS 1 message and written to the ROS 2 message
+  BOTH,
+  /// Only skipped in the ROS 1 message, e.g. the seq of a std_msgs/Header
+  ROS1_ONLY,
+  /// Only written as 0 to the ROS 2 message, e.g. the placeholder member of an empty message
+  ROS2_ONLY
+};
+
+struct CdrTranscoderPlan;
+
+struct CdrFieldPlan
+{
+  CdrFieldKind kind;
+  /// Size of a primitive in bytes, which is also its alignment in CDR
+  uint8_t primitive_size;
+  CdrArrayKind array_kind;
+  /// Number of elements of a fixed size array
+  uint32_t array_size;
+  /// Plan of the nested message, nullptr unless kind is MESSAGE
+  const CdrTranscoderPlan * message;
+  CdrFieldPresence presence;
+};
+
+/**
+ * Describes how to transcode a serialized ROS 1 message into CDR without deserializing it.
+ *
+ * The fields are listed in the order of the ROS 1 message definition. generate_converter_cpp.py
+ * emits a plan for every mapping whose ROS 2 members correspond to the ROS 1 fields in the same
+ * order and with the same wire representation, which holds for most common messages.
+ */
+struct CdrTranscoderPlan
+{
+  const CdrFieldPlan * fields;
+  size_t field_count;
+};
+
+/**
+ * Transcodes a serialized ROS 1 message into a serialized little endian CDR message, including
+ * the encapsulation header. Primitive arrays are copied with a single memcpy.
+ * \param cdr_message receives the CDR message, it is resized as needed
+ * \throws std::runtime_error if the ROS 1 message is truncated or no memory is available
+ */
+void transcode_to_cdr(
+  const CdrTranscoderPlan & plan,
+  const uint8_t * ros1_message, size_t ros1_message_length,
+  rcutils_uint8_array_t & cdr_message);
+
+}  // namespace rosbag2_bag_v2_plugins
+
+#endif  // ROSBAG2_BAG_V2_PLUGINS__CDR_TRANSCODER_HPP_
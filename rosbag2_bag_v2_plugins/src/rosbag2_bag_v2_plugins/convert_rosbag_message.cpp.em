@@ -15,22 +15,21 @@
 from ros1_bridge import camel_case_to_lower_case_underscore
 }@
 
-#include "convert_rosbag_message.hpp"
-
+// Converters of the mappings of the ROS 1 package @(package_name), registered when loaded, see
+// converter_registry.hpp
+#include <array>
 #include <cstdint>
-#include <memory>
-#include <string>
 
 #include "ros1_bridge/bridge.hpp"
 #include "ros1_bridge/factory_interface.hpp"
 
-#include "rclcpp/rclcpp.hpp"
-#include "rcutils/allocator.h"
-#include "rosbag2_storage/ros_helper.hpp"
-#include "rosbag2_cpp/typesupport_helpers.hpp"
-#include "rosbag2_cpp/types/introspection_message.hpp"
+#include "converter_registry.hpp"
+#include "ros1_wire_reader.hpp"
 
-@[for m in mappings]@
+@[for index in sorted(set(package_indices) | set(cdr_plans))]@
+@{
+m = mappings[index]
+}@
 #include "@(m.ros1_msg.package_name)/@(m.ros1_msg.message_name).h"
 #include "@(m.ros2_msg.package_name)/msg/@(camel_case_to_lower_case_underscore(m.ros2_msg.message_name)).hpp"
 @[end for]@
@@ -38,41 +37,125 @@ from ros1_bridge import camel_case_to_lower_case_underscore
 namespace rosbag2_bag_v2_plugins
 {
 
-bool get_1to2_mapping(const std::string & ros1_message_type, std::string & ros2_message_type)
+namespace
 {
-  return ros1_bridge::get_1to2_mapping(ros1_message_type, ros2_message_type);
+
+// Mappings with a CDR plan are read straight into the ROS 2 message, see ros1_wire_reader.hpp.
+// The read functions of nested messages may be defined further down. Nested messages of other
+// packages get their own copy here, so that the converters of each package stand alone.
+@[for index in sorted(cdr_plans)]@
+@{
+m = mappings[index]
+fields = cdr_plans[index]
+reads_fields = any(field.presence != 'ROS2_ONLY' for field in fields)
+}@
+void read_ros1_message_@(index)(
+  Ros1WireReader & @('reader' if reads_fields else '/* reader */'),
+  @(m.ros2_msg.package_name)::msg::@(m.ros2_msg.message_name) & @('ros2_message' if reads_fields else '/* ros2_message */'));
+@[end for]@
+
+@[for index in sorted(cdr_plans)]@
+@{
+m = mappings[index]
+fields = cdr_plans[index]
+reads_fields = any(field.presence != 'ROS2_ONLY' for field in fields)
+}@
+// @(m.ros1_msg.package_name)/@(m.ros1_msg.message_name) -> @(m.ros2_msg.package_name)/msg/@(m.ros2_msg.message_name)
+void read_ros1_message_@(index)(
+  Ros1WireReader & @('reader' if reads_fields else '/* reader */'),
+  @(m.ros2_msg.package_name)::msg::@(m.ros2_msg.message_name) & @('ros2_message' if reads_fields else '/* ros2_message */'))
+{
+@[  for field in fields]@
+  // @(field.name)
+  @(field.get_read_statement())
+@[  end for]@
 }
 
-void
-convert_1_to_2(
-  const std::string & ros1_type_name,
-  ros::serialization::IStream & ros1_message_stream,
-  std::shared_ptr<rosbag2_cpp::rosbag2_introspection_message_t> ros2_message)
+@[end for]@
+@[for index in package_indices]@
+@{
+m = mappings[index]
+}@
+// @(m.ros1_msg.package_name)/@(m.ros1_msg.message_name) -> @(m.ros2_msg.package_name)/msg/@(m.ros2_msg.message_name)
+void convert_mapping_@(index)(
+  ros::serialization::IStream & ros1_message_stream, void * ros2_message)
 {
-  @[if not mappings]@
-  (void) ros1_type_name;
-  (void) ros1_message_stream;
-  (void) ros2_message;
-  @[end if]@
-
-  std::string ros2_type_name;
-  ros1_bridge::get_1to2_mapping(ros1_type_name, ros2_type_name);
-
-  @[for m in mappings]@
-  if (ros1_type_name == "@(m.ros1_msg.package_name)/@(m.ros1_msg.message_name)"
-    && ros2_type_name == "@(m.ros2_msg.package_name)/msg/@(m.ros2_msg.message_name)")
-  {
-    @(m.ros1_msg.package_name)::@(m.ros1_msg.message_name) typed_ros1_message;
+@[  if index in cdr_plans]@
+  Ros1WireReader reader(ros1_message_stream);
+  read_ros1_message_@(index)(
+    reader,
+    *static_cast<@(m.ros2_msg.package_name)::msg::@(m.ros2_msg.message_name) *>(ros2_message));
+@[  else]@
+  // Kept per thread so that its sequences and strings keep their capacity from one message to
+  // the next, deserializing overwrites every field
+  thread_local @(m.ros1_msg.package_name)::@(m.ros1_msg.message_name) typed_ros1_message;
 
-    ros::serialization
-      ::Serializer<@(m.ros1_msg.package_name)::@(m.ros1_msg.message_name)>
-      ::read(ros1_message_stream, typed_ros1_message);
+  ros::serialization
+    ::Serializer<@(m.ros1_msg.package_name)::@(m.ros1_msg.message_name)>
+    ::read(ros1_message_stream, typed_ros1_message);
 
-    auto factory = ros1_bridge::get_factory(
-      "@(m.ros1_msg.package_name)/@(m.ros1_msg.message_name)",
-      "@(m.ros2_msg.package_name)/msg/@(m.ros2_msg.message_name)");
-    factory->convert_1_to_2(&typed_ros1_message, ros2_message->message);
-  }
-  @[end for]@
+  static const auto factory = ros1_bridge::get_factory(
+    "@(m.ros1_msg.package_name)/@(m.ros1_msg.message_name)",
+    "@(m.ros2_msg.package_name)/msg/@(m.ros2_msg.message_name)");
+  factory->convert_1_to_2(&typed_ros1_message, ros2_message);
+@[  end if]@
 }
-}  // end namespace rosbag2_bag_v2_plugin
+
+@[end for]@
+const CdrFieldPlan ros1_time_cdr_fields[] = {
+  {CdrFieldKind::PRIMITIVE, 4, CdrArrayKind::NONE, 0, nullptr, CdrFieldPresence::BOTH},  // sec
+  {CdrFieldKind::PRIMITIVE, 4, CdrArrayKind::NONE, 0, nullptr, CdrFieldPresence::BOTH},  // nsec
+};
+const CdrTranscoderPlan ros1_time_cdr_plan = {ros1_time_cdr_fields, 2};
+
+// Plans refer to the plans of their nested messages, which may be defined further down
+@[for index in sorted(cdr_plans)]@
+extern const CdrTranscoderPlan cdr_plan_@(index);
+@[end for]@
+
+@[for index in sorted(cdr_plans)]@
+@{
+m = mappings[index]
+fields = cdr_plans[index]
+}@
+// @(m.ros1_msg.package_name)/@(m.ros1_msg.message_name) -> @(m.ros2_msg.package_name)/msg/@(m.ros2_msg.message_name)
+@[  if fields]@
+const CdrFieldPlan cdr_plan_@(index)_fields[] = {
+@[    for field in fields]@
+  // @(field.name)
+  {
+    CdrFieldKind::@(field.kind), @(field.primitive_size), CdrArrayKind::@(field.array_kind),
+    @(field.array_size), @(field.message), CdrFieldPresence::@(field.presence)
+  },
+@[    end for]@
+};
+const CdrTranscoderPlan cdr_plan_@(index) = {cdr_plan_@(index)_fields, @(len(fields))};
+@[  else]@
+const CdrTranscoderPlan cdr_plan_@(index) = {nullptr, 0};
+@[  end if]@
+
+@[end for]@
+const std::array<ConverterTableEntry, @(len(package_indices))> converter_table = {{
+@[for index in package_indices]@
+@{
+m = mappings[index]
+}@
+    {
+      "@(m.ros1_msg.package_name)/@(m.ros1_msg.message_name)",
+      "@(m.ros2_msg.package_name)/msg/@(m.ros2_msg.message_name)",
+      &convert_mapping_@(index),
+@[  if index in cdr_plans]@
+      &cdr_plan_@(index)
+@[  else]@
+      nullptr
+@[  end if]@
+    },
+@[end for]@
+  }};
+
+const bool registered = (
+  register_converters("@(package_name)", converter_table.data(), converter_table.size()), true);
+
+}  // namespace
+
+}  // namespace rosbag2_bag_v2_plugins
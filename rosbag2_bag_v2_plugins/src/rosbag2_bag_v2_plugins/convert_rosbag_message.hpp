@@ -21,10 +21,40 @@
 #include "rosbag/message_instance.h"
 #include "rosbag2_cpp/types/introspection_message.hpp"
 
+#include "cdr_transcoder.hpp"
+
 namespace rosbag2_bag_v2_plugins
 {
+/**
+ * Deserializes a ROS 1 message from the stream and converts it into the given ROS 2 message.
+ * The ROS 2 message has to be of the ROS 2 type the converter was looked up for.
+ *
+ * The ROS 2 message may be reused for any number of conversions: every field which also exists in
+ * ROS 1 is overwritten, and sequences and strings are resized in place so they keep their
+ * capacity. Fields which only exist in ROS 2 are left untouched.
+ */
+using ConvertFunction = void (*)(
+  ros::serialization::IStream & ros1_message_stream, void * ros2_message);
+
 bool get_1to2_mapping(const std::string & ros1_message_type, std::string & ros2_message_type);
 
+/**
+ * Looks up the generated converter for a pair of ROS 1 and ROS 2 types in the registry, see
+ * converter_registry.hpp. The lookup locks the registry, so callers which convert many messages of
+ * the same type should resolve the converter once and keep the returned function pointer.
+ * \returns the converter, or nullptr if there is no mapping between the two types
+ */
+ConvertFunction get_1to2_converter(
+  const std::string & ros1_type_name, const std::string & ros2_type_name);
+
+/**
+ * Looks up the generated plan for transcoding messages of a pair of ROS 1 and ROS 2 types into
+ * CDR, see cdr_transcoder.hpp.
+ * \returns the plan, or nullptr if messages of these types have to be converted by the factory
+ */
+const CdrTranscoderPlan * get_1to2_cdr_plan(
+  const std::string & ros1_type_name, const std::string & ros2_type_name);
+
 void
 convert_1_to_2(
   const std::string & ros1_type_name,
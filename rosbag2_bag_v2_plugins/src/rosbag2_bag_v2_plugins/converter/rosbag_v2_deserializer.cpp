@@ -14,8 +14,11 @@
 
 #include "rosbag_v2_deserializer.hpp"
 
+#include <cstring>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 #include "rosbag/message_instance.h"
 
@@ -24,33 +27,179 @@
 
 #include "rosbag2_storage/serialized_bag_message.hpp"
 
-#include "../convert_rosbag_message.hpp"
+#include "../borrowed_message_buffer.hpp"
+#include "../converter_handle.hpp"
+#include "../logging.hpp"
+#include "../message_type_header.hpp"
+#include "../statistics.hpp"
 
 namespace rosbag2_bag_v2_plugins
 {
+RosbagV2Deserializer::~RosbagV2Deserializer()
+{
+  if (STATISTICS_ENABLED && !topic_statistics_.empty()) {
+    ROSBAG2_BAG_V2_PLUGINS_LOG_DEBUG_STREAM(get_statistics());
+  }
+}
+
 void RosbagV2Deserializer::deserialize(
   std::shared_ptr<const rosbag2_storage::SerializedBagMessage> serialized_message,
   const rosidl_message_type_support_t * type_support,
   std::shared_ptr<rosbag2_cpp::rosbag2_introspection_message_t> ros_message)
 {
-  (void) type_support;
+  size_t payload_offset;
+  StatisticsTimer timer;
+  auto converter = get_converter(*serialized_message->serialized_data, payload_offset);
+  if (STATISTICS_ENABLED) {
+    lookup_nanoseconds_ += timer.get_elapsed_nanoseconds();
+  }
+  if (converter) {
+    check_type_support(*converter, type_support);
+  }
+  convert(converter, payload_offset, *serialized_message, *ros_message);
+}
 
-  // See rosbag_output_stream.cpp for reasoning: The serialialized data starts with a
-  // null-terminated string containing the data_type of the message and then the message itself
-  // in serialized form
-  auto ros1_data_type = std::string(
-    reinterpret_cast<char *>(serialized_message->serialized_data->buffer));
+void RosbagV2Deserializer::deserialize_batch(
+  const std::vector<std::shared_ptr<const rosbag2_storage::SerializedBagMessage>> &
+  serialized_messages,
+  const rosidl_message_type_support_t * type_support,
+  const std::vector<std::shared_ptr<rosbag2_cpp::rosbag2_introspection_message_t>> & ros_messages)
+{
+  if (serialized_messages.size() != ros_messages.size()) {
+    throw std::runtime_error(
+            "Cannot deserialize " + std::to_string(serialized_messages.size()) +
+            " messages into " + std::to_string(ros_messages.size()) + " messages");
+  }
 
-  size_t data_type_zero_terminated_length = ros1_data_type.length() + 1;
-  ros::serialization::IStream stream(
-    serialized_message->serialized_data->buffer + data_type_zero_terminated_length,
-    serialized_message->serialized_data->buffer_length - data_type_zero_terminated_length);
+  const ConverterHandle * previous_converter = nullptr;
+  for (size_t i = 0; i < serialized_messages.size(); ++i) {
+    size_t payload_offset;
+    StatisticsTimer timer;
+    auto converter = get_converter(*serialized_messages[i]->serialized_data, payload_offset);
+    if (STATISTICS_ENABLED) {
+      lookup_nanoseconds_ += timer.get_elapsed_nanoseconds();
+    }
+    if (converter && converter != previous_converter) {
+      check_type_support(*converter, type_support);
+      previous_converter = converter;
+    }
+    convert(converter, payload_offset, *serialized_messages[i], *ros_messages[i]);
+  }
+}
+
+const ConverterHandle * RosbagV2Deserializer::get_converter(
+  const rcutils_uint8_array_t & serialized_data, size_t & payload_offset)
+{
+  // Data borrowed from a chunk has no type prefix, its converter is stored alongside it
+  payload_offset = 0;
+  auto converter = get_borrowed_message_converter(serialized_data);
+  if (converter) {
+    return converter;
+  }
+
+  if (has_compact_message_header(serialized_data)) {
+    payload_offset = COMPACT_MESSAGE_HEADER_LENGTH;
+    return find_converter(read_compact_message_header(serialized_data));
+  }
 
-  convert_1_to_2(ros1_data_type, stream, ros_message);
+  converter = find_converter(serialized_data);
+  payload_offset = converter ? converter->prefix_length : 0;
+  return converter;
+}
+
+void RosbagV2Deserializer::check_type_support(
+  const ConverterHandle & converter, const rosidl_message_type_support_t * type_support)
+{
+  if (type_support && converter.ros2_type_support &&
+    type_support != converter.ros2_type_support &&
+    std::strcmp(
+      type_support->typesupport_identifier,
+      converter.ros2_type_support->typesupport_identifier) == 0)
+  {
+    throw std::runtime_error(
+            "Cannot convert message of type '" + converter.ros1_type_name +
+            "' into a message which is not of type '" + converter.ros2_type_name + "'");
+  }
+}
 
-  ros_message->time_stamp = serialized_message->time_stamp;
+void RosbagV2Deserializer::convert(
+  const ConverterHandle * converter, size_t payload_offset,
+  const rosbag2_storage::SerializedBagMessage & serialized_message,
+  rosbag2_cpp::rosbag2_introspection_message_t & ros_message)
+{
+  if (converter) {
+    StatisticsTimer timer;
+    const auto & serialized_data = *serialized_message.serialized_data;
+    ros::serialization::IStream stream(
+      serialized_data.buffer + payload_offset,
+      static_cast<uint32_t>(serialized_data.buffer_length - payload_offset));
+    convert_message(*converter, stream, ros_message.message);
+    if (STATISTICS_ENABLED) {
+      auto & statistics = topic_statistics_[serialized_message.topic_name];
+      ++statistics.messages;
+      statistics.bytes += serialized_data.buffer_length - payload_offset;
+      statistics.nanoseconds += timer.get_elapsed_nanoseconds();
+    }
+  }
+
+  ros_message.time_stamp = serialized_message.time_stamp;
   rosbag2_cpp::introspection_message_set_topic_name(
-    ros_message.get(), serialized_message->topic_name.c_str());
+    &ros_message, serialized_message.topic_name.c_str());
+}
+
+ConversionStatistics RosbagV2Deserializer::get_statistics() const
+{
+  ConversionStatistics statistics;
+  statistics.topics.insert(topic_statistics_.begin(), topic_statistics_.end());
+  statistics.lookup_nanoseconds = lookup_nanoseconds_;
+  return statistics;
+}
+
+const ConverterHandle * RosbagV2Deserializer::find_converter(uint32_t converter_id)
+{
+  if (converter_id >= converters_by_id_.size() || !converters_by_id_[converter_id]) {
+    auto converter = get_converter_handle(converter_id);
+    if (!converter) {
+      throw std::runtime_error(
+              "Serialized rosbag_v2 message refers to an unknown type. Messages with a compact "
+              "type header can only be deserialized by the process which read them.");
+    }
+    if (converter_id >= converters_by_id_.size()) {
+      converters_by_id_.resize(converter_id + 1, nullptr);
+    }
+    converters_by_id_[converter_id] = converter;
+  }
+  return converters_by_id_[converter_id];
+}
+
+const ConverterHandle * RosbagV2Deserializer::find_converter(
+  const rcutils_uint8_array_t & serialized_data)
+{
+  // Data written by older versions of the storage plugin starts with a
+  // null-terminated string containing the data_type of the message and then the message itself
+  // in serialized form
+  for (auto converter : converters_) {
+    if (serialized_data.buffer_length >= converter->prefix_length &&
+      std::memcmp(
+        serialized_data.buffer, converter->ros1_type_name.c_str(), converter->prefix_length) == 0)
+    {
+      return converter;
+    }
+  }
+
+  auto data_type = reinterpret_cast<const char *>(serialized_data.buffer);
+  auto data_type_length = strnlen(data_type, serialized_data.buffer_length);
+  if (data_type_length == serialized_data.buffer_length) {
+    throw std::runtime_error("Serialized rosbag_v2 message does not start with its data type");
+  }
+
+  // First message of this type for this deserializer: the storage plugin usually resolved the
+  // handle already when opening the bag, so this is a cache lookup.
+  auto converter = resolve_converter_handle(std::string(data_type, data_type_length));
+  if (converter) {
+    converters_.push_back(converter);
+  }
+  return converter;
 }
 }  // namespace rosbag2_bag_v2_plugins
 
@@ -15,13 +15,20 @@
 #ifndef ROSBAG2_BAG_V2_PLUGINS__CONVERTER__ROSBAG_V2_DESERIALIZER_HPP_
 #define ROSBAG2_BAG_V2_PLUGINS__CONVERTER__ROSBAG_V2_DESERIALIZER_HPP_
 
+#include <cstdint>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "rosbag2_cpp/converter_interfaces/serialization_format_deserializer.hpp"
 #include "rosbag2_cpp/types/introspection_message.hpp"
 
 #include "rosbag2_storage/serialized_bag_message.hpp"
 
+#include "../converter_handle.hpp"
+#include "../statistics.hpp"
+
 namespace rosbag2_bag_v2_plugins
 {
 class RosbagV2Deserializer
@@ -29,12 +36,56 @@ class RosbagV2Deserializer
 {
 public:
   RosbagV2Deserializer() = default;
-  virtual ~RosbagV2Deserializer() = default;
+  virtual ~RosbagV2Deserializer();
 
+  /**
+   * Converts the message into ros_message. Passing the same ros_message again for the next message
+   * of its type avoids reallocating its sequences and strings, see ConvertFunction.
+   */
   void deserialize(
     std::shared_ptr<const rosbag2_storage::SerializedBagMessage> serialized_message,
     const rosidl_message_type_support_t * type_support,
     std::shared_ptr<rosbag2_cpp::rosbag2_introspection_message_t> ros_message) override;
+
+  /**
+   * Deserializes messages of one type, e.g. a batch read with RosbagV2Storage::read_next_batch
+   * and grouped by topic. The type support is checked once per run of equal types instead of
+   * once per message.
+   * \throws std::runtime_error if the number of serialized and ROS messages differs
+   */
+  void deserialize_batch(
+    const std::vector<std::shared_ptr<const rosbag2_storage::SerializedBagMessage>> &
+    serialized_messages,
+    const rosidl_message_type_support_t * type_support,
+    const std::vector<std::shared_ptr<rosbag2_cpp::rosbag2_introspection_message_t>> &
+    ros_messages);
+
+  /**
+   * Messages converted so far, all zero unless statistics are compiled in, see statistics.hpp.
+   * They are also logged at debug level when the deserializer is destroyed.
+   */
+  ConversionStatistics get_statistics() const;
+
+private:
+  const ConverterHandle * find_converter(uint32_t converter_id);
+  const ConverterHandle * find_converter(const rcutils_uint8_array_t & serialized_data);
+  const ConverterHandle * get_converter(
+    const rcutils_uint8_array_t & serialized_data, size_t & payload_offset);
+  static void check_type_support(
+    const ConverterHandle & converter, const rosidl_message_type_support_t * type_support);
+  void convert(
+    const ConverterHandle * converter, size_t payload_offset,
+    const rosbag2_storage::SerializedBagMessage & serialized_message,
+    rosbag2_cpp::rosbag2_introspection_message_t & ros_message);
+
+  // Converters of the types seen so far, indexed by their id for compact type headers. Bags
+  // usually contain only a handful of types, so messages with a type name are searched linearly.
+  std::vector<const ConverterHandle *> converters_by_id_;
+  std::vector<const ConverterHandle *> converters_;
+
+  // Only updated if statistics are compiled in
+  std::unordered_map<std::string, TopicStatistics> topic_statistics_;
+  uint64_t lookup_nanoseconds_ = 0;
 };
 
 }  // namespace rosbag2_bag_v2_plugins
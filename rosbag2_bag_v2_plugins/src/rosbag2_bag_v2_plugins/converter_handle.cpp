@@ -0,0 +1,239 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "converter_handle.hpp"
+
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "rmw/rmw.h"
+#include "rosbag2_cpp/types/introspection_message.hpp"
+#include "rosbag2_cpp/typesupport_helpers.hpp"
+
+#include "logging.hpp"
+#include "ros1_message_definition.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+namespace
+{
+
+const rosidl_message_type_support_t * load_type_support(
+  const std::string & ros2_type_name, const std::string & type_support_identifier)
+{
+  try {
+    return rosbag2_cpp::get_typesupport(ros2_type_name, type_support_identifier);
+  } catch (const std::runtime_error & e) {
+    ROSBAG2_BAG_V2_PLUGINS_LOG_DEBUG_STREAM(
+      "Could not load type support for '" << ros2_type_name << "': " << e.what());
+    return nullptr;
+  }
+}
+
+std::unique_ptr<ConverterHandle> make_converter_handle(const std::string & ros1_type_name)
+{
+  std::string ros2_type_name;
+  if (!get_1to2_mapping(ros1_type_name, ros2_type_name)) {
+    return nullptr;
+  }
+  auto convert = get_1to2_converter(ros1_type_name, ros2_type_name);
+  if (!convert) {
+    return nullptr;
+  }
+
+  auto ros2_type_support = load_type_support(
+    ros2_type_name, "rosidl_typesupport_introspection_cpp");
+
+  // Only messages which cannot be transcoded are serialized with the type support
+  auto cdr_plan = get_1to2_cdr_plan(ros1_type_name, ros2_type_name);
+  const rosidl_message_type_support_t * ros2_cpp_type_support = nullptr;
+  if (!cdr_plan && ros2_type_support) {
+    ros2_cpp_type_support = load_type_support(ros2_type_name, "rosidl_typesupport_cpp");
+  }
+
+  auto handle = std::make_unique<ConverterHandle>();
+  handle->ros1_type_name = ros1_type_name;
+  handle->ros2_type_name = ros2_type_name;
+  handle->convert = convert;
+  handle->ros2_type_support = ros2_type_support;
+  handle->prefix_length = ros1_type_name.length() + 1;
+  handle->cdr_plan = cdr_plan;
+  handle->ros2_cpp_type_support = ros2_cpp_type_support;
+  return handle;
+}
+
+std::unique_ptr<ConverterHandle> make_generic_converter_handle(
+  const std::string & ros1_type_name, const std::string & message_definition)
+{
+  // The ROS 2 type of the same name, e.g. my_msgs/msg/Status for my_msgs/Status
+  auto separator = ros1_type_name.find('/');
+  if (separator == std::string::npos) {
+    return nullptr;
+  }
+  auto ros2_type_name = ros1_type_name.substr(0, separator) + "/msg/" +
+    ros1_type_name.substr(separator + 1);
+  auto ros2_type_support = load_type_support(
+    ros2_type_name, "rosidl_typesupport_introspection_cpp");
+  if (!ros2_type_support) {
+    return nullptr;
+  }
+
+  std::shared_ptr<const GenericConverter> generic_converter;
+  try {
+    generic_converter = std::make_shared<GenericConverter>(
+      ros1_type_name, parse_ros1_message_definition(ros1_type_name, message_definition),
+      ros2_type_support);
+  } catch (const std::runtime_error & e) {
+    ROSBAG2_BAG_V2_PLUGINS_LOG_INFO_STREAM(
+      "Cannot convert '" << ros1_type_name << "' into '" << ros2_type_name << "': " << e.what());
+    return nullptr;
+  }
+
+  auto handle = std::make_unique<ConverterHandle>();
+  handle->ros1_type_name = ros1_type_name;
+  handle->ros2_type_name = ros2_type_name;
+  handle->convert = nullptr;
+  handle->generic_converter = std::move(generic_converter);
+  handle->ros2_type_support = ros2_type_support;
+  handle->prefix_length = ros1_type_name.length() + 1;
+  handle->cdr_plan = nullptr;
+  handle->ros2_cpp_type_support = load_type_support(ros2_type_name, "rosidl_typesupport_cpp");
+  return handle;
+}
+
+// Handles are never removed, which keeps the returned raw pointers valid. Types without a
+// mapping are cached as well so that they are only looked up once.
+struct ConverterHandleRegistry
+{
+  std::mutex mutex;
+  std::unordered_map<std::string, std::unique_ptr<ConverterHandle>> handles_by_type;
+  /// Generic converters by ROS 1 type and md5sum, as a bag may hold several versions of a type
+  std::unordered_map<std::string, std::unique_ptr<ConverterHandle>> generic_handles_by_md5sum;
+  /// Generic converter resolved last for a ROS 1 type
+  std::unordered_map<std::string, const ConverterHandle *> generic_handles_by_type;
+  std::vector<const ConverterHandle *> handles_by_id;
+};
+
+ConverterHandleRegistry & get_registry()
+{
+  static ConverterHandleRegistry registry;
+  return registry;
+}
+
+void add_handle_id(ConverterHandleRegistry & registry, ConverterHandle * handle)
+{
+  if (handle) {
+    handle->id = static_cast<uint32_t>(registry.handles_by_id.size());
+    registry.handles_by_id.push_back(handle);
+  }
+}
+
+/// Expects the registry to be locked
+const ConverterHandle * resolve_generated_converter_handle(
+  ConverterHandleRegistry & registry, const std::string & ros1_type_name)
+{
+  auto it = registry.handles_by_type.find(ros1_type_name);
+  if (it == registry.handles_by_type.end()) {
+    auto handle = make_converter_handle(ros1_type_name);
+    add_handle_id(registry, handle.get());
+    it = registry.handles_by_type.emplace(ros1_type_name, std::move(handle)).first;
+  }
+  return it->second.get();
+}
+
+}  // namespace
+
+const ConverterHandle * resolve_converter_handle(const std::string & ros1_type_name)
+{
+  auto & registry = get_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  auto handle = resolve_generated_converter_handle(registry, ros1_type_name);
+  if (!handle) {
+    auto generic_handle = registry.generic_handles_by_type.find(ros1_type_name);
+    if (generic_handle != registry.generic_handles_by_type.end()) {
+      handle = generic_handle->second;
+    }
+  }
+  return handle;
+}
+
+const ConverterHandle * resolve_converter_handle(
+  const std::string & ros1_type_name, const std::string & md5sum,
+  const std::string & message_definition)
+{
+  auto & registry = get_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  auto handle = resolve_generated_converter_handle(registry, ros1_type_name);
+  if (handle) {
+    return handle;
+  }
+
+  auto key = ros1_type_name + "@" + md5sum;
+  auto it = registry.generic_handles_by_md5sum.find(key);
+  if (it == registry.generic_handles_by_md5sum.end()) {
+    auto generic_handle = make_generic_converter_handle(ros1_type_name, message_definition);
+    if (generic_handle) {
+      add_handle_id(registry, generic_handle.get());
+      registry.generic_handles_by_type[ros1_type_name] = generic_handle.get();
+    }
+    it = registry.generic_handles_by_md5sum.emplace(key, std::move(generic_handle)).first;
+  }
+  return it->second.get();
+}
+
+const ConverterHandle * get_converter_handle(uint32_t id)
+{
+  auto & registry = get_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  return id < registry.handles_by_id.size() ? registry.handles_by_id[id] : nullptr;
+}
+
+void convert_to_cdr(
+  const ConverterHandle & converter,
+  const uint8_t * ros1_message, size_t ros1_message_length,
+  rcutils_uint8_array_t & cdr_message)
+{
+  if (converter.cdr_plan) {
+    transcode_to_cdr(*converter.cdr_plan, ros1_message, ros1_message_length, cdr_message);
+    return;
+  }
+
+  if (!converter.ros2_type_support || !converter.ros2_cpp_type_support) {
+    throw std::runtime_error(
+            "Cannot serialize message of type '" + converter.ros1_type_name +
+            "' as CDR, the type support of '" + converter.ros2_type_name + "' is not available");
+  }
+  auto allocator = rcutils_get_default_allocator();
+  auto ros2_message = rosbag2_cpp::allocate_introspection_message(
+    converter.ros2_type_support, &allocator);
+  // IStream only reads from the data, although it takes a non-const pointer
+  ros::serialization::IStream stream(
+    const_cast<uint8_t *>(ros1_message), static_cast<uint32_t>(ros1_message_length));
+  convert_message(converter, stream, ros2_message->message);
+
+  auto ret = rmw_serialize(ros2_message->message, converter.ros2_cpp_type_support, &cdr_message);
+  if (ret != RMW_RET_OK) {
+    throw std::runtime_error(
+            "Failed to serialize message of type '" + converter.ros2_type_name +
+            "'. Error code " + std::to_string(ret));
+  }
+}
+
+}  // namespace rosbag2_bag_v2_plugins
@@ -0,0 +1,107 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROSBAG2_BAG_V2_PLUGINS__CONVERTER_HANDLE_HPP_
+#define ROSBAG2_BAG_V2_PLUGINS__CONVERTER_HANDLE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "rcutils/types/uint8_array.h"
+#include "rosidl_generator_c/message_type_support_struct.h"
+
+#include "cdr_transcoder.hpp"
+#include "convert_rosbag_message.hpp"
+#include "generic_converter.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+/**
+ * Everything needed to convert messages of one ROS 1 type, resolved once per type.
+ */
+struct ConverterHandle
+{
+  /// Identifies the handle within this process, see message_type_header.hpp
+  uint32_t id;
+  std::string ros1_type_name;
+  std::string ros2_type_name;
+  /// Generated converter, nullptr if messages are converted by the generic_converter
+  ConvertFunction convert;
+  /// Converter built from the ROS 1 message definition, for types without a generated converter
+  std::shared_ptr<const GenericConverter> generic_converter;
+  /// Introspection type support of the ROS 2 type, nullptr if it could not be loaded
+  const rosidl_message_type_support_t * ros2_type_support;
+  /// Length of the null-terminated ROS 1 type name in front of the serialized message
+  size_t prefix_length;
+  /// Plan for transcoding messages straight into CDR, nullptr if they have to be converted
+  const CdrTranscoderPlan * cdr_plan;
+  /// Type support for serializing converted messages, only loaded if there is no cdr_plan
+  const rosidl_message_type_support_t * ros2_cpp_type_support;
+};
+
+/**
+ * Returns the converter handle for a ROS 1 type.
+ * The handle is resolved on first use and cached for the lifetime of the process, so the returned
+ * pointer stays valid and can be kept by the caller.
+ * \returns the handle, or nullptr if there is no ROS 2 counterpart for the given ROS 1 type
+ */
+const ConverterHandle * resolve_converter_handle(const std::string & ros1_type_name);
+
+/**
+ * Returns the converter handle for a ROS 1 type of a connection of a bag.
+ * Types without a generated converter are converted by a GenericConverter built from the message
+ * definition of the connection, as long as there is a ROS 2 type of the same name, e.g.
+ * my_msgs/msg/Status for my_msgs/Status. It is built once per type and md5sum and is found by
+ * resolve_converter_handle(ros1_type_name) afterwards as well.
+ * \returns the handle, or nullptr if messages of the type cannot be converted
+ */
+const ConverterHandle * resolve_converter_handle(
+  const std::string & ros1_type_name, const std::string & md5sum,
+  const std::string & message_definition);
+
+/**
+ * \returns the handle with the given id, or nullptr if no handle with this id has been resolved
+ */
+const ConverterHandle * get_converter_handle(uint32_t id);
+
+/// Converts a serialized ROS 1 message into a ROS 2 message of the type of the converter
+inline void convert_message(
+  const ConverterHandle & converter, ros::serialization::IStream & ros1_message,
+  void * ros2_message)
+{
+  if (converter.convert) {
+    converter.convert(ros1_message, ros2_message);
+  } else {
+    converter.generic_converter->convert(ros1_message, ros2_message);
+  }
+}
+
+/**
+ * Serializes a ROS 1 message as CDR message of the ROS 2 type of the converter.
+ * Messages are transcoded with the cdr_plan of the converter if it has one. Otherwise they are
+ * converted into a ROS 2 message first, which is serialized with rmw_serialize.
+ * \param cdr_message receives the CDR message, it is resized as needed
+ * \throws std::runtime_error if the message cannot be serialized
+ */
+void convert_to_cdr(
+  const ConverterHandle & converter,
+  const uint8_t * ros1_message, size_t ros1_message_length,
+  rcutils_uint8_array_t & cdr_message);
+
+}  // namespace rosbag2_bag_v2_plugins
+
+#endif  // ROSBAG2_BAG_V2_PLUGINS__CONVERTER_HANDLE_HPP_
@@ -0,0 +1,172 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "converter_registry.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#ifdef ROSBAG2_BAG_V2_PLUGINS_CONVERTER_LIBRARIES
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+#endif
+
+#include "ros1_bridge/bridge.hpp"
+
+#include "logging.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+namespace
+{
+
+int compare_mapping(const ConverterTableEntry & lhs, const ConverterTableEntry & rhs)
+{
+  int result = std::strcmp(lhs.ros1_type_name, rhs.ros1_type_name);
+  return result != 0 ? result : std::strcmp(lhs.ros2_type_name, rhs.ros2_type_name);
+}
+
+// Entries of all packages registered so far, sorted for a binary search. Packages register
+// before their converters are looked up for the first time, and every type is only looked up
+// once, see resolve_converter_handle, so the lookups do not need to be faster than this.
+struct ConverterRegistry
+{
+  std::mutex mutex;
+  std::vector<ConverterTableEntry> entries;
+  std::unordered_set<std::string> packages;
+};
+
+ConverterRegistry & get_registry()
+{
+  static ConverterRegistry registry;
+  return registry;
+}
+
+const ConverterTableEntry * find_entry(
+  const ConverterRegistry & registry,
+  const std::string & ros1_type_name, const std::string & ros2_type_name)
+{
+  const ConverterTableEntry key = {
+    ros1_type_name.c_str(), ros2_type_name.c_str(), nullptr, nullptr};
+  auto entry = std::lower_bound(
+    registry.entries.begin(), registry.entries.end(), key,
+    [](const ConverterTableEntry & lhs, const ConverterTableEntry & rhs) {
+      return compare_mapping(lhs, rhs) < 0;
+    });
+  if (entry == registry.entries.end() || compare_mapping(*entry, key) != 0) {
+    return nullptr;
+  }
+  return &*entry;
+}
+
+#ifdef ROSBAG2_BAG_V2_PLUGINS_CONVERTER_LIBRARIES
+// Converters are built into a library per ROS 1 package, which registers them when it is loaded.
+// Only the libraries of packages whose types are read are loaded, and each one only once.
+void load_converter_library(const std::string & ros1_package_name)
+{
+  auto library_name = "rosbag2_bag_v2_converters_" + ros1_package_name;
+#ifdef _WIN32
+  auto library = LoadLibraryA((library_name + ".dll").c_str());
+#else
+  auto library = dlopen(("lib" + library_name + ".so").c_str(), RTLD_NOW | RTLD_LOCAL);
+#endif
+  if (!library) {
+    ROSBAG2_BAG_V2_PLUGINS_LOG_DEBUG_STREAM(
+      "No converter library found for ROS 1 package '" << ros1_package_name << "'");
+  }
+  // The library stays loaded, the registry points into it
+}
+#endif
+
+// Returns a copy, as registering more packages moves the entries
+ConverterTableEntry get_entry(
+  const std::string & ros1_type_name, const std::string & ros2_type_name)
+{
+  auto & registry = get_registry();
+  std::unique_lock<std::mutex> lock(registry.mutex);
+  auto entry = find_entry(registry, ros1_type_name, ros2_type_name);
+#ifdef ROSBAG2_BAG_V2_PLUGINS_CONVERTER_LIBRARIES
+  auto ros1_package_name = ros1_type_name.substr(0, ros1_type_name.find('/'));
+  if (!entry && registry.packages.insert(ros1_package_name).second) {
+    // Loading the library registers its converters, which locks the registry
+    lock.unlock();
+    load_converter_library(ros1_package_name);
+    lock.lock();
+    entry = find_entry(registry, ros1_type_name, ros2_type_name);
+  }
+#endif
+  return entry ? *entry : ConverterTableEntry{nullptr, nullptr, nullptr, nullptr};
+}
+
+}  // namespace
+
+void register_converters(
+  const char * ros1_package_name, const ConverterTableEntry * entries, size_t count)
+{
+  auto & registry = get_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.packages.insert(ros1_package_name);
+  registry.entries.insert(registry.entries.end(), entries, entries + count);
+  std::sort(
+    registry.entries.begin(), registry.entries.end(),
+    [](const ConverterTableEntry & lhs, const ConverterTableEntry & rhs) {
+      return compare_mapping(lhs, rhs) < 0;
+    });
+}
+
+bool get_1to2_mapping(const std::string & ros1_message_type, std::string & ros2_message_type)
+{
+  return ros1_bridge::get_1to2_mapping(ros1_message_type, ros2_message_type);
+}
+
+ConvertFunction get_1to2_converter(
+  const std::string & ros1_type_name, const std::string & ros2_type_name)
+{
+  return get_entry(ros1_type_name, ros2_type_name).convert;
+}
+
+const CdrTranscoderPlan * get_1to2_cdr_plan(
+  const std::string & ros1_type_name, const std::string & ros2_type_name)
+{
+  return get_entry(ros1_type_name, ros2_type_name).cdr_plan;
+}
+
+void
+convert_1_to_2(
+  const std::string & ros1_type_name,
+  ros::serialization::IStream & ros1_message_stream,
+  std::shared_ptr<rosbag2_cpp::rosbag2_introspection_message_t> ros2_message)
+{
+  std::string ros2_type_name;
+  if (!ros1_bridge::get_1to2_mapping(ros1_type_name, ros2_type_name)) {
+    return;
+  }
+
+  auto convert = get_1to2_converter(ros1_type_name, ros2_type_name);
+  if (convert) {
+    convert(ros1_message_stream, ros2_message->message);
+  }
+}
+
+}  // namespace rosbag2_bag_v2_plugins
@@ -0,0 +1,46 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef ROSBAG2_BAG_V2_PLUGINS__CONVERTER_REGISTRY_HPP_
+#define ROSBAG2_BAG_V2_PLUGINS__CONVERTER_REGISTRY_HPP_
+
+#include <cstddef>
+
+#include "cdr_transcoder.hpp"
+#include "convert_rosbag_message.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+struct ConverterTableEntry
+{
+  const char * ros1_type_name;
+  const char * ros2_type_name;
+  ConvertFunction convert;
+  const CdrTranscoderPlan * cdr_plan;
+};
+
+/**
+ * Makes the converters generated for the mappings of one ROS 1 package available to
+ * get_1to2_converter and get_1to2_cdr_plan. The generated code of each package calls this when it
+ * is loaded, be it as part of the plugin or as converter library of its own.
+ * \param entries must stay valid for the lifetime of the process
+ */
+void register_converters(
+  const char * ros1_package_name, const ConverterTableEntry * entries, size_t count);
+
+}  // namespace rosbag2_bag_v2_plugins
+
+#endif  // ROSBAG2_BAG_V2_PLUGINS__CONVERTER_REGISTRY_HPP_
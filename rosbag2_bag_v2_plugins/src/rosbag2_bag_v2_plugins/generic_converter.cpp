@@ -0,0 +1,453 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "generic_converter.hpp"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "rosidl_typesupport_introspection_cpp/field_types.hpp"
+
+#include "ros1_wire_reader.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+using rosidl_typesupport_introspection_cpp::MessageMember;
+using rosidl_typesupport_introspection_cpp::MessageMembers;
+
+namespace
+{
+
+using PrimitiveReadFunction = void (*)(Ros1WireReader & reader, void * values, size_t count);
+
+template<typename Ros1, typename Ros2>
+typename std::enable_if<std::is_same<Ros1, Ros2>::value>::type
+read_into(Ros1WireReader & reader, Ros2 * values, size_t count)
+{
+  reader.read_array(values, count);
+}
+
+template<typename Ros1, typename Ros2>
+typename std::enable_if<!std::is_same<Ros1, Ros2>::value>::type
+read_into(Ros1WireReader & reader, Ros2 * values, size_t count)
+{
+  for (size_t i = 0; i < count; ++i) {
+    Ros1 value;
+    reader.read(value);
+    values[i] = static_cast<Ros2>(value);
+  }
+}
+
+template<typename Ros1, typename Ros2>
+void read_primitives(Ros1WireReader & reader, void * values, size_t count)
+{
+  read_into<Ros1, Ros2>(reader, static_cast<Ros2 *>(values), count);
+}
+
+template<typename Ros1, typename Ros2>
+PrimitiveReadFunction select_read_function(std::true_type /* is_convertible */)
+{
+  return &read_primitives<Ros1, Ros2>;
+}
+
+template<typename Ros1, typename Ros2>
+PrimitiveReadFunction select_read_function(std::false_type /* is_convertible */)
+{
+  return nullptr;
+}
+
+template<typename Ros1, typename Ros2>
+PrimitiveReadFunction select_read_function()
+{
+  // Floating point numbers are not cut off into integers
+  return select_read_function<Ros1, Ros2>(
+    std::integral_constant<bool,
+    !std::is_floating_point<Ros1>::value || std::is_floating_point<Ros2>::value>());
+}
+
+template<typename Ros1>
+PrimitiveReadFunction select_read_function(uint8_t ros2_type_id)
+{
+  namespace types = rosidl_typesupport_introspection_cpp;
+  switch (ros2_type_id) {
+    case types::ROS_TYPE_FLOAT: return select_read_function<Ros1, float>();
+    case types::ROS_TYPE_DOUBLE: return select_read_function<Ros1, double>();
+    case types::ROS_TYPE_LONG_DOUBLE: return select_read_function<Ros1, long double>();
+    case types::ROS_TYPE_CHAR: return select_read_function<Ros1, uint8_t>();
+    case types::ROS_TYPE_BOOLEAN: return select_read_function<Ros1, bool>();
+    case types::ROS_TYPE_OCTET: return select_read_function<Ros1, uint8_t>();
+    case types::ROS_TYPE_UINT8: return select_read_function<Ros1, uint8_t>();
+    case types::ROS_TYPE_INT8: return select_read_function<Ros1, int8_t>();
+    case types::ROS_TYPE_UINT16: return select_read_function<Ros1, uint16_t>();
+    case types::ROS_TYPE_INT16: return select_read_function<Ros1, int16_t>();
+    case types::ROS_TYPE_UINT32: return select_read_function<Ros1, uint32_t>();
+    case types::ROS_TYPE_INT32: return select_read_function<Ros1, int32_t>();
+    case types::ROS_TYPE_UINT64: return select_read_function<Ros1, uint64_t>();
+    case types::ROS_TYPE_INT64: return select_read_function<Ros1, int64_t>();
+    default: return nullptr;
+  }
+}
+
+/// \returns the function reading the ROS 1 primitive into the ROS 2 one, nullptr if it cannot
+PrimitiveReadFunction select_read_function(const std::string & ros1_type, uint8_t ros2_type_id)
+{
+  if (ros1_type == "bool") {
+    return select_read_function<bool>(ros2_type_id);
+  } else if (ros1_type == "byte" || ros1_type == "int8") {
+    return select_read_function<int8_t>(ros2_type_id);
+  } else if (ros1_type == "char" || ros1_type == "uint8") {
+    return select_read_function<uint8_t>(ros2_type_id);
+  } else if (ros1_type == "int16") {
+    return select_read_function<int16_t>(ros2_type_id);
+  } else if (ros1_type == "uint16") {
+    return select_read_function<uint16_t>(ros2_type_id);
+  } else if (ros1_type == "int32") {
+    return select_read_function<int32_t>(ros2_type_id);
+  } else if (ros1_type == "uint32") {
+    return select_read_function<uint32_t>(ros2_type_id);
+  } else if (ros1_type == "int64") {
+    return select_read_function<int64_t>(ros2_type_id);
+  } else if (ros1_type == "uint64") {
+    return select_read_function<uint64_t>(ros2_type_id);
+  } else if (ros1_type == "float32") {
+    return select_read_function<float>(ros2_type_id);
+  } else if (ros1_type == "float64") {
+    return select_read_function<double>(ros2_type_id);
+  }
+  return nullptr;
+}
+
+/// Size of a ROS 1 primitive on the wire, 0 for strings and messages
+size_t get_ros1_primitive_size(const std::string & ros1_type)
+{
+  static const std::unordered_map<std::string, size_t> sizes{
+    {"bool", 1}, {"byte", 1}, {"char", 1}, {"int8", 1}, {"uint8", 1}, {"int16", 2},
+    {"uint16", 2}, {"int32", 4}, {"uint32", 4}, {"int64", 8}, {"uint64", 8}, {"float32", 4},
+    {"float64", 8}};
+  auto it = sizes.find(ros1_type);
+  return it == sizes.end() ? 0 : it->second;
+}
+
+/// Size of an element of a ROS 2 array, 0 for types which the converter does not support
+size_t get_ros2_element_size(const MessageMember & member)
+{
+  namespace types = rosidl_typesupport_introspection_cpp;
+  switch (member.type_id_) {
+    case types::ROS_TYPE_FLOAT: return sizeof(float);
+    case types::ROS_TYPE_DOUBLE: return sizeof(double);
+    case types::ROS_TYPE_LONG_DOUBLE: return sizeof(long double);
+    case types::ROS_TYPE_CHAR: return sizeof(uint8_t);
+    case types::ROS_TYPE_BOOLEAN: return sizeof(bool);
+    case types::ROS_TYPE_OCTET: return sizeof(uint8_t);
+    case types::ROS_TYPE_UINT8: return sizeof(uint8_t);
+    case types::ROS_TYPE_INT8: return sizeof(int8_t);
+    case types::ROS_TYPE_UINT16: return sizeof(uint16_t);
+    case types::ROS_TYPE_INT16: return sizeof(int16_t);
+    case types::ROS_TYPE_UINT32: return sizeof(uint32_t);
+    case types::ROS_TYPE_INT32: return sizeof(int32_t);
+    case types::ROS_TYPE_UINT64: return sizeof(uint64_t);
+    case types::ROS_TYPE_INT64: return sizeof(int64_t);
+    case types::ROS_TYPE_STRING: return sizeof(std::string);
+    case types::ROS_TYPE_MESSAGE:
+      return static_cast<const MessageMembers *>(member.members_->data)->size_of_;
+    default: return 0;
+  }
+}
+
+const MessageMember * find_member(const MessageMembers * members, const std::string & name)
+{
+  if (!members) {
+    return nullptr;
+  }
+  for (uint32_t i = 0; i < members->member_count_; ++i) {
+    if (name == members->members_[i].name_) {
+      return &members->members_[i];
+    }
+  }
+  return nullptr;
+}
+
+bool is_sequence(const MessageMember & member)
+{
+  return member.is_array_ && (member.is_upper_bound_ || member.array_size_ == 0);
+}
+
+/// Whether a ROS 1 array or single value fits into the ROS 2 member
+bool is_array_compatible(const Ros1FieldDefinition & field, const MessageMember & member)
+{
+  switch (field.array_kind) {
+    case Ros1ArrayKind::NONE:
+      return !member.is_array_;
+    case Ros1ArrayKind::FIXED_SIZE:
+      return member.is_array_ && (member.is_upper_bound_ ?
+             field.array_size <= member.array_size_ :
+             member.array_size_ == 0 || member.array_size_ == field.array_size);
+    case Ros1ArrayKind::SEQUENCE:
+      return is_sequence(member);
+  }
+  return false;
+}
+
+}  // namespace
+
+struct GenericFieldPlan
+{
+  enum class Kind : uint8_t
+  {
+    PRIMITIVE,
+    STRING,
+    MESSAGE
+  };
+
+  std::string name;
+  Kind kind;
+  Ros1ArrayKind array_kind;
+  uint32_t array_size;
+  /// Size of a primitive on the wire, the least size of a string or message, which may be 0
+  size_t ros1_size;
+  /// Member the field is read into, nullptr if the field is skipped
+  const MessageMember * member;
+  /// Reads primitives into the member
+  PrimitiveReadFunction read;
+  /// Size of an element of the member
+  size_t ros2_size;
+  /// Plan of the fields of messages
+  const GenericConverter::MessagePlan * message;
+  /// The member is a std::vector<bool>, whose elements are not stored as an array
+  bool bool_vector;
+  /// Number of elements of a bounded sequence at most, 0 if unbounded
+  size_t max_size;
+};
+
+struct GenericConverter::MessagePlan
+{
+  std::vector<GenericFieldPlan> fields;
+  /// Least size of the message on the wire, 0 for messages without fields
+  size_t ros1_size;
+};
+
+namespace
+{
+
+void read_message(
+  Ros1WireReader & reader, const GenericConverter::MessagePlan & plan, uint8_t * message);
+
+/// Reads count elements of the field into elements, or skips them if elements is nullptr
+void read_elements(
+  Ros1WireReader & reader, const GenericFieldPlan & field, void * elements, size_t count)
+{
+  switch (field.kind) {
+    case GenericFieldPlan::Kind::PRIMITIVE:
+      if (elements) {
+        field.read(reader, elements, count);
+      } else {
+        reader.skip(count * field.ros1_size);
+      }
+      break;
+    case GenericFieldPlan::Kind::STRING:
+      if (elements) {
+        reader.read_array(static_cast<std::string *>(elements), count);
+      } else {
+        reader.skip_strings(static_cast<uint32_t>(count));
+      }
+      break;
+    case GenericFieldPlan::Kind::MESSAGE:
+      {
+        auto message = static_cast<uint8_t *>(elements);
+        for (size_t i = 0; i < count; ++i) {
+          read_message(reader, *field.message, message ? message + i * field.ros2_size : nullptr);
+        }
+      }
+      break;
+  }
+}
+
+void read_message(
+  Ros1WireReader & reader, const GenericConverter::MessagePlan & plan, uint8_t * message)
+{
+  for (const auto & field : plan.fields) {
+    void * member = message && field.member ? message + field.member->offset_ : nullptr;
+    if (field.array_kind == Ros1ArrayKind::NONE) {
+      read_elements(reader, field, member, 1);
+      continue;
+    }
+
+    size_t count = field.array_size;
+    if (field.array_kind == Ros1ArrayKind::SEQUENCE) {
+      count = reader.read_sequence_length(field.ros1_size);
+    }
+    if (!member || !is_sequence(*field.member)) {
+      read_elements(reader, field, member, count);
+      continue;
+    }
+
+    if (field.max_size > 0 && count > field.max_size) {
+      throw std::runtime_error(
+              "ROS 1 field '" + field.name + "' has " + std::to_string(count) +
+              " elements, more than the ROS 2 member can hold");
+    }
+    if (field.bool_vector) {
+      auto & values = *static_cast<std::vector<bool> *>(member);
+      values.resize(count);
+      for (size_t i = 0; i < count; ++i) {
+        bool value;
+        field.read(reader, &value, 1);
+        values[i] = value;
+      }
+      continue;
+    }
+    field.member->resize_function(member, count);
+    if (count > 0) {
+      read_elements(reader, field, field.member->get_function(member, 0), count);
+    }
+  }
+}
+
+}  // namespace
+
+GenericConverter::GenericConverter(
+  const std::string & ros1_type_name,
+  const std::unordered_map<std::string, Ros1MessageDefinition> & ros1_definitions,
+  const rosidl_message_type_support_t * ros2_type_support)
+: ros1_definitions_(ros1_definitions)
+{
+  if (!ros2_type_support) {
+    throw std::runtime_error(
+            "Cannot convert '" + ros1_type_name + "' without the type support of its ROS 2 type");
+  }
+  // Read like messages into builtin_interfaces/msg/Time and Duration
+  ros1_definitions_["time"] = Ros1MessageDefinition{
+    "time", {{"uint32", "sec", Ros1ArrayKind::NONE, 0},
+      {"uint32", "nanosec", Ros1ArrayKind::NONE, 0}}};
+  ros1_definitions_["duration"] = Ros1MessageDefinition{
+    "duration", {{"int32", "sec", Ros1ArrayKind::NONE, 0},
+      {"int32", "nanosec", Ros1ArrayKind::NONE, 0}}};
+  plan_ = make_plan(ros1_type_name, static_cast<const MessageMembers *>(ros2_type_support->data));
+}
+
+GenericConverter::~GenericConverter() = default;
+
+void GenericConverter::convert(
+  ros::serialization::IStream & ros1_message, void * ros2_message) const
+{
+  Ros1WireReader reader(ros1_message);
+  read_message(reader, *plan_, static_cast<uint8_t *>(ros2_message));
+}
+
+const GenericConverter::MessagePlan * GenericConverter::make_plan(
+  const std::string & ros1_type_name, const MessageMembers * ros2_members)
+{
+  auto key = std::make_pair(ros1_type_name, ros2_members);
+  auto it = plans_.find(key);
+  if (it != plans_.end()) {
+    if (!it->second) {
+      throw std::runtime_error("ROS 1 message type '" + ros1_type_name + "' contains itself");
+    }
+    return it->second.get();
+  }
+  auto definition = ros1_definitions_.find(ros1_type_name);
+  if (definition == ros1_definitions_.end()) {
+    throw std::runtime_error(
+            "The ROS 1 message definition lacks the definition of '" + ros1_type_name + "'");
+  }
+  // Marks the plan as being made
+  plans_[key] = nullptr;
+
+  auto plan = std::make_unique<MessagePlan>();
+  for (const auto & ros1_field : definition->second.fields) {
+    GenericFieldPlan field{};
+    field.name = ros1_field.name;
+    field.array_kind = ros1_field.array_kind;
+    field.array_size = ros1_field.array_size;
+    field.member = find_member(ros2_members, ros1_field.name);
+
+    auto incompatible = [&ros1_type_name, &ros1_field]() {
+        return std::runtime_error(
+          "Cannot convert the field '" + ros1_field.name + "' of ROS 1 type '" + ros1_type_name +
+          "' into the ROS 2 member of the same name");
+      };
+    if (field.member) {
+      field.ros2_size = get_ros2_element_size(*field.member);
+      if (!is_array_compatible(ros1_field, *field.member) || field.ros2_size == 0) {
+        throw incompatible();
+      }
+      field.max_size = field.member->is_upper_bound_ ? field.member->array_size_ : 0;
+    }
+
+    namespace types = rosidl_typesupport_introspection_cpp;
+    if (ros1_field.type == "string") {
+      if (field.member && field.member->type_id_ != types::ROS_TYPE_STRING) {
+        throw incompatible();
+      }
+      field.kind = GenericFieldPlan::Kind::STRING;
+      field.ros1_size = sizeof(uint32_t);
+    } else if (get_ros1_primitive_size(ros1_field.type) > 0) {
+      field.kind = GenericFieldPlan::Kind::PRIMITIVE;
+      field.ros1_size = get_ros1_primitive_size(ros1_field.type);
+      if (field.member) {
+        field.read = select_read_function(ros1_field.type, field.member->type_id_);
+        if (!field.read) {
+          throw incompatible();
+        }
+        if (field.member->type_id_ == types::ROS_TYPE_BOOLEAN && is_sequence(*field.member)) {
+          // Bounded sequences of bool are no std::vector<bool>
+          if (field.member->is_upper_bound_) {
+            throw incompatible();
+          }
+          field.bool_vector = true;
+        }
+      }
+    } else {
+      if (field.member && field.member->type_id_ != types::ROS_TYPE_MESSAGE) {
+        throw incompatible();
+      }
+      field.kind = GenericFieldPlan::Kind::MESSAGE;
+      field.message = make_plan(
+        ros1_field.type, field.member ?
+        static_cast<const MessageMembers *>(field.member->members_->data) : nullptr);
+      field.ros1_size = field.message->ros1_size;
+    }
+    plan->fields.push_back(field);
+  }
+
+  plan->ros1_size = 0;
+  for (const auto & field : plan->fields) {
+    switch (field.array_kind) {
+      case Ros1ArrayKind::NONE:
+        plan->ros1_size += field.ros1_size;
+        break;
+      case Ros1ArrayKind::FIXED_SIZE:
+        plan->ros1_size += field.array_size * field.ros1_size;
+        break;
+      case Ros1ArrayKind::SEQUENCE:
+        plan->ros1_size += sizeof(uint32_t);
+        break;
+    }
+  }
+
+  auto result = plan.get();
+  plans_[key] = std::move(plan);
+  return result;
+}
+
+}  // namespace rosbag2_bag_v2_plugins
@@ -0,0 +1,83 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef ROSBAG2_BAG_V2_PLUGINS__GENERIC_CONVERTER_HPP_
+#define ROSBAG2_BAG_V2_PLUGINS__GENERIC_CONVERTER_HPP_
+
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ros/serialization.h"
+#include "rosidl_generator_c/message_type_support_struct.h"
+#include "rosidl_typesupport_introspection_cpp/message_introspection.hpp"
+
+#include "ros1_message_definition.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+/**
+ * Converts serialized ROS 1 messages of types without a generated converter into ROS 2 messages.
+ *
+ * The converter is built from the ROS 1 message definition stored in the bag and the introspection
+ * type support of the ROS 2 type, whose fields are matched by name. Fields which only exist in the
+ * ROS 1 message, like the seq of a Header, are skipped, and members which only exist in the ROS 2
+ * message keep their value. time and duration are read into builtin_interfaces/msg/Time and
+ * Duration. Which field is read how is planned once, so converting a message only follows the plan.
+ */
+class GenericConverter
+{
+public:
+  /**
+   * \param ros1_definitions definitions of the ROS 1 type and all types it uses, see
+   *   parse_ros1_message_definition
+   * \param ros2_type_support introspection type support of the ROS 2 type
+   * \throws std::runtime_error if a field cannot be read into the ROS 2 member of the same name
+   */
+  GenericConverter(
+    const std::string & ros1_type_name,
+    const std::unordered_map<std::string, Ros1MessageDefinition> & ros1_definitions,
+    const rosidl_message_type_support_t * ros2_type_support);
+
+  ~GenericConverter();
+
+  GenericConverter(const GenericConverter &) = delete;
+  GenericConverter & operator=(const GenericConverter &) = delete;
+
+  /// Reads a serialized ROS 1 message into a ROS 2 message allocated with the type support
+  void convert(ros::serialization::IStream & ros1_message, void * ros2_message) const;
+
+  struct MessagePlan;
+
+private:
+  const MessagePlan * make_plan(
+    const std::string & ros1_type_name,
+    const rosidl_typesupport_introspection_cpp::MessageMembers * ros2_members);
+
+  std::unordered_map<std::string, Ros1MessageDefinition> ros1_definitions_;
+  // Plans by ROS 1 type and ROS 2 members, nullptr for fields which are only skipped
+  std::map<
+    std::pair<std::string, const rosidl_typesupport_introspection_cpp::MessageMembers *>,
+    std::unique_ptr<MessagePlan>> plans_;
+  const MessagePlan * plan_;
+};
+
+}  // namespace rosbag2_bag_v2_plugins
+
+#endif  // ROSBAG2_BAG_V2_PLUGINS__GENERIC_CONVERTER_HPP_
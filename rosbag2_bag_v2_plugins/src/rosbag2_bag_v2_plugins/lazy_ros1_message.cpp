@@ -0,0 +1,151 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "lazy_ros1_message.hpp"
+
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "rcutils/allocator.h"
+
+#include "rosbag/message_instance.h"
+
+#include "rosbag2_cpp/types/introspection_message.hpp"
+
+#include "rosbag2_storage/serialized_bag_message.hpp"
+
+#include "borrowed_message_buffer.hpp"
+#include "converter_handle.hpp"
+#include "message_type_header.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+namespace
+{
+
+// Same lookup as RosbagV2Deserializer::get_converter, without its per-instance caches
+const ConverterHandle * find_converter(
+  const rcutils_uint8_array_t & serialized_data, size_t & payload_offset)
+{
+  payload_offset = 0;
+  auto converter = get_borrowed_message_converter(serialized_data);
+  if (converter) {
+    return converter;
+  }
+
+  if (has_compact_message_header(serialized_data)) {
+    payload_offset = COMPACT_MESSAGE_HEADER_LENGTH;
+    return get_converter_handle(read_compact_message_header(serialized_data));
+  }
+
+  auto data_type = reinterpret_cast<const char *>(serialized_data.buffer);
+  auto data_type_length = strnlen(data_type, serialized_data.buffer_length);
+  if (data_type_length == serialized_data.buffer_length) {
+    return nullptr;
+  }
+  converter = resolve_converter_handle(std::string(data_type, data_type_length));
+  payload_offset = converter ? converter->prefix_length : 0;
+  return converter;
+}
+
+}  // namespace
+
+LazyRos1Message::LazyRos1Message(
+  std::shared_ptr<const rosbag2_storage::SerializedBagMessage> serialized_message)
+: serialized_message_(std::move(serialized_message)),
+  converter_(nullptr),
+  payload_offset_(0)
+{
+  if (serialized_message_->serialized_data) {
+    converter_ = find_converter(*serialized_message_->serialized_data, payload_offset_);
+  }
+  if (!converter_) {
+    throw std::runtime_error(
+            "Message of topic '" + serialized_message_->topic_name +
+            "' is not a rosbag_v2 message of a type known to this process");
+  }
+}
+
+const rosbag2_storage::SerializedBagMessage & LazyRos1Message::get_serialized_message() const
+{
+  return *serialized_message_;
+}
+
+const uint8_t * LazyRos1Message::get_ros1_data() const
+{
+  return serialized_message_->serialized_data->buffer + payload_offset_;
+}
+
+size_t LazyRos1Message::get_ros1_data_length() const
+{
+  return serialized_message_->serialized_data->buffer_length - payload_offset_;
+}
+
+const std::string & LazyRos1Message::get_ros1_type_name() const
+{
+  return converter_->ros1_type_name;
+}
+
+const std::string & LazyRos1Message::get_ros2_type_name() const
+{
+  return converter_->ros2_type_name;
+}
+
+const ConverterHandle & LazyRos1Message::get_converter() const
+{
+  return *converter_;
+}
+
+bool LazyRos1Message::is_converted() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return ros2_message_ != nullptr;
+}
+
+std::shared_ptr<const rosbag2_cpp::rosbag2_introspection_message_t>
+LazyRos1Message::get_ros2_message() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (ros2_message_) {
+    return ros2_message_;
+  }
+
+  if (!converter_->ros2_type_support) {
+    throw std::runtime_error(
+            "Cannot convert message of type '" + converter_->ros1_type_name +
+            "', the type support of '" + converter_->ros2_type_name + "' is not available");
+  }
+  // The message keeps a pointer to its allocator, which therefore has to outlive all messages
+  static rcutils_allocator_t allocator = rcutils_get_default_allocator();
+  auto ros2_message = rosbag2_cpp::allocate_introspection_message(
+    converter_->ros2_type_support, &allocator);
+  // IStream only reads from the data, although it takes a non-const pointer
+  ros::serialization::IStream stream(
+    const_cast<uint8_t *>(get_ros1_data()), static_cast<uint32_t>(get_ros1_data_length()));
+  convert_message(*converter_, stream, ros2_message->message);
+  ros2_message->time_stamp = serialized_message_->time_stamp;
+  rosbag2_cpp::introspection_message_set_topic_name(
+    ros2_message.get(), serialized_message_->topic_name.c_str());
+
+  ros2_message_ = std::move(ros2_message);
+  return ros2_message_;
+}
+
+}  // namespace rosbag2_bag_v2_plugins
@@ -0,0 +1,88 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef ROSBAG2_BAG_V2_PLUGINS__LAZY_ROS1_MESSAGE_HPP_
+#define ROSBAG2_BAG_V2_PLUGINS__LAZY_ROS1_MESSAGE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "rosbag2_cpp/types/introspection_message.hpp"
+
+#include "rosbag2_storage/serialized_bag_message.hpp"
+
+#include "converter_handle.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+/**
+ * A rosbag_v2 message which is only converted into its ROS 2 type when that is accessed.
+ *
+ * Consumers which just forward or store the messages, e.g. bridges to ROS 1, can take the
+ * serialized ROS 1 message as it is in the bag and never pay for converting it. The md5sum and
+ * message definition of its type are available from RosbagV2Storage::get_ros1_connection.
+ * The message may be shared between threads.
+ */
+class LazyRos1Message
+{
+public:
+  /**
+   * \param serialized_message rosbag_v2 data read by the storage plugin, in any of its formats
+   * \throws std::runtime_error if the data is not a rosbag_v2 message of a type with a ROS 2
+   * counterpart
+   */
+  explicit LazyRos1Message(
+    std::shared_ptr<const rosbag2_storage::SerializedBagMessage> serialized_message);
+
+  const rosbag2_storage::SerializedBagMessage & get_serialized_message() const;
+
+  /// The ROS 1 message as serialized in the bag, without the type header of rosbag_v2 data
+  const uint8_t * get_ros1_data() const;
+
+  size_t get_ros1_data_length() const;
+
+  const std::string & get_ros1_type_name() const;
+
+  const std::string & get_ros2_type_name() const;
+
+  /// The converter of the type of the message, e.g. for transcoding it with convert_to_cdr
+  const ConverterHandle & get_converter() const;
+
+  /// True once get_ros2_message has been called
+  bool is_converted() const;
+
+  /**
+   * Converts the message into its ROS 2 type on the first call, later calls return the same
+   * message. The time stamp and topic name are set as by the rosbag_v2 converter plugin.
+   * \throws std::runtime_error if the type support of the ROS 2 type is not available
+   */
+  std::shared_ptr<const rosbag2_cpp::rosbag2_introspection_message_t> get_ros2_message() const;
+
+private:
+  std::shared_ptr<const rosbag2_storage::SerializedBagMessage> serialized_message_;
+  const ConverterHandle * converter_;
+  size_t payload_offset_;
+
+  mutable std::mutex mutex_;
+  mutable std::shared_ptr<rosbag2_cpp::rosbag2_introspection_message_t> ros2_message_;
+};
+
+}  // namespace rosbag2_bag_v2_plugins
+
+#endif  // ROSBAG2_BAG_V2_PLUGINS__LAZY_ROS1_MESSAGE_HPP_
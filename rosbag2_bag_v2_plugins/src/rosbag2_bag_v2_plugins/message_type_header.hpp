@@ -0,0 +1,74 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROSBAG2_BAG_V2_PLUGINS__MESSAGE_TYPE_HEADER_HPP_
+#define ROSBAG2_BAG_V2_PLUGINS__MESSAGE_TYPE_HEADER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "rcutils/types/uint8_array.h"
+
+#include "converter_handle.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+/**
+ * Serialized rosbag_v2 messages start with a header telling the deserializer their ROS 1 type.
+ *
+ * The storage plugin writes a compact header of fixed length:
+ *   byte 0: 0, which tells it apart from a type name, as type names are never empty
+ *   byte 1: COMPACT_MESSAGE_HEADER_VERSION
+ *   bytes 2-3: 0
+ *   bytes 4-7: id of the converter handle of the type, little endian
+ * The id is only meaningful within the process which read the message.
+ *
+ * Data written by older versions starts with the null-terminated type name instead, which the
+ * deserializer still understands.
+ */
+constexpr size_t COMPACT_MESSAGE_HEADER_LENGTH = 8;
+constexpr uint8_t COMPACT_MESSAGE_HEADER_VERSION = 1;
+
+inline void write_compact_message_header(const ConverterHandle & converter, uint8_t * header)
+{
+  header[0] = 0;
+  header[1] = COMPACT_MESSAGE_HEADER_VERSION;
+  header[2] = 0;
+  header[3] = 0;
+  for (size_t i = 0; i < 4; ++i) {
+    header[4 + i] = static_cast<uint8_t>(converter.id >> (8 * i));
+  }
+}
+
+inline bool has_compact_message_header(const rcutils_uint8_array_t & serialized_data)
+{
+  return serialized_data.buffer_length >= COMPACT_MESSAGE_HEADER_LENGTH &&
+         serialized_data.buffer[0] == 0 &&
+         serialized_data.buffer[1] == COMPACT_MESSAGE_HEADER_VERSION;
+}
+
+/// Must only be called if has_compact_message_header returned true
+inline uint32_t read_compact_message_header(const rcutils_uint8_array_t & serialized_data)
+{
+  const auto header = serialized_data.buffer;
+  return static_cast<uint32_t>(header[4]) |
+         static_cast<uint32_t>(header[5]) << 8 |
+         static_cast<uint32_t>(header[6]) << 16 |
+         static_cast<uint32_t>(header[7]) << 24;
+}
+
+}  // namespace rosbag2_bag_v2_plugins
+
+#endif  // ROSBAG2_BAG_V2_PLUGINS__MESSAGE_TYPE_HEADER_HPP_
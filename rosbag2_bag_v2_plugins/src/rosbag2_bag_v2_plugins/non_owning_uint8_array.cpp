@@ -0,0 +1,59 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "non_owning_uint8_array.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+namespace
+{
+
+void * refuse_allocate(size_t, void *)
+{
+  return nullptr;
+}
+
+void ignore_deallocate(void *, void *)
+{
+}
+
+void * refuse_reallocate(void *, size_t, void *)
+{
+  return nullptr;
+}
+
+void * refuse_zero_allocate(size_t, size_t, void *)
+{
+  return nullptr;
+}
+
+}  // namespace
+
+rcutils_uint8_array_t make_non_owning_uint8_array(
+  uint8_t * buffer, size_t buffer_length, void * state)
+{
+  rcutils_uint8_array_t array;
+  array.buffer = buffer;
+  array.buffer_length = buffer_length;
+  array.buffer_capacity = buffer_length;
+  array.allocator.allocate = &refuse_allocate;
+  array.allocator.deallocate = &ignore_deallocate;
+  array.allocator.reallocate = &refuse_reallocate;
+  array.allocator.zero_allocate = &refuse_zero_allocate;
+  array.allocator.state = state;
+  return array;
+}
+
+}  // namespace rosbag2_bag_v2_plugins
@@ -0,0 +1,38 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROSBAG2_BAG_V2_PLUGINS__NON_OWNING_UINT8_ARRAY_HPP_
+#define ROSBAG2_BAG_V2_PLUGINS__NON_OWNING_UINT8_ARRAY_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "rcutils/types/uint8_array.h"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+/**
+ * Creates serialized data which points at memory owned by someone else.
+ *
+ * The allocator of the array refuses all allocations and ignores deallocations, so the array can
+ * neither be resized nor free the memory. The allocator state is set to the given value and is
+ * never used by the allocator itself.
+ */
+rcutils_uint8_array_t make_non_owning_uint8_array(
+  uint8_t * buffer, size_t buffer_length, void * state);
+
+}  // namespace rosbag2_bag_v2_plugins
+
+#endif  // ROSBAG2_BAG_V2_PLUGINS__NON_OWNING_UINT8_ARRAY_HPP_
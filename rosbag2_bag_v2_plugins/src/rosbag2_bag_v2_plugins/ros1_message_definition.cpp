@@ -0,0 +1,146 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "ros1_message_definition.hpp"
+
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace rosbag2_bag_v2_plugins
+{
+
+namespace
+{
+
+std::string trim(const std::string & text)
+{
+  const char whitespace[] = " \t\r";
+  auto begin = text.find_first_not_of(whitespace);
+  if (begin == std::string::npos) {
+    return "";
+  }
+  auto end = text.find_last_not_of(whitespace);
+  return text.substr(begin, end - begin + 1);
+}
+
+std::string get_package(const std::string & type_name)
+{
+  auto separator = type_name.find('/');
+  return separator == std::string::npos ? "" : type_name.substr(0, separator);
+}
+
+std::string resolve_type(const std::string & type, const std::string & package)
+{
+  if (is_ros1_primitive_type(type) || type.find('/') != std::string::npos) {
+    return type;
+  }
+  // Header is the only message type which may be used without its package everywhere
+  if (type == "Header") {
+    return "std_msgs/Header";
+  }
+  return package + "/" + type;
+}
+
+Ros1FieldDefinition parse_field(const std::string & line, const std::string & package)
+{
+  std::istringstream stream(line);
+  std::string type;
+  Ros1FieldDefinition field;
+  if (!(stream >> type >> field.name)) {
+    throw std::runtime_error("Cannot parse the field '" + line + "' of a ROS 1 message definition");
+  }
+
+  field.array_kind = Ros1ArrayKind::NONE;
+  field.array_size = 0;
+  auto bracket = type.find('[');
+  if (bracket != std::string::npos) {
+    if (type.back() != ']') {
+      throw std::runtime_error("Cannot parse the type of the ROS 1 message field '" + line + "'");
+    }
+    auto size = type.substr(bracket + 1, type.size() - bracket - 2);
+    if (size.empty()) {
+      field.array_kind = Ros1ArrayKind::SEQUENCE;
+    } else {
+      field.array_kind = Ros1ArrayKind::FIXED_SIZE;
+      try {
+        field.array_size = static_cast<uint32_t>(std::stoul(size));
+      } catch (const std::logic_error &) {
+        throw std::runtime_error("Cannot parse the array size of the ROS 1 field '" + line + "'");
+      }
+    }
+    type = type.substr(0, bracket);
+  }
+  field.type = resolve_type(type, package);
+  return field;
+}
+
+}  // namespace
+
+bool is_ros1_primitive_type(const std::string & type)
+{
+  static const std::unordered_set<std::string> primitive_types{
+    "bool", "byte", "char", "int8", "uint8", "int16", "uint16", "int32", "uint32", "int64",
+    "uint64", "float32", "float64", "string", "time", "duration"};
+  return primitive_types.count(type) > 0;
+}
+
+std::unordered_map<std::string, Ros1MessageDefinition> parse_ros1_message_definition(
+  const std::string & type_name, const std::string & message_definition)
+{
+  std::unordered_map<std::string, Ros1MessageDefinition> definitions;
+  auto * definition = &definitions[type_name];
+  definition->type_name = type_name;
+
+  std::istringstream stream(message_definition);
+  std::string line;
+  while (std::getline(stream, line)) {
+    auto comment = line.find('#');
+    if (comment != std::string::npos) {
+      line.erase(comment);
+    }
+    line = trim(line);
+    if (line.empty()) {
+      continue;
+    }
+
+    if (line.find_first_not_of('=') == std::string::npos) {
+      // The separator is followed by the type of the next definition
+      definition = nullptr;
+      continue;
+    }
+    if (line.compare(0, 4, "MSG:") == 0) {
+      auto nested_type_name = trim(line.substr(4));
+      definition = &definitions[nested_type_name];
+      definition->type_name = nested_type_name;
+      continue;
+    }
+    if (!definition) {
+      throw std::runtime_error(
+              "ROS 1 message definition of '" + type_name + "' lacks a type after a separator");
+    }
+    // Constants are not serialized, e.g. "uint8 DEBUG=1"
+    if (line.find('=') != std::string::npos) {
+      continue;
+    }
+    definition->fields.push_back(parse_field(line, get_package(definition->type_name)));
+  }
+  return definitions;
+}
+
+}  // namespace rosbag2_bag_v2_plugins
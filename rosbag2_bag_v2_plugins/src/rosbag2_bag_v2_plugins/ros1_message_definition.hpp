@@ -0,0 +1,66 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROSBAG2_BAG_V2_PLUGINS__ROS1_MESSAGE_DEFINITION_HPP_
+#define ROSBAG2_BAG_V2_PLUGINS__ROS1_MESSAGE_DEFINITION_HPP_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace rosbag2_bag_v2_plugins
+{
+
+enum class Ros1ArrayKind : uint8_t
+{
+  NONE,
+  FIXED_SIZE,
+  SEQUENCE
+};
+
+struct Ros1FieldDefinition
+{
+  /// A primitive type like uint8, string or time, or the full name of a message type (pkg/Type)
+  std::string type;
+  std::string name;
+  Ros1ArrayKind array_kind;
+  /// Number of elements of a fixed size array
+  uint32_t array_size;
+};
+
+struct Ros1MessageDefinition
+{
+  std::string type_name;
+  /// Constants are left out, as they are not serialized
+  std::vector<Ros1FieldDefinition> fields;
+};
+
+/// Whether the type is a ROS 1 primitive type, including string, time and duration
+bool is_ros1_primitive_type(const std::string & type);
+
+/**
+ * Parses the message definition of a connection record of a ROS 1 bag.
+ * It holds the definition of the message type itself, followed by the definitions of all message
+ * types it uses, each after a line of '=' and a line "MSG: pkg/Type".
+ * Message types are resolved to their full name, e.g. Header to std_msgs/Header.
+ * \returns the definitions by type name, including the one of the message type itself
+ * \throws std::runtime_error if the definition cannot be parsed
+ */
+std::unordered_map<std::string, Ros1MessageDefinition> parse_ros1_message_definition(
+  const std::string & type_name, const std::string & message_definition);
+
+}  // namespace rosbag2_bag_v2_plugins
+
+#endif  // ROSBAG2_BAG_V2_PLUGINS__ROS1_MESSAGE_DEFINITION_HPP_
@@ -0,0 +1,230 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROSBAG2_BAG_V2_PLUGINS__ROS1_WIRE_READER_HPP_
+#define ROSBAG2_BAG_V2_PLUGINS__ROS1_WIRE_READER_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "ros/serialization.h"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+/**
+ * Reads fields of a serialized ROS 1 message straight into the fields of a ROS 2 message.
+ * Used by the converters generated for mappings with a CdrTranscoderPlan, i.e. whose fields match
+ * in order and wire representation, instead of deserializing a ROS 1 message and converting it.
+ *
+ * Arrays of primitives are copied with a single memcpy, only big endian hosts swap their bytes.
+ * Sequences and strings are resized, so a reused ROS 2 message keeps its capacity.
+ * Reads past the end of the stream throw ros::serialization::StreamOverrunException like roscpp.
+ */
+class Ros1WireReader
+{
+public:
+  explicit Ros1WireReader(ros::serialization::IStream & stream)
+  : stream_(stream) {}
+
+  uint32_t read_length()
+  {
+    uint32_t length;
+    read_primitives(&length, 1);
+    return length;
+  }
+
+  template<typename T>
+  typename std::enable_if<std::is_arithmetic<T>::value>::type read(T & value)
+  {
+    read_primitives(&value, 1);
+  }
+
+  void read(bool & value)
+  {
+    value = *stream_.advance(1) != 0;
+  }
+
+  template<typename Traits, typename Allocator>
+  void read(std::basic_string<char, Traits, Allocator> & value)
+  {
+    auto length = read_length();
+    value.assign(reinterpret_cast<const char *>(stream_.advance(length)), length);
+  }
+
+  template<typename T, typename Allocator>
+  void read(std::vector<T, Allocator> & values)
+  {
+    auto count = read_length();
+    // Strings take at least their length on the wire
+    check_remaining(count, std::is_arithmetic<T>::value ? sizeof(T) : sizeof(uint32_t));
+    values.resize(count);
+    read_elements(values.data(), count);
+  }
+
+  template<typename Allocator>
+  void read(std::vector<bool, Allocator> & values)
+  {
+    auto count = read_length();
+    check_remaining(count, 1);
+    values.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+      values[i] = *stream_.advance(1) != 0;
+    }
+  }
+
+  template<typename T, size_t N>
+  void read(std::array<T, N> & values)
+  {
+    read_elements(values.data(), N);
+  }
+
+  /**
+   * Reads a sequence or fixed size array of messages with the generated read function
+   * \param message_size minimum size of a message on the wire, 0 for messages without fields
+   */
+  template<typename T, typename Allocator, typename ReadFunction>
+  void read_messages(
+    std::vector<T, Allocator> & messages, ReadFunction read_message, size_t message_size)
+  {
+    auto count = read_length();
+    check_remaining(count, message_size);
+    messages.resize(count);
+    for (auto & message : messages) {
+      read_message(*this, message);
+    }
+  }
+
+  template<typename T, size_t N, typename ReadFunction>
+  void read_messages(
+    std::array<T, N> & messages, ReadFunction read_message, size_t /* message_size */)
+  {
+    for (auto & message : messages) {
+      read_message(*this, message);
+    }
+  }
+
+  /// Reads count primitives or strings, e.g. into a sequence resized before
+  template<typename T>
+  void read_array(T * values, size_t count)
+  {
+    read_elements(values, count);
+  }
+
+  /// Reads the length of a sequence whose elements take at least element_size bytes on the wire
+  uint32_t read_sequence_length(size_t element_size)
+  {
+    auto count = read_length();
+    check_remaining(count, element_size);
+    return count;
+  }
+
+  /// Skips a field which only exists in the ROS 1 message
+  void skip(size_t length)
+  {
+    stream_.advance(static_cast<uint32_t>(length));
+  }
+
+  void skip_sequence(size_t element_size)
+  {
+    auto count = read_length();
+    check_remaining(count, element_size);
+    skip(count * element_size);
+  }
+
+  void skip_strings(uint32_t count)
+  {
+    for (uint32_t i = 0; i < count; ++i) {
+      skip(read_length());
+    }
+  }
+
+private:
+  void check_remaining(uint32_t count, size_t element_size)
+  {
+    // Checked before resizing, so that a corrupt length cannot cause a huge allocation. Elements
+    // without any fields take no space, so there is no limit to their count.
+    if (element_size > 0 && count > stream_.getLength() / element_size) {
+      ros::serialization::throwStreamOverrun();
+    }
+  }
+
+  template<typename T>
+  void read_primitives(T * values, size_t count)
+  {
+    static_assert(std::is_arithmetic<T>::value, "Only primitives can be copied");
+    auto length = count * sizeof(T);
+    std::memcpy(values, stream_.advance(static_cast<uint32_t>(length)), length);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    // ROS 1 messages are little endian
+    if (sizeof(T) > 1) {
+      auto bytes = reinterpret_cast<uint8_t *>(values);
+      for (size_t i = 0; i < length; i += sizeof(T)) {
+        for (size_t j = 0; j < sizeof(T) / 2; ++j) {
+          std::swap(bytes[i + j], bytes[i + sizeof(T) - 1 - j]);
+        }
+      }
+    }
+#endif
+  }
+
+  template<typename T>
+  void read_elements(T * values, size_t count)
+  {
+    read_elements(values, count, std::is_arithmetic<T>());
+  }
+
+  template<typename T>
+  void read_elements(T * values, size_t count, std::true_type /* is_arithmetic */)
+  {
+    read_primitives(values, count);
+  }
+
+  // Strings have to be read one by one
+  template<typename T>
+  void read_elements(T * values, size_t count, std::false_type /* is_arithmetic */)
+  {
+    for (size_t i = 0; i < count; ++i) {
+      read(values[i]);
+    }
+  }
+
+  // bool may only hold 0 or 1, which ROS 1 does not guarantee
+  void read_elements(bool * values, size_t count)
+  {
+    for (size_t i = 0; i < count; ++i) {
+      read(values[i]);
+    }
+  }
+
+  ros::serialization::IStream & stream_;
+};
+
+/// Reads a ROS 1 time or duration into a builtin_interfaces/msg/Time or Duration
+template<typename T>
+void read_ros1_time(Ros1WireReader & reader, T & time)
+{
+  reader.read(time.sec);
+  reader.read(time.nanosec);
+}
+
+}  // namespace rosbag2_bag_v2_plugins
+
+#endif  // ROSBAG2_BAG_V2_PLUGINS__ROS1_WIRE_READER_HPP_
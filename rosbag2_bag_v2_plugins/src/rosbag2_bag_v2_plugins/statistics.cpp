@@ -0,0 +1,67 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "statistics.hpp"
+
+#include <map>
+#include <ostream>
+#include <string>
+
+namespace rosbag2_bag_v2_plugins
+{
+
+namespace
+{
+
+double to_milliseconds(uint64_t nanoseconds)
+{
+  return static_cast<double>(nanoseconds) / 1e6;
+}
+
+void print_topics(
+  std::ostream & stream, const std::map<std::string, TopicStatistics> & topics,
+  const char * time_name)
+{
+  for (const auto & topic : topics) {
+    stream << "\n  " << topic.first << ": " << topic.second.messages << " messages, " <<
+      topic.second.bytes << " bytes, " << to_milliseconds(topic.second.nanoseconds) << " ms " <<
+      time_name;
+  }
+}
+
+}  // namespace
+
+std::ostream & operator<<(std::ostream & stream, const StorageStatistics & statistics)
+{
+  stream << "Read " << statistics.chunks << " chunks of " << statistics.chunk_bytes <<
+    " bytes in " << to_milliseconds(statistics.chunk_read_nanoseconds) << " ms (decrypting " <<
+    to_milliseconds(statistics.chunk_decrypt_nanoseconds) << " ms, decompressing " <<
+    to_milliseconds(statistics.chunk_decompress_nanoseconds) << " ms), waited " <<
+    to_milliseconds(statistics.chunk_wait_nanoseconds) << " ms for chunks (" <<
+    statistics.chunk_stalls << " stalls, up to " << statistics.max_prefetched_chunks <<
+    " chunks of " << statistics.max_prefetched_bytes << " bytes prefetched), " <<
+    statistics.allocations << " allocations";
+  print_topics(stream, statistics.topics, "copying");
+  return stream;
+}
+
+std::ostream & operator<<(std::ostream & stream, const ConversionStatistics & statistics)
+{
+  stream << "Converted messages, " << to_milliseconds(statistics.lookup_nanoseconds) <<
+    " ms finding converters";
+  print_topics(stream, statistics.topics, "converting");
+  return stream;
+}
+
+}  // namespace rosbag2_bag_v2_plugins
@@ -0,0 +1,126 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROSBAG2_BAG_V2_PLUGINS__STATISTICS_HPP_
+#define ROSBAG2_BAG_V2_PLUGINS__STATISTICS_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+
+// Counters and timers of the hot paths of the storage and converter plugins. They are compiled in
+// with the CMake option ROSBAG2_BAG_V2_PLUGINS_STATISTICS, otherwise every statement updating them
+// is optimized away and the statistics queried stay zero.
+
+namespace rosbag2_bag_v2_plugins
+{
+
+#ifdef ROSBAG2_BAG_V2_PLUGINS_ENABLE_STATISTICS
+constexpr bool STATISTICS_ENABLED = true;
+#else
+constexpr bool STATISTICS_ENABLED = false;
+#endif
+
+/// Measures the time since its construction, if statistics are enabled
+class StatisticsTimer
+{
+public:
+  StatisticsTimer()
+  {
+    if (STATISTICS_ENABLED) {
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  uint64_t get_elapsed_nanoseconds() const
+  {
+    if (!STATISTICS_ENABLED) {
+      return 0;
+    }
+    return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start_).count());
+  }
+
+private:
+  std::chrono::steady_clock::time_point start_;
+};
+
+struct TopicStatistics
+{
+  uint64_t messages = 0;
+  /// Serialized ROS 1 message data, without type headers
+  uint64_t bytes = 0;
+  /// Time spent on the messages, what is measured depends on where the statistics come from
+  uint64_t nanoseconds = 0;
+};
+
+/**
+ * Chunks read by the storage, updated from the prefetch threads as well. Times of the prefetch
+ * threads are summed, so they may exceed the time passed while reading.
+ */
+struct ChunkStatistics
+{
+  std::atomic<uint64_t> chunks{0};
+  /// Data of the chunks after decrypting and decompressing them
+  std::atomic<uint64_t> bytes{0};
+  /// Reading, decrypting, decompressing and indexing chunks
+  std::atomic<uint64_t> read_nanoseconds{0};
+  std::atomic<uint64_t> decrypt_nanoseconds{0};
+  std::atomic<uint64_t> decompress_nanoseconds{0};
+  /// Time the reader waited for chunks, all of read_nanoseconds if chunks are not prefetched
+  std::atomic<uint64_t> wait_nanoseconds{0};
+  /// Prefetched chunks the reader had to wait for, as they were not decompressed yet
+  std::atomic<uint64_t> stalls{0};
+  /// Most chunks, and size of the decompressed ones, read ahead of the reader at once
+  std::atomic<uint64_t> max_prefetched_chunks{0};
+  std::atomic<uint64_t> max_prefetched_bytes{0};
+};
+
+struct StorageStatistics
+{
+  /// Messages read per topic, nanoseconds are spent copying or transcoding them
+  std::map<std::string, TopicStatistics> topics;
+  uint64_t chunks = 0;
+  uint64_t chunk_bytes = 0;
+  uint64_t chunk_read_nanoseconds = 0;
+  uint64_t chunk_decrypt_nanoseconds = 0;
+  uint64_t chunk_decompress_nanoseconds = 0;
+  uint64_t chunk_wait_nanoseconds = 0;
+  uint64_t chunk_stalls = 0;
+  uint64_t max_prefetched_chunks = 0;
+  uint64_t max_prefetched_bytes = 0;
+  /// Heap allocations of messages and their data, including the misses of the message pool
+  uint64_t allocations = 0;
+};
+
+struct ConversionStatistics
+{
+  /// Messages converted per topic, nanoseconds are spent in the generated converters
+  std::map<std::string, TopicStatistics> topics;
+  /// Time spent finding the converters of the messages
+  uint64_t lookup_nanoseconds = 0;
+};
+
+/// Multi-line summary, e.g. to be logged
+std::ostream & operator<<(std::ostream & stream, const StorageStatistics & statistics);
+
+std::ostream & operator<<(std::ostream & stream, const ConversionStatistics & statistics);
+
+}  // namespace rosbag2_bag_v2_plugins
+
+#endif  // ROSBAG2_BAG_V2_PLUGINS__STATISTICS_HPP_
@@ -0,0 +1,323 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bag_chunk.hpp"
+
+#include <bzlib.h>
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "roslz4/lz4s.h"
+
+#include "bag_format.hpp"
+#include "../statistics.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+Chunk::Chunk(std::vector<uint8_t> data, std::vector<ChunkMessage> messages)
+: data_(std::move(data)),
+  data_pointer_(data_.data()),
+  size_(data_.size()),
+  messages_(std::move(messages)) {}
+
+Chunk::Chunk(
+  std::shared_ptr<const void> data_owner, const uint8_t * data, size_t size,
+  std::vector<ChunkMessage> messages)
+: data_owner_(std::move(data_owner)),
+  data_pointer_(data),
+  size_(size),
+  messages_(std::move(messages)) {}
+
+const uint8_t * Chunk::get_data() const
+{
+  return data_pointer_;
+}
+
+size_t Chunk::get_size() const
+{
+  return size_;
+}
+
+const std::vector<ChunkMessage> & Chunk::get_messages() const
+{
+  return messages_;
+}
+
+namespace
+{
+
+void decompress(
+  const std::string & compression,
+  const uint8_t * compressed_data, size_t compressed_size,
+  std::vector<uint8_t> & data)
+{
+  // Neither library writes to its input, they just do not declare it const
+  auto source = reinterpret_cast<char *>(const_cast<uint8_t *>(compressed_data));
+  unsigned int data_length = static_cast<unsigned int>(data.size());
+  if (compression == "bz2") {
+    auto ret = BZ2_bzBuffToBuffDecompress(
+      reinterpret_cast<char *>(data.data()), &data_length,
+      source, static_cast<unsigned int>(compressed_size), 0, 0);
+    if (ret != BZ_OK) {
+      throw std::runtime_error("Could not decompress bz2 chunk. Error code " + std::to_string(ret));
+    }
+  } else if (compression == "lz4") {
+    auto ret = roslz4_buffToBuffDecompress(
+      source, static_cast<unsigned int>(compressed_size),
+      reinterpret_cast<char *>(data.data()), &data_length);
+    if (ret != ROSLZ4_OK) {
+      throw std::runtime_error("Could not decompress lz4 chunk. Error code " + std::to_string(ret));
+    }
+  } else {
+    throw std::runtime_error("Unknown chunk compression '" + compression + "'");
+  }
+  if (data_length != data.size()) {
+    throw std::runtime_error("Decompressed chunk does not have the size stated in its header");
+  }
+}
+
+void decrypt(
+  const BagDecryptor & decryptor, const uint8_t * encrypted_data, size_t encrypted_size,
+  std::vector<uint8_t> & data, ChunkStatistics * statistics)
+{
+  StatisticsTimer timer;
+  decryptor.decrypt(encrypted_data, encrypted_size, data);
+  if (STATISTICS_ENABLED && statistics) {
+    statistics->decrypt_nanoseconds += timer.get_elapsed_nanoseconds();
+  }
+}
+
+void decompress(
+  const std::string & compression,
+  const uint8_t * compressed_data, size_t compressed_size,
+  std::vector<uint8_t> & data, ChunkStatistics * statistics)
+{
+  StatisticsTimer timer;
+  decompress(compression, compressed_data, compressed_size, data);
+  if (STATISTICS_ENABLED && statistics) {
+    statistics->decompress_nanoseconds += timer.get_elapsed_nanoseconds();
+  }
+}
+
+std::vector<ChunkMessage> collect_messages(
+  const uint8_t * data, size_t size, const std::unordered_set<uint32_t> & connection_ids,
+  uint32_t connection_id_offset)
+{
+  std::vector<ChunkMessage> messages;
+  size_t position = 0;
+  while (position + 4 <= size) {
+    auto header_length = bag_format::read_uint32(data + position);
+    position += 4;
+    if (header_length > size - position || size - position - header_length < 4) {
+      throw std::runtime_error("Bag chunk is corrupt");
+    }
+    bag_format::RecordHeader header(data + position, header_length);
+    position += header_length;
+    auto data_length = bag_format::read_uint32(data + position);
+    position += 4;
+    if (data_length > size - position) {
+      throw std::runtime_error("Bag chunk is corrupt");
+    }
+
+    // Chunks also contain connection records, which are already known from the index
+    if (header.get_op() == bag_format::OpCode::MESSAGE_DATA) {
+      auto connection_id = header.get_uint32("conn") + connection_id_offset;
+      if (connection_ids.count(connection_id) > 0) {
+        messages.push_back(
+          {header.get_time("time"), connection_id, static_cast<uint32_t>(position), data_length});
+      }
+    }
+    position += data_length;
+  }
+
+  std::stable_sort(
+    messages.begin(), messages.end(),
+    [](const ChunkMessage & lhs, const ChunkMessage & rhs) {
+      return lhs.time < rhs.time;
+    });
+  return messages;
+}
+
+std::shared_ptr<const Chunk> read_chunk(
+  std::istream & file,
+  uint64_t chunk_position,
+  const std::unordered_set<uint32_t> & connection_ids,
+  uint32_t connection_id_offset,
+  const BagDecryptor * decryptor,
+  ChunkStatistics * statistics)
+{
+  file.clear();
+  file.seekg(static_cast<std::streamoff>(chunk_position));
+  bag_format::Record record;
+  bag_format::read_record(file, record);
+  auto header = record.header();
+  if (header.get_op() != bag_format::OpCode::CHUNK) {
+    throw std::runtime_error(
+            "Expected a chunk record at position " + std::to_string(chunk_position));
+  }
+
+  if (decryptor) {
+    // Only the data of chunk records is encrypted, their header is not
+    std::vector<uint8_t> decrypted_data;
+    decrypt(*decryptor, record.data.data(), record.data.size(), decrypted_data, statistics);
+    record.data = std::move(decrypted_data);
+  }
+
+  auto compression = header.get_string("compression");
+  std::vector<uint8_t> data;
+  if (compression == "none") {
+    data = std::move(record.data);
+  } else {
+    data.resize(header.get_uint32("size"));
+    decompress(compression, record.data.data(), record.data.size(), data, statistics);
+  }
+
+  auto messages = collect_messages(data.data(), data.size(), connection_ids, connection_id_offset);
+  return std::make_shared<const Chunk>(std::move(data), std::move(messages));
+}
+
+std::shared_ptr<const Chunk> read_mapped_chunk(
+  const std::shared_ptr<const MappedFile> & file,
+  uint64_t chunk_position,
+  const std::unordered_set<uint32_t> & connection_ids,
+  uint32_t connection_id_offset,
+  const BagDecryptor * decryptor,
+  ChunkStatistics * statistics)
+{
+  auto record = bag_format::read_record(file->data(), file->size(), chunk_position);
+  if (record.header.get_op() != bag_format::OpCode::CHUNK) {
+    throw std::runtime_error(
+            "Expected a chunk record at position " + std::to_string(chunk_position));
+  }
+  // Without the hint, the chunk would be read page by page as it is parsed
+  file->will_need(static_cast<uint64_t>(record.data - file->data()), record.data_length);
+
+  auto compression = record.header.get_string("compression");
+  if (decryptor) {
+    // Encrypted chunks are decrypted straight from the mapping, but cannot be referenced in place
+    std::vector<uint8_t> decrypted_data;
+    decrypt(*decryptor, record.data, record.data_length, decrypted_data, statistics);
+    std::vector<uint8_t> data;
+    if (compression == "none") {
+      data = std::move(decrypted_data);
+    } else {
+      data.resize(record.header.get_uint32("size"));
+      decompress(compression, decrypted_data.data(), decrypted_data.size(), data, statistics);
+    }
+    auto messages = collect_messages(
+      data.data(), data.size(), connection_ids, connection_id_offset);
+    return std::make_shared<const Chunk>(std::move(data), std::move(messages));
+  }
+  if (compression == "none") {
+    // Messages point straight into the mapping, which the chunk keeps alive
+    auto messages = collect_messages(
+      record.data, record.data_length, connection_ids, connection_id_offset);
+    return std::make_shared<const Chunk>(
+      file, record.data, record.data_length, std::move(messages));
+  }
+
+  std::vector<uint8_t> data(record.header.get_uint32("size"));
+  decompress(compression, record.data, record.data_length, data, statistics);
+  auto messages = collect_messages(data.data(), data.size(), connection_ids, connection_id_offset);
+  return std::make_shared<const Chunk>(std::move(data), std::move(messages));
+}
+
+}  // namespace
+
+std::shared_ptr<const Chunk> read_chunk(
+  std::istream & file,
+  uint64_t chunk_position,
+  const std::unordered_set<uint32_t> & connection_ids)
+{
+  return read_chunk(file, chunk_position, connection_ids, 0, nullptr, nullptr);
+}
+
+BagFileStreams::BagFileStreams(
+  std::shared_ptr<const BagIndex> bag_index, bool memory_mapped, ChunkStatistics * statistics)
+: bag_index_(std::move(bag_index)),
+  memory_mapped_(memory_mapped),
+  statistics_(statistics),
+  files_(memory_mapped_ ? 0 : bag_index_->get_file_count()),
+  mapped_files_(memory_mapped_ ? bag_index_->get_file_count() : 0) {}
+
+bool BagFileStreams::is_memory_mapped() const
+{
+  return memory_mapped_;
+}
+
+ChunkStatistics * BagFileStreams::get_statistics() const
+{
+  return statistics_;
+}
+
+std::istream & BagFileStreams::get(size_t file_index)
+{
+  auto & file = files_.at(file_index);
+  if (!file) {
+    const auto & path = bag_index_->get_file_path(file_index);
+    file = std::make_unique<std::ifstream>(path, std::ios::binary);
+    if (!*file) {
+      file.reset();
+      throw std::runtime_error("Could not open bag file '" + path + "'");
+    }
+  }
+  return *file;
+}
+
+const std::shared_ptr<const MappedFile> & BagFileStreams::get_mapped(size_t file_index)
+{
+  auto & mapped_file = mapped_files_.at(file_index);
+  if (!mapped_file) {
+    mapped_file = MappedFile::open(bag_index_->get_file_path(file_index));
+  }
+  return mapped_file;
+}
+
+std::shared_ptr<const Chunk> read_chunk(
+  BagFileStreams & files,
+  const BagIndex & bag_index,
+  const ChunkInfoRecord & chunk_info,
+  const std::unordered_set<uint32_t> & connection_ids)
+{
+  auto connection_id_offset = bag_index.get_connection_id_offset(chunk_info.file_index);
+  auto decryptor = bag_index.get_decryptor(chunk_info.file_index);
+  auto statistics = files.get_statistics();
+  StatisticsTimer timer;
+  std::shared_ptr<const Chunk> chunk;
+  if (files.is_memory_mapped()) {
+    chunk = read_mapped_chunk(
+      files.get_mapped(chunk_info.file_index), chunk_info.chunk_position, connection_ids,
+      connection_id_offset, decryptor, statistics);
+  } else {
+    chunk = read_chunk(
+      files.get(chunk_info.file_index), chunk_info.chunk_position, connection_ids,
+      connection_id_offset, decryptor, statistics);
+  }
+  if (STATISTICS_ENABLED && statistics) {
+    ++statistics->chunks;
+    statistics->bytes += chunk->get_size();
+    statistics->read_nanoseconds += timer.get_elapsed_nanoseconds();
+  }
+  return chunk;
+}
+
+}  // namespace rosbag2_bag_v2_plugins
@@ -0,0 +1,133 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROSBAG2_BAG_V2_PLUGINS__STORAGE__BAG_CHUNK_HPP_
+#define ROSBAG2_BAG_V2_PLUGINS__STORAGE__BAG_CHUNK_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+#include "bag_index.hpp"
+#include "mapped_file.hpp"
+#include "../statistics.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+struct ChunkMessage
+{
+  /// Time stamp in nanoseconds
+  uint64_t time;
+  uint32_t connection_id;
+  /// Position and length of the serialized ROS 1 message within the chunk data
+  uint32_t data_offset;
+  uint32_t data_length;
+};
+
+/**
+ * The decompressed data of a chunk together with the messages it contains.
+ */
+class Chunk
+{
+public:
+  Chunk(std::vector<uint8_t> data, std::vector<ChunkMessage> messages);
+
+  /// Refers to data owned by another object, e.g. the MappedFile of an uncompressed chunk
+  Chunk(
+    std::shared_ptr<const void> data_owner, const uint8_t * data, size_t size,
+    std::vector<ChunkMessage> messages);
+
+  Chunk(const Chunk &) = delete;
+  Chunk & operator=(const Chunk &) = delete;
+
+  const uint8_t * get_data() const;
+
+  size_t get_size() const;
+
+  /// Messages sorted by time stamp, messages with equal time stamps keep their order in the chunk
+  const std::vector<ChunkMessage> & get_messages() const;
+
+private:
+  std::vector<uint8_t> data_;
+  std::shared_ptr<const void> data_owner_;
+  const uint8_t * data_pointer_;
+  size_t size_;
+  std::vector<ChunkMessage> messages_;
+};
+
+/**
+ * Reads the chunk record at the given position and decompresses it.
+ * Only messages of the given connections are collected.
+ * \throws std::runtime_error if the chunk cannot be read or decompressed
+ */
+std::shared_ptr<const Chunk> read_chunk(
+  std::istream & file,
+  uint64_t chunk_position,
+  const std::unordered_set<uint32_t> & connection_ids);
+
+/**
+ * Streams of the files of a bag, each one opened when it is first read from.
+ * Used by a single thread, other threads need streams of their own.
+ *
+ * Memory mapped files are parsed in place instead of being read into buffers, and the data of
+ * uncompressed chunks is not copied at all.
+ */
+class BagFileStreams
+{
+public:
+  /// \param statistics counts the chunks read through these streams, if not null
+  explicit BagFileStreams(
+    std::shared_ptr<const BagIndex> bag_index, bool memory_mapped = false,
+    ChunkStatistics * statistics = nullptr);
+
+  bool is_memory_mapped() const;
+
+  ChunkStatistics * get_statistics() const;
+
+  /// \throws std::runtime_error if the file cannot be opened
+  std::istream & get(size_t file_index);
+
+  /**
+   * Only for memory mapped streams.
+   * \throws std::runtime_error if the file cannot be mapped
+   */
+  const std::shared_ptr<const MappedFile> & get_mapped(size_t file_index);
+
+private:
+  std::shared_ptr<const BagIndex> bag_index_;
+  bool memory_mapped_;
+  ChunkStatistics * statistics_;
+  std::vector<std::unique_ptr<std::ifstream>> files_;
+  std::vector<std::shared_ptr<const MappedFile>> mapped_files_;
+};
+
+/**
+ * Reads the chunk of a chunk info of the index from the file it lies in, see read_chunk above.
+ * Connection ids are the ones of the index, which differ from the ones in the file for split bags.
+ * Chunks of encrypted files are decrypted, which is the costly part of reading them.
+ */
+std::shared_ptr<const Chunk> read_chunk(
+  BagFileStreams & files,
+  const BagIndex & bag_index,
+  const ChunkInfoRecord & chunk_info,
+  const std::unordered_set<uint32_t> & connection_ids);
+
+}  // namespace rosbag2_bag_v2_plugins
+
+#endif  // ROSBAG2_BAG_V2_PLUGINS__STORAGE__BAG_CHUNK_HPP_
@@ -0,0 +1,185 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "bag_decryptor.hpp"
+
+#ifdef ROSBAG2_BAG_V2_PLUGINS_ENABLE_DECRYPTION
+#include <gpgme.h>
+#include <openssl/evp.h>
+#endif
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "bag_format.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+namespace
+{
+
+// The AesCbcEncryptor uses AES-128, whose key length equals the block length
+constexpr size_t AES_BLOCK_SIZE = 16;
+
+std::string get_header_field(const bag_format::RecordHeader & bag_header, const char * name)
+{
+  if (!bag_header.has_field(name)) {
+    throw std::runtime_error(
+            std::string("Encrypted bag has no field '") + name + "' in its header");
+  }
+  return bag_header.get_string(name);
+}
+
+constexpr const char DECRYPTION_DISABLED_ERROR[] =
+  "Cannot decrypt bags, rosbag2_bag_v2_plugins was built without decryption";
+
+#ifdef ROSBAG2_BAG_V2_PLUGINS_ENABLE_DECRYPTION
+std::string decrypt_with_gpg(const std::string & encrypted)
+{
+  static std::once_flag gpgme_initialized;
+  // GPGME must learn its version before contexts may be created, even on different threads
+  std::call_once(gpgme_initialized, []() {gpgme_check_version(nullptr);});
+
+  auto check = [](gpgme_error_t error, const char * action) {
+      if (error) {
+        throw std::runtime_error(
+                std::string("Could not ") + action + " to decrypt the key of an encrypted bag: " +
+                gpgme_strerror(error));
+      }
+    };
+
+  gpgme_ctx_t context;
+  check(gpgme_new(&context), "create a GPG context");
+  std::unique_ptr<std::remove_pointer<gpgme_ctx_t>::type, decltype(& gpgme_release)>
+  context_owner(context, &gpgme_release);
+
+  gpgme_data_t cipher_data;
+  check(
+    gpgme_data_new_from_mem(&cipher_data, encrypted.data(), encrypted.size(), 0),
+    "read the key");
+  std::unique_ptr<std::remove_pointer<gpgme_data_t>::type, decltype(& gpgme_data_release)>
+  cipher_data_owner(cipher_data, &gpgme_data_release);
+
+  gpgme_data_t plain_data;
+  check(gpgme_data_new(&plain_data), "allocate the key");
+  std::unique_ptr<std::remove_pointer<gpgme_data_t>::type, decltype(& gpgme_data_release)>
+  plain_data_owner(plain_data, &gpgme_data_release);
+
+  check(gpgme_op_decrypt(context, cipher_data, plain_data), "use GPG");
+
+  size_t length = 0;
+  auto plain = gpgme_data_release_and_get_mem(plain_data_owner.release(), &length);
+  std::string key(plain ? plain : "", plain ? length : 0);
+  gpgme_free(plain);
+  return key;
+}
+#else
+std::string decrypt_with_gpg(const std::string &)
+{
+  throw std::runtime_error(DECRYPTION_DISABLED_ERROR);
+}
+#endif
+
+}  // namespace
+
+constexpr const char * BagDecryptor::AES_CBC_ENCRYPTOR;
+
+std::shared_ptr<const BagDecryptor> BagDecryptor::create(
+  const bag_format::RecordHeader & bag_header)
+{
+  // The GPG user in the "gpg_user" field is only needed for encrypting, GPG finds the secret key
+  // for decrypting by itself
+  auto encrypted_key = get_header_field(bag_header, "encrypted_key");
+  auto symmetric_key = SymmetricKeyCache::get_instance().get(encrypted_key, &decrypt_with_gpg);
+  return std::make_shared<const BagDecryptor>(std::move(symmetric_key));
+}
+
+BagDecryptor::BagDecryptor(std::string symmetric_key)
+: symmetric_key_(std::move(symmetric_key))
+{
+  if (symmetric_key_.size() != AES_BLOCK_SIZE) {
+    throw std::runtime_error("The key of an encrypted bag is not an AES-128 key");
+  }
+}
+
+void BagDecryptor::decrypt(
+  const uint8_t * data, size_t size, std::vector<uint8_t> & decrypted) const
+{
+  if (size < 2 * AES_BLOCK_SIZE || size % AES_BLOCK_SIZE != 0) {
+    throw std::runtime_error("Encrypted bag data is not a whole number of AES blocks");
+  }
+
+#ifdef ROSBAG2_BAG_V2_PLUGINS_ENABLE_DECRYPTION
+  // EVP picks the AES-NI implementation on CPUs supporting it, which decrypts several CBC blocks
+  // at once, contrary to the AES_cbc_encrypt used by rosbag_storage
+  std::unique_ptr<EVP_CIPHER_CTX, decltype(& EVP_CIPHER_CTX_free)> context(
+    EVP_CIPHER_CTX_new(), &EVP_CIPHER_CTX_free);
+  if (!context ||
+    EVP_DecryptInit_ex(
+      context.get(), EVP_aes_128_cbc(), nullptr,
+      reinterpret_cast<const unsigned char *>(symmetric_key_.data()), data) != 1)
+  {
+    throw std::runtime_error("Could not initialize AES decryption");
+  }
+
+  // EVP wants room for one more block than it is given, the padding is cut off afterwards
+  auto cipher_text_size = size - AES_BLOCK_SIZE;
+  decrypted.resize(cipher_text_size + AES_BLOCK_SIZE);
+  int update_length = 0;
+  int final_length = 0;
+  if (EVP_DecryptUpdate(
+      context.get(), decrypted.data(), &update_length, data + AES_BLOCK_SIZE,
+      static_cast<int>(cipher_text_size)) != 1 ||
+    EVP_DecryptFinal_ex(context.get(), decrypted.data() + update_length, &final_length) != 1)
+  {
+    throw std::runtime_error(
+            "Could not decrypt bag data, it is corrupt or was encrypted with a different key");
+  }
+  decrypted.resize(static_cast<size_t>(update_length + final_length));
+#else
+  (void)data;
+  (void)decrypted;
+  throw std::runtime_error(DECRYPTION_DISABLED_ERROR);
+#endif
+}
+
+SymmetricKeyCache & SymmetricKeyCache::get_instance()
+{
+  static SymmetricKeyCache cache;
+  return cache;
+}
+
+std::string SymmetricKeyCache::get(
+  const std::string & encrypted_key,
+  const std::function<std::string(const std::string &)> & decrypt_key)
+{
+  // Decrypting under the lock asks for the passphrase of a GPG key only once, also when the
+  // files of a split bag are opened at the same time
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = keys_.find(encrypted_key);
+  if (it == keys_.end()) {
+    it = keys_.emplace(encrypted_key, decrypt_key(encrypted_key)).first;
+  }
+  return it->second;
+}
+
+}  // namespace rosbag2_bag_v2_plugins
@@ -0,0 +1,101 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef ROSBAG2_BAG_V2_PLUGINS__STORAGE__BAG_DECRYPTOR_HPP_
+#define ROSBAG2_BAG_V2_PLUGINS__STORAGE__BAG_DECRYPTOR_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "bag_format.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+// Decryption needs gpgme and OpenSSL and is compiled in with the CMake option
+// ROSBAG2_BAG_V2_PLUGINS_DECRYPTION. Otherwise BagIndex::read does not read encrypted bags, so that
+// they are read through rosbag_storage, and BagDecryptor throws instead of decrypting.
+#ifdef ROSBAG2_BAG_V2_PLUGINS_ENABLE_DECRYPTION
+constexpr bool DECRYPTION_ENABLED = true;
+#else
+constexpr bool DECRYPTION_ENABLED = false;
+#endif
+
+/**
+ * Decrypts bags written with the rosbag/AesCbcEncryptor plugin of the vendored rosbag_storage.
+ * Their chunks and the connection records of their index are encrypted with AES-128 in CBC mode,
+ * each one prefixed with its own initialization vector. The symmetric key is stored in the bag
+ * header, encrypted with the GPG key of a user.
+ */
+class BagDecryptor
+{
+public:
+  /// Value of the "encryptor" field in the bag header of bags this class decrypts
+  static constexpr const char * AES_CBC_ENCRYPTOR = "rosbag/AesCbcEncryptor";
+
+  /**
+   * Decrypts the symmetric key stored in the header of an encrypted bag with GPG, or takes it
+   * from the process-wide SymmetricKeyCache if the bag has been opened before.
+   * \throws std::runtime_error if the bag header has no key or GPG cannot decrypt it
+   */
+  static std::shared_ptr<const BagDecryptor> create(const bag_format::RecordHeader & bag_header);
+
+  /// \throws std::runtime_error if the key is not an AES-128 key
+  explicit BagDecryptor(std::string symmetric_key);
+
+  /**
+   * Decrypts a chunk or a header, given as initialization vector followed by the cipher text.
+   * Uses the AES instructions of the CPU where available and may be called from several threads.
+   * \throws std::runtime_error if the data is corrupt or has not been encrypted with this key
+   */
+  void decrypt(const uint8_t * data, size_t size, std::vector<uint8_t> & decrypted) const;
+
+private:
+  std::string symmetric_key_;
+};
+
+/**
+ * Symmetric keys of encrypted bags by their GPG encrypted form, so that decrypting them, which
+ * may ask the user for a passphrase, happens only once per bag and process. Reopening a bag or
+ * reading it again e.g. for ros2 bag info then reuses the key.
+ */
+class SymmetricKeyCache
+{
+public:
+  /// The cache used by BagDecryptor::create
+  static SymmetricKeyCache & get_instance();
+
+  /**
+   * \param decrypt_key called if the key is not cached yet, at most once at a time
+   * \throws what decrypt_key throws, nothing is cached then
+   */
+  std::string get(
+    const std::string & encrypted_key,
+    const std::function<std::string(const std::string &)> & decrypt_key);
+
+private:
+  std::mutex mutex_;
+  std::map<std::string, std::string> keys_;
+};
+
+}  // namespace rosbag2_bag_v2_plugins
+
+#endif  // ROSBAG2_BAG_V2_PLUGINS__STORAGE__BAG_DECRYPTOR_HPP_
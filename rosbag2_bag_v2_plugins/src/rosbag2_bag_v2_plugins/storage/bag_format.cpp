@@ -0,0 +1,169 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bag_format.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace rosbag2_bag_v2_plugins
+{
+namespace bag_format
+{
+
+RecordHeader::RecordHeader(const uint8_t * data, size_t length)
+: data_(data), length_(length) {}
+
+bool RecordHeader::find_field(
+  const char * name, const uint8_t *& value, size_t & value_length) const
+{
+  auto name_length = strlen(name);
+  size_t position = 0;
+  while (position + 4 <= length_) {
+    auto field_length = read_uint32(data_ + position);
+    position += 4;
+    if (field_length > length_ - position) {
+      return false;
+    }
+    auto field = data_ + position;
+    if (field_length > name_length && field[name_length] == '=' &&
+      memcmp(field, name, name_length) == 0)
+    {
+      value = field + name_length + 1;
+      value_length = field_length - name_length - 1;
+      return true;
+    }
+    position += field_length;
+  }
+  return false;
+}
+
+bool RecordHeader::has_field(const char * name) const
+{
+  const uint8_t * value;
+  size_t value_length;
+  return find_field(name, value, value_length);
+}
+
+namespace
+{
+
+const uint8_t * get_field(
+  const RecordHeader & header, const char * name, size_t expected_length)
+{
+  const uint8_t * value;
+  size_t value_length;
+  if (!header.find_field(name, value, value_length)) {
+    throw std::runtime_error(std::string("Bag record is missing the header field '") + name + "'");
+  }
+  if (value_length != expected_length) {
+    throw std::runtime_error(std::string("Bag record header field '") + name + "' is corrupt");
+  }
+  return value;
+}
+
+}  // namespace
+
+OpCode RecordHeader::get_op() const
+{
+  return static_cast<OpCode>(*get_field(*this, "op", 1));
+}
+
+uint32_t RecordHeader::get_uint32(const char * name) const
+{
+  return read_uint32(get_field(*this, name, 4));
+}
+
+uint64_t RecordHeader::get_uint64(const char * name) const
+{
+  return read_uint64(get_field(*this, name, 8));
+}
+
+uint64_t RecordHeader::get_time(const char * name) const
+{
+  return read_time(get_field(*this, name, 8));
+}
+
+std::string RecordHeader::get_string(const char * name) const
+{
+  const uint8_t * value;
+  size_t value_length;
+  if (!find_field(name, value, value_length)) {
+    throw std::runtime_error(std::string("Bag record is missing the header field '") + name + "'");
+  }
+  return std::string(reinterpret_cast<const char *>(value), value_length);
+}
+
+namespace
+{
+
+uint32_t read_length(std::istream & stream)
+{
+  uint8_t buffer[4];
+  if (!stream.read(reinterpret_cast<char *>(buffer), sizeof(buffer))) {
+    throw std::runtime_error("Unexpected end of bag file");
+  }
+  return read_uint32(buffer);
+}
+
+void read_bytes(std::istream & stream, std::vector<uint8_t> & buffer, uint32_t length)
+{
+  buffer.resize(length);
+  if (length > 0 && !stream.read(reinterpret_cast<char *>(buffer.data()), length)) {
+    throw std::runtime_error("Unexpected end of bag file");
+  }
+}
+
+}  // namespace
+
+uint32_t read_record_header(std::istream & stream, std::vector<uint8_t> & header_buffer)
+{
+  read_bytes(stream, header_buffer, read_length(stream));
+  return read_length(stream);
+}
+
+void read_record(std::istream & stream, Record & record)
+{
+  auto data_length = read_record_header(stream, record.header_buffer);
+  read_bytes(stream, record.data, data_length);
+}
+
+RecordView read_record(const uint8_t * buffer, size_t buffer_size, uint64_t position)
+{
+  // Every length is checked against the remaining size, so that corrupt lengths cannot overflow
+  auto remaining = [buffer_size, &position]() {
+      return position < buffer_size ? buffer_size - static_cast<size_t>(position) : 0;
+    };
+  if (remaining() < 4) {
+    throw std::runtime_error("Unexpected end of bag file");
+  }
+  auto header_length = read_uint32(buffer + position);
+  position += 4;
+  if (remaining() < static_cast<size_t>(header_length) + 4) {
+    throw std::runtime_error("Unexpected end of bag file");
+  }
+  auto header_data = buffer + position;
+  position += header_length;
+  auto data_length = read_uint32(buffer + position);
+  position += 4;
+  if (remaining() < data_length) {
+    throw std::runtime_error("Unexpected end of bag file");
+  }
+  return {RecordHeader(header_data, header_length), buffer + position, data_length};
+}
+
+}  // namespace bag_format
+}  // namespace rosbag2_bag_v2_plugins
@@ -0,0 +1,161 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROSBAG2_BAG_V2_PLUGINS__STORAGE__BAG_FORMAT_HPP_
+#define ROSBAG2_BAG_V2_PLUGINS__STORAGE__BAG_FORMAT_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <string>
+#include <vector>
+
+// Helpers to read records of the ROS 1 bag format 2.0, see https://wiki.ros.org/Bags/Format/2.0
+// Every record consists of a header, i.e. a sequence of length-prefixed "name=value" fields, and
+// of data. All integers are stored in little endian byte order.
+
+namespace rosbag2_bag_v2_plugins
+{
+namespace bag_format
+{
+
+constexpr const char VERSION_LINE[] = "#ROSBAG V2.0\n";
+constexpr size_t VERSION_LINE_LENGTH = sizeof(VERSION_LINE) - 1;
+
+enum class OpCode : uint8_t
+{
+  MESSAGE_DATA = 0x02,
+  BAG_HEADER = 0x03,
+  INDEX_DATA = 0x04,
+  CHUNK = 0x05,
+  CHUNK_INFO = 0x06,
+  CONNECTION = 0x07
+};
+
+inline uint32_t read_uint32(const uint8_t * data)
+{
+  return static_cast<uint32_t>(data[0]) |
+         static_cast<uint32_t>(data[1]) << 8 |
+         static_cast<uint32_t>(data[2]) << 16 |
+         static_cast<uint32_t>(data[3]) << 24;
+}
+
+inline uint64_t read_uint64(const uint8_t * data)
+{
+  return static_cast<uint64_t>(read_uint32(data)) |
+         static_cast<uint64_t>(read_uint32(data + 4)) << 32;
+}
+
+/// Reads a ROS 1 time (seconds and nanoseconds) and returns it in nanoseconds
+inline uint64_t read_time(const uint8_t * data)
+{
+  return static_cast<uint64_t>(read_uint32(data)) * 1000000000ull + read_uint32(data + 4);
+}
+
+/**
+ * Non-owning view of a record header.
+ * Field lookups scan the header, which is cheap as record headers only have a handful of fields.
+ */
+class RecordHeader
+{
+public:
+  RecordHeader(const uint8_t * data, size_t length);
+
+  /// \returns false if the header has no field with the given name
+  bool find_field(const char * name, const uint8_t *& value, size_t & value_length) const;
+
+  bool has_field(const char * name) const;
+
+  /// All getters throw a std::runtime_error if the field is missing or has the wrong size
+  OpCode get_op() const;
+
+  uint32_t get_uint32(const char * name) const;
+
+  uint64_t get_uint64(const char * name) const;
+
+  uint64_t get_time(const char * name) const;
+
+  std::string get_string(const char * name) const;
+
+  /// Calls callback(name, value) for every field, e.g. to read a connection header
+  template<typename Callback>
+  void for_each_field(Callback callback) const
+  {
+    size_t position = 0;
+    while (position + 4 <= length_) {
+      auto field_length = read_uint32(data_ + position);
+      position += 4;
+      if (field_length > length_ - position) {
+        break;
+      }
+      auto field = reinterpret_cast<const char *>(data_ + position);
+      auto separator = static_cast<const char *>(memchr(field, '=', field_length));
+      if (separator) {
+        auto name_length = static_cast<size_t>(separator - field);
+        callback(
+          std::string(field, name_length),
+          std::string(separator + 1, field_length - name_length - 1));
+      }
+      position += field_length;
+    }
+  }
+
+private:
+  const uint8_t * data_;
+  size_t length_;
+};
+
+/// A record read from a file, owning its header and data
+struct Record
+{
+  std::vector<uint8_t> header_buffer;
+  std::vector<uint8_t> data;
+
+  RecordHeader header() const
+  {
+    return RecordHeader(header_buffer.data(), header_buffer.size());
+  }
+};
+
+/**
+ * Reads the record at the current position of the stream.
+ * \throws std::runtime_error if the stream ends before the record is complete
+ */
+void read_record(std::istream & stream, Record & record);
+
+/**
+ * Reads only the header of the record at the current position and returns the length of its data,
+ * the stream is left at the beginning of the data.
+ */
+uint32_t read_record_header(std::istream & stream, std::vector<uint8_t> & header_buffer);
+
+/// A record within a buffer, e.g. a memory mapped bag file, which it points into
+struct RecordView
+{
+  RecordHeader header;
+  const uint8_t * data;
+  uint32_t data_length;
+};
+
+/**
+ * Parses the record at the given position of the buffer without copying it.
+ * \throws std::runtime_error if the buffer ends before the record is complete
+ */
+RecordView read_record(const uint8_t * buffer, size_t buffer_size, uint64_t position);
+
+}  // namespace bag_format
+}  // namespace rosbag2_bag_v2_plugins
+
+#endif  // ROSBAG2_BAG_V2_PLUGINS__STORAGE__BAG_FORMAT_HPP_
@@ -0,0 +1,391 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bag_index.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bag_format.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+namespace
+{
+
+std::string get_encryptor(const bag_format::RecordHeader & bag_header)
+{
+  // Bags written with an encryptor plugin (see the vendored rosbag_storage) name it in the header
+  const uint8_t * value;
+  size_t value_length;
+  if (!bag_header.find_field("encryptor", value, value_length)) {
+    return "";
+  }
+  auto encryptor = std::string(reinterpret_cast<const char *>(value), value_length);
+  return encryptor == "rosbag/NoEncryptor" ? "" : encryptor;
+}
+
+ConnectionRecord read_connection(const bag_format::Record & record, const BagDecryptor * decryptor)
+{
+  if (decryptor) {
+    // Connection records of the index are encrypted as a whole, their header as well as their data
+    bag_format::Record decrypted_record;
+    decryptor->decrypt(
+      record.header_buffer.data(), record.header_buffer.size(), decrypted_record.header_buffer);
+    decryptor->decrypt(record.data.data(), record.data.size(), decrypted_record.data);
+    return read_connection(decrypted_record, nullptr);
+  }
+
+  auto header = record.header();
+  if (header.get_op() != bag_format::OpCode::CONNECTION) {
+    throw std::runtime_error("Expected a connection record in the bag index");
+  }
+
+  ConnectionRecord connection;
+  connection.id = header.get_uint32("conn");
+  connection.topic = header.get_string("topic");
+
+  bag_format::RecordHeader connection_header(record.data.data(), record.data.size());
+  connection_header.for_each_field(
+    [&connection](const std::string & name, const std::string & value) {
+      if (name == "type") {
+        connection.datatype = value;
+      } else if (name == "md5sum") {
+        connection.md5sum = value;
+      } else if (name == "message_definition") {
+        connection.message_definition = value;
+      }
+    });
+  return connection;
+}
+
+ChunkInfoRecord read_chunk_info(const bag_format::RecordView & record)
+{
+  const auto & header = record.header;
+  if (header.get_op() != bag_format::OpCode::CHUNK_INFO) {
+    throw std::runtime_error("Expected a chunk info record in the bag index");
+  }
+
+  ChunkInfoRecord chunk_info;
+  chunk_info.chunk_position = header.get_uint64("chunk_pos");
+  chunk_info.start_time = header.get_time("start_time");
+  chunk_info.end_time = header.get_time("end_time");
+
+  auto count = header.get_uint32("count");
+  if (record.data_length < static_cast<size_t>(count) * 8) {
+    throw std::runtime_error("Chunk info record in the bag index is corrupt");
+  }
+  chunk_info.message_counts.reserve(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    auto entry = record.data + i * 8;
+    chunk_info.message_counts.emplace_back(
+      bag_format::read_uint32(entry), bag_format::read_uint32(entry + 4));
+  }
+  return chunk_info;
+}
+
+/// Reads the chunk info records starting at the current position of the file
+std::vector<ChunkInfoRecord> read_chunk_infos(
+  std::istream & file, uint32_t chunk_count, const std::string & path)
+{
+  // They are the last records of the bag, which makes a single read of the rest of the file
+  // cheaper than reading record by record, e.g. from network storage
+  auto position = file.tellg();
+  file.seekg(0, std::ios::end);
+  auto end = file.tellg();
+  if (position < 0 || end < position) {
+    throw std::runtime_error("Could not read the chunk infos of bag file '" + path + "'");
+  }
+  std::vector<uint8_t> buffer(static_cast<size_t>(end - position));
+  file.seekg(position);
+  if (!file.read(reinterpret_cast<char *>(buffer.data()), buffer.size())) {
+    throw std::runtime_error("Could not read the chunk infos of bag file '" + path + "'");
+  }
+
+  std::vector<ChunkInfoRecord> chunk_infos;
+  chunk_infos.reserve(chunk_count);
+  uint64_t record_position = 0;
+  for (uint32_t i = 0; i < chunk_count; ++i) {
+    auto record = bag_format::read_record(buffer.data(), buffer.size(), record_position);
+    chunk_infos.push_back(read_chunk_info(record));
+    record_position = static_cast<uint64_t>(record.data + record.data_length - buffer.data());
+  }
+  return chunk_infos;
+}
+
+}  // namespace
+
+BagIndex::BagIndex()
+: chunk_infos_loaded_(false) {}
+
+std::shared_ptr<const BagIndex> BagIndex::read(const std::string & path)
+{
+  return read_file(path, false);
+}
+
+std::shared_ptr<const BagIndex> BagIndex::read_deferring_chunk_infos(const std::string & path)
+{
+  return read_file(path, true);
+}
+
+std::shared_ptr<const BagIndex> BagIndex::read_file(
+  const std::string & path, bool defer_chunk_infos)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("Could not open bag file '" + path + "'");
+  }
+
+  char version_line[bag_format::VERSION_LINE_LENGTH];
+  if (!file.read(version_line, sizeof(version_line)) ||
+    memcmp(version_line, bag_format::VERSION_LINE, sizeof(version_line)) != 0)
+  {
+    return nullptr;
+  }
+
+  bag_format::Record record;
+  bag_format::read_record(file, record);
+  auto bag_header = record.header();
+  if (bag_header.get_op() != bag_format::OpCode::BAG_HEADER) {
+    throw std::runtime_error("Bag file '" + path + "' does not start with a bag header");
+  }
+  auto index_position = bag_header.get_uint64("index_pos");
+  auto connection_count = bag_header.get_uint32("conn_count");
+  auto chunk_count = bag_header.get_uint32("chunk_count");
+  if (index_position == 0) {
+    return nullptr;
+  }
+  std::shared_ptr<const BagDecryptor> decryptor;
+  auto encryptor = get_encryptor(bag_header);
+  if (encryptor == BagDecryptor::AES_CBC_ENCRYPTOR && DECRYPTION_ENABLED) {
+    decryptor = BagDecryptor::create(bag_header);
+  } else if (!encryptor.empty()) {
+    return nullptr;
+  }
+
+  std::shared_ptr<BagIndex> index(new BagIndex());
+  index->file_paths_ = {path};
+  index->connection_id_offsets_ = {0};
+  index->decryptors_ = {decryptor};
+
+  file.seekg(static_cast<std::streamoff>(index_position));
+  index->connections_.reserve(connection_count);
+  for (uint32_t i = 0; i < connection_count; ++i) {
+    bag_format::read_record(file, record);
+    index->connections_.push_back(read_connection(record, decryptor.get()));
+    index->connection_positions_[index->connections_.back().id] = i;
+  }
+
+  if (!defer_chunk_infos) {
+    index->set_chunk_infos(read_chunk_infos(file, chunk_count, path));
+    return index;
+  }
+  auto chunk_infos_position = file.tellg();
+  index->chunk_info_loader_ = [path, chunk_infos_position, chunk_count]() {
+      std::ifstream file(path, std::ios::binary);
+      if (!file) {
+        throw std::runtime_error("Could not open bag file '" + path + "'");
+      }
+      file.seekg(chunk_infos_position);
+      return read_chunk_infos(file, chunk_count, path);
+    };
+  return index;
+}
+
+std::shared_ptr<const BagIndex> BagIndex::create(
+  const std::string & path,
+  std::vector<ConnectionRecord> connections,
+  std::vector<ChunkInfoRecord> chunk_infos)
+{
+  std::shared_ptr<BagIndex> index(new BagIndex());
+  index->file_paths_ = {path};
+  index->connection_id_offsets_ = {0};
+  index->decryptors_ = {nullptr};
+  index->connections_ = std::move(connections);
+  for (size_t i = 0; i < index->connections_.size(); ++i) {
+    index->connection_positions_[index->connections_[i].id] = i;
+  }
+  index->set_chunk_infos(std::move(chunk_infos));
+  return index;
+}
+
+std::shared_ptr<const BagIndex> BagIndex::merge(
+  const std::vector<std::shared_ptr<const BagIndex>> & indexes)
+{
+  if (indexes.empty()) {
+    throw std::runtime_error("Cannot merge an empty list of bag indexes");
+  }
+
+  std::shared_ptr<BagIndex> merged_index(new BagIndex());
+  uint32_t connection_id_offset = 0;
+  bool chunk_infos_loaded = true;
+  for (const auto & index : indexes) {
+    if (index->get_file_count() != 1) {
+      throw std::runtime_error("Only indexes of single bag files can be merged");
+    }
+    merged_index->file_paths_.push_back(index->get_path());
+    merged_index->connection_id_offsets_.push_back(connection_id_offset);
+    merged_index->decryptors_.push_back(index->decryptors_.front());
+
+    uint32_t next_connection_id_offset = connection_id_offset;
+    for (auto connection : index->connections_) {
+      connection.id += connection_id_offset;
+      next_connection_id_offset = std::max(next_connection_id_offset, connection.id + 1);
+      merged_index->connection_positions_[connection.id] = merged_index->connections_.size();
+      merged_index->connections_.push_back(std::move(connection));
+    }
+    chunk_infos_loaded = chunk_infos_loaded && index->are_chunk_infos_loaded();
+    connection_id_offset = next_connection_id_offset;
+  }
+
+  auto connection_id_offsets = merged_index->connection_id_offsets_;
+  auto merge_chunk_infos = [indexes, connection_id_offsets]() {
+      std::vector<ChunkInfoRecord> merged_chunk_infos;
+      for (size_t file_index = 0; file_index < indexes.size(); ++file_index) {
+        for (auto chunk_info : indexes[file_index]->get_chunk_infos()) {
+          for (auto & message_count : chunk_info.message_counts) {
+            message_count.first += connection_id_offsets[file_index];
+          }
+          chunk_info.file_index = static_cast<uint32_t>(file_index);
+          merged_chunk_infos.push_back(std::move(chunk_info));
+        }
+      }
+      return merged_chunk_infos;
+    };
+  if (chunk_infos_loaded) {
+    merged_index->set_chunk_infos(merge_chunk_infos());
+  } else {
+    merged_index->chunk_info_loader_ = merge_chunk_infos;
+  }
+  return merged_index;
+}
+
+const std::string & BagIndex::get_path() const
+{
+  return file_paths_.front();
+}
+
+size_t BagIndex::get_file_count() const
+{
+  return file_paths_.size();
+}
+
+const std::string & BagIndex::get_file_path(size_t file_index) const
+{
+  return file_paths_.at(file_index);
+}
+
+uint32_t BagIndex::get_connection_id_offset(size_t file_index) const
+{
+  return connection_id_offsets_.at(file_index);
+}
+
+const BagDecryptor * BagIndex::get_decryptor(size_t file_index) const
+{
+  return decryptors_.at(file_index).get();
+}
+
+bool BagIndex::is_encrypted() const
+{
+  for (const auto & decryptor : decryptors_) {
+    if (decryptor) {
+      return true;
+    }
+  }
+  return false;
+}
+
+const std::vector<ConnectionRecord> & BagIndex::get_connections() const
+{
+  return connections_;
+}
+
+const ConnectionRecord * BagIndex::get_connection(uint32_t id) const
+{
+  auto it = connection_positions_.find(id);
+  return it == connection_positions_.end() ? nullptr : &connections_[it->second];
+}
+
+const std::vector<ChunkInfoRecord> & BagIndex::get_chunk_infos() const
+{
+  load_chunk_infos();
+  return chunk_infos_;
+}
+
+bool BagIndex::are_chunk_infos_loaded() const
+{
+  return chunk_infos_loaded_.load(std::memory_order_acquire);
+}
+
+const std::vector<size_t> & BagIndex::get_chunks_by_start_time() const
+{
+  load_chunk_infos();
+  return chunks_by_start_time_;
+}
+
+size_t BagIndex::find_first_chunk_ending_at_or_after(uint64_t time) const
+{
+  load_chunk_infos();
+  auto position = std::lower_bound(latest_end_times_.begin(), latest_end_times_.end(), time);
+  return static_cast<size_t>(position - latest_end_times_.begin());
+}
+
+void BagIndex::load_chunk_infos() const
+{
+  if (are_chunk_infos_loaded()) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(chunk_info_mutex_);
+  // Another thread may have read them while this one waited
+  if (!chunk_infos_loaded_.load(std::memory_order_relaxed)) {
+    set_chunk_infos(chunk_info_loader_());
+    chunk_info_loader_ = nullptr;
+  }
+}
+
+void BagIndex::set_chunk_infos(std::vector<ChunkInfoRecord> chunk_infos) const
+{
+  chunk_infos_ = std::move(chunk_infos);
+
+  chunks_by_start_time_.resize(chunk_infos_.size());
+  for (size_t i = 0; i < chunk_infos_.size(); ++i) {
+    chunks_by_start_time_[i] = i;
+  }
+  std::stable_sort(
+    chunks_by_start_time_.begin(), chunks_by_start_time_.end(),
+    [this](size_t lhs, size_t rhs) {
+      return chunk_infos_[lhs].start_time < chunk_infos_[rhs].start_time;
+    });
+
+  // Chunks may overlap in time, so a chunk starting early may still end after later ones
+  latest_end_times_.clear();
+  latest_end_times_.reserve(chunk_infos_.size());
+  uint64_t latest_end_time = 0;
+  for (auto chunk_index : chunks_by_start_time_) {
+    latest_end_time = std::max(latest_end_time, chunk_infos_[chunk_index].end_time);
+    latest_end_times_.push_back(latest_end_time);
+  }
+  chunk_infos_loaded_.store(true, std::memory_order_release);
+}
+
+}  // namespace rosbag2_bag_v2_plugins
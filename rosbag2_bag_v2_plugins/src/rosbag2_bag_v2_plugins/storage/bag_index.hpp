@@ -0,0 +1,168 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROSBAG2_BAG_V2_PLUGINS__STORAGE__BAG_INDEX_HPP_
+#define ROSBAG2_BAG_V2_PLUGINS__STORAGE__BAG_INDEX_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "bag_decryptor.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+struct ConnectionRecord
+{
+  uint32_t id;
+  std::string topic;
+  std::string datatype;
+  std::string md5sum;
+  std::string message_definition;
+};
+
+struct ChunkInfoRecord
+{
+  /// Position of the chunk record in the bag file
+  uint64_t chunk_position;
+  /// Time stamps in nanoseconds of the earliest and latest message in the chunk
+  uint64_t start_time;
+  uint64_t end_time;
+  /// Number of messages in the chunk per connection id
+  std::vector<std::pair<uint32_t, uint32_t>> message_counts;
+  /// The bag file the chunk lies in, see BagIndex::get_file_path
+  uint32_t file_index = 0;
+};
+
+/**
+ * The connections and chunk infos of a ROS 1 bag as stored in the index section at the end of
+ * the file. Reading it does not touch the chunks themselves.
+ *
+ * The chunk infos may be read when they are first used instead, which is safe from any thread.
+ */
+class BagIndex
+{
+public:
+  /**
+   * Reads the bag header and the index section of a bag file.
+   * Bags encrypted by the rosbag/AesCbcEncryptor are decrypted, see BagDecryptor.
+   * \returns nullptr if the bag cannot be read by the plugin itself, because it uses an older
+   * format version, another encryptor or has not been indexed, or because it is encrypted and
+   * decryption is not compiled in, see DECRYPTION_ENABLED. Use rosbag::Bag for these.
+   * \throws std::runtime_error if the file cannot be read or is corrupt, or if it is encrypted and
+   * its key cannot be decrypted
+   */
+  static std::shared_ptr<const BagIndex> read(const std::string & path);
+
+  /**
+   * Like read, but only the bag header and the connections are read. The chunk infos are read on
+   * first use, in one go as their records follow the connections at the end of the file.
+   */
+  static std::shared_ptr<const BagIndex> read_deferring_chunk_infos(const std::string & path);
+
+  /// Creates an index from records that have been read before, e.g. from an index cache
+  static std::shared_ptr<const BagIndex> create(
+    const std::string & path,
+    std::vector<ConnectionRecord> connections,
+    std::vector<ChunkInfoRecord> chunk_infos);
+
+  /**
+   * Merges the indexes of the files of a split bag, given in the order they were split in.
+   * Connection ids are made unique by shifting the ids of each file above the ones of the files
+   * before it, see get_connection_id_offset. Deferred chunk infos are merged on first use.
+   * \throws std::runtime_error if there are no indexes or one is a merged one itself
+   */
+  static std::shared_ptr<const BagIndex> merge(
+    const std::vector<std::shared_ptr<const BagIndex>> & indexes);
+
+  /// Path of the bag file, the first file for split bags
+  const std::string & get_path() const;
+
+  /// Number of bag files, more than one for split bags
+  size_t get_file_count() const;
+
+  const std::string & get_file_path(size_t file_index) const;
+
+  /// Added to the connection ids stored in the file to get the ids used by the index
+  uint32_t get_connection_id_offset(size_t file_index) const;
+
+  /// \returns nullptr if the file is not encrypted
+  const BagDecryptor * get_decryptor(size_t file_index) const;
+
+  /// Whether any of the bag files is encrypted
+  bool is_encrypted() const;
+
+  const std::vector<ConnectionRecord> & get_connections() const;
+
+  /// \returns nullptr if there is no connection with this id
+  const ConnectionRecord * get_connection(uint32_t id) const;
+
+  /**
+   * Chunk infos in the order of the chunks in the file, file after file for split bags.
+   * Reads them if they have been deferred.
+   * \throws std::runtime_error if deferred chunk infos cannot be read
+   */
+  const std::vector<ChunkInfoRecord> & get_chunk_infos() const;
+
+  /// Whether the chunk infos have been read, false until first use if they have been deferred
+  bool are_chunk_infos_loaded() const;
+
+  /**
+   * Indices into the chunk infos sorted by start time, chunks starting at the same time in file
+   * order. Sorted once when the index is created, so that seeking need not sort again.
+   */
+  const std::vector<size_t> & get_chunks_by_start_time() const;
+
+  /**
+   * Binary search for the position in get_chunks_by_start_time of the first chunk which ends at
+   * or after the time stamp (ns). None of the chunks before it has messages from then on.
+   * \returns the number of chunks if all of them end earlier
+   */
+  size_t find_first_chunk_ending_at_or_after(uint64_t time) const;
+
+private:
+  BagIndex();
+
+  static std::shared_ptr<const BagIndex> read_file(
+    const std::string & path, bool defer_chunk_infos);
+
+  void set_chunk_infos(std::vector<ChunkInfoRecord> chunk_infos) const;
+  void load_chunk_infos() const;
+
+  std::vector<std::string> file_paths_;
+  std::vector<uint32_t> connection_id_offsets_;
+  std::vector<std::shared_ptr<const BagDecryptor>> decryptors_;
+  std::vector<ConnectionRecord> connections_;
+  std::unordered_map<uint32_t, size_t> connection_positions_;
+  // The chunk infos and their order are set once, either on creation or when first used
+  mutable std::vector<ChunkInfoRecord> chunk_infos_;
+  mutable std::vector<size_t> chunks_by_start_time_;
+  /// Latest end time of the chunks up to each position in chunks_by_start_time_, never decreasing
+  mutable std::vector<uint64_t> latest_end_times_;
+  /// Reads deferred chunk infos, released once they are read
+  mutable std::function<std::vector<ChunkInfoRecord>()> chunk_info_loader_;
+  mutable std::mutex chunk_info_mutex_;
+  mutable std::atomic<bool> chunk_infos_loaded_;
+};
+
+}  // namespace rosbag2_bag_v2_plugins
+
+#endif  // ROSBAG2_BAG_V2_PLUGINS__STORAGE__BAG_INDEX_HPP_
@@ -0,0 +1,412 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bag_index_cache.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifdef _WIN32
+#include <io.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "rcpputils/filesystem_helper.hpp"
+
+#include "bag_format.hpp"
+#include "../logging.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+namespace
+{
+
+constexpr const char CACHE_MAGIC[] = "ROSBAG2_BAG_V2_INDEX";
+constexpr size_t CACHE_MAGIC_LENGTH = sizeof(CACHE_MAGIC) - 1;
+// Increase whenever the layout below changes, older caches are then rebuilt
+constexpr uint32_t CACHE_VERSION = 2;
+constexpr const char CACHE_FILE_EXTENSION[] = ".rosbag2_v2_index";
+
+// All integers are little endian like in the bag itself:
+//   magic, version, bag path, bag size, bag modification time,
+//   connection count, connections (id, topic, datatype, md5sum, message definition),
+//   chunk count, chunk infos (position, start time, end time, count, (connection id, count)...)
+class CacheWriter
+{
+public:
+  explicit CacheWriter(std::ostream & stream)
+  : stream_(stream) {}
+
+  void write_uint32(uint32_t value)
+  {
+    uint8_t bytes[4];
+    for (size_t i = 0; i < sizeof(bytes); ++i) {
+      bytes[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+    stream_.write(reinterpret_cast<const char *>(bytes), sizeof(bytes));
+  }
+
+  void write_uint64(uint64_t value)
+  {
+    write_uint32(static_cast<uint32_t>(value));
+    write_uint32(static_cast<uint32_t>(value >> 32));
+  }
+
+  void write_string(const std::string & value)
+  {
+    write_uint32(static_cast<uint32_t>(value.size()));
+    stream_.write(value.data(), static_cast<std::streamsize>(value.size()));
+  }
+
+private:
+  std::ostream & stream_;
+};
+
+// Reads from the cache in memory, throwing on reads past its end
+class CacheReader
+{
+public:
+  CacheReader(const uint8_t * data, size_t size)
+  : position_(data), end_(data + size) {}
+
+  const uint8_t * read_bytes(size_t length)
+  {
+    if (static_cast<size_t>(end_ - position_) < length) {
+      throw std::runtime_error("Index cache is truncated");
+    }
+    auto bytes = position_;
+    position_ += length;
+    return bytes;
+  }
+
+  uint32_t read_uint32()
+  {
+    return bag_format::read_uint32(read_bytes(4));
+  }
+
+  uint64_t read_uint64()
+  {
+    return bag_format::read_uint64(read_bytes(8));
+  }
+
+  std::string read_string()
+  {
+    auto length = read_uint32();
+    return std::string(reinterpret_cast<const char *>(read_bytes(length)), length);
+  }
+
+  size_t remaining() const
+  {
+    return static_cast<size_t>(end_ - position_);
+  }
+
+private:
+  const uint8_t * position_;
+  const uint8_t * end_;
+};
+
+std::shared_ptr<const BagIndex> parse_bag_index_cache(
+  CacheReader & reader, const std::string & bag_path, const BagFileStamp & stamp)
+{
+  if (memcmp(reader.read_bytes(CACHE_MAGIC_LENGTH), CACHE_MAGIC, CACHE_MAGIC_LENGTH) != 0 ||
+    reader.read_uint32() != CACHE_VERSION ||
+    reader.read_string() != stamp.path ||
+    reader.read_uint64() != stamp.size ||
+    static_cast<int64_t>(reader.read_uint64()) != stamp.modification_time)
+  {
+    return nullptr;
+  }
+
+  // Counts are checked against the remaining size so that a corrupt cache cannot cause huge
+  // allocations
+  auto connection_count = reader.read_uint32();
+  if (connection_count > reader.remaining()) {
+    return nullptr;
+  }
+  std::vector<ConnectionRecord> connections(connection_count);
+  for (auto & connection : connections) {
+    connection.id = reader.read_uint32();
+    connection.topic = reader.read_string();
+    connection.datatype = reader.read_string();
+    connection.md5sum = reader.read_string();
+    connection.message_definition = reader.read_string();
+  }
+
+  auto chunk_count = reader.read_uint32();
+  if (chunk_count > reader.remaining()) {
+    return nullptr;
+  }
+  std::vector<ChunkInfoRecord> chunk_infos(chunk_count);
+  for (auto & chunk_info : chunk_infos) {
+    chunk_info.chunk_position = reader.read_uint64();
+    chunk_info.start_time = reader.read_uint64();
+    chunk_info.end_time = reader.read_uint64();
+    auto count = reader.read_uint32();
+    if (count > reader.remaining() / 8) {
+      return nullptr;
+    }
+    chunk_info.message_counts.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+      auto connection_id = reader.read_uint32();
+      chunk_info.message_counts.emplace_back(connection_id, reader.read_uint32());
+    }
+  }
+
+  if (reader.remaining() != 0) {
+    return nullptr;
+  }
+  return BagIndex::create(bag_path, std::move(connections), std::move(chunk_infos));
+}
+
+// Creates a new file next to the cache, so concurrent writers never share a temporary file
+bool create_temporary_file(const std::string & cache_path, std::string & temporary_path)
+{
+#ifdef _WIN32
+  std::random_device random;
+  for (int attempt = 0; attempt < 16; ++attempt) {
+    std::ostringstream name;
+    name << cache_path << '.' << _getpid() << '.' << std::hex << random() << ".tmp";
+    int file = -1;
+    if (_sopen_s(
+        &file, name.str().c_str(), _O_CREAT | _O_EXCL | _O_WRONLY | _O_BINARY, _SH_DENYNO,
+        _S_IREAD | _S_IWRITE) == 0)
+    {
+      _close(file);
+      temporary_path = name.str();
+      return true;
+    }
+    if (errno != EEXIST) {
+      return false;
+    }
+  }
+  return false;
+#else
+  std::vector<char> name(cache_path.begin(), cache_path.end());
+  const char suffix[] = ".XXXXXX";
+  name.insert(name.end(), suffix, suffix + sizeof(suffix));
+  auto file = mkstemp(name.data());
+  if (file < 0) {
+    return false;
+  }
+  // mkstemp only lets the owner read the file, other users may share the cache
+  fchmod(file, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  close(file);
+  temporary_path = name.data();
+  return true;
+#endif
+}
+
+void write_bag_index_cache_file(
+  const BagIndex & index, const BagFileStamp & stamp, const std::string & cache_path)
+{
+  // Writing to a temporary file first means concurrent readers never see a partial cache
+  std::string temporary_path;
+  if (!create_temporary_file(cache_path, temporary_path)) {
+    ROSBAG2_BAG_V2_PLUGINS_LOG_DEBUG_STREAM(
+      "Could not create a temporary file for index cache '" << cache_path << "'.");
+    return;
+  }
+  {
+    std::ofstream cache(temporary_path, std::ios::binary | std::ios::trunc);
+    if (!cache) {
+      ROSBAG2_BAG_V2_PLUGINS_LOG_DEBUG_STREAM(
+        "Could not open index cache '" << temporary_path << "'.");
+      std::remove(temporary_path.c_str());
+      return;
+    }
+    write_bag_index_cache(index, stamp, cache);
+    cache.close();
+    if (!cache) {
+      ROSBAG2_BAG_V2_PLUGINS_LOG_DEBUG_STREAM(
+        "Could not write index cache '" << temporary_path << "'.");
+      std::remove(temporary_path.c_str());
+      return;
+    }
+  }
+
+  if (std::rename(temporary_path.c_str(), cache_path.c_str()) != 0) {
+    // Renaming does not replace existing files everywhere
+    std::remove(cache_path.c_str());
+    if (std::rename(temporary_path.c_str(), cache_path.c_str()) != 0) {
+      ROSBAG2_BAG_V2_PLUGINS_LOG_DEBUG_STREAM(
+        "Could not replace index cache '" << cache_path << "'.");
+      std::remove(temporary_path.c_str());
+    }
+  }
+}
+
+bool get_absolute_path(const std::string & path, std::string & absolute_path)
+{
+#ifdef _WIN32
+  auto resolved_path = _fullpath(nullptr, path.c_str(), 0);
+#else
+  auto resolved_path = realpath(path.c_str(), nullptr);
+#endif
+  if (!resolved_path) {
+    return false;
+  }
+  absolute_path = resolved_path;
+  free(resolved_path);
+  return true;
+}
+
+// 64 bit FNV-1a, which unlike std::hash gives the same cache file names in every build
+uint64_t hash_path(const std::string & path)
+{
+  uint64_t hash = 14695981039346656037ull;
+  for (auto character : path) {
+    hash ^= static_cast<uint8_t>(character);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+}  // namespace
+
+bool get_bag_file_stamp(const std::string & path, BagFileStamp & stamp)
+{
+#ifdef _WIN32
+  struct _stat64 status;
+  if (_stat64(path.c_str(), &status) != 0) {
+    return false;
+  }
+  auto modification_time = static_cast<int64_t>(status.st_mtime) * 1000000000;
+#else
+  struct stat status;
+  if (stat(path.c_str(), &status) != 0) {
+    return false;
+  }
+#ifdef __APPLE__
+  const auto & modification_timespec = status.st_mtimespec;
+#else
+  const auto & modification_timespec = status.st_mtim;
+#endif
+  auto modification_time = static_cast<int64_t>(modification_timespec.tv_sec) * 1000000000 +
+    static_cast<int64_t>(modification_timespec.tv_nsec);
+#endif
+  if (!get_absolute_path(path, stamp.path)) {
+    return false;
+  }
+  stamp.size = static_cast<uint64_t>(status.st_size);
+  stamp.modification_time = modification_time;
+  return true;
+}
+
+std::string get_bag_index_cache_path(
+  const BagFileStamp & stamp, const std::string & cache_directory)
+{
+  if (cache_directory.empty()) {
+    return stamp.path + CACHE_FILE_EXTENSION;
+  }
+  std::ostringstream cache_file_name;
+  cache_file_name << rcpputils::fs::path(stamp.path).filename().string() << '.' <<
+    std::hex << std::setw(16) << std::setfill('0') << hash_path(stamp.path) <<
+    CACHE_FILE_EXTENSION;
+  return (rcpputils::fs::path(cache_directory) / cache_file_name.str()).string();
+}
+
+void write_bag_index_cache(
+  const BagIndex & index, const BagFileStamp & stamp, std::ostream & cache)
+{
+  CacheWriter writer(cache);
+  cache.write(CACHE_MAGIC, CACHE_MAGIC_LENGTH);
+  writer.write_uint32(CACHE_VERSION);
+  writer.write_string(stamp.path);
+  writer.write_uint64(stamp.size);
+  writer.write_uint64(static_cast<uint64_t>(stamp.modification_time));
+
+  const auto & connections = index.get_connections();
+  writer.write_uint32(static_cast<uint32_t>(connections.size()));
+  for (const auto & connection : connections) {
+    writer.write_uint32(connection.id);
+    writer.write_string(connection.topic);
+    writer.write_string(connection.datatype);
+    writer.write_string(connection.md5sum);
+    writer.write_string(connection.message_definition);
+  }
+
+  const auto & chunk_infos = index.get_chunk_infos();
+  writer.write_uint32(static_cast<uint32_t>(chunk_infos.size()));
+  for (const auto & chunk_info : chunk_infos) {
+    writer.write_uint64(chunk_info.chunk_position);
+    writer.write_uint64(chunk_info.start_time);
+    writer.write_uint64(chunk_info.end_time);
+    writer.write_uint32(static_cast<uint32_t>(chunk_info.message_counts.size()));
+    for (const auto & message_count : chunk_info.message_counts) {
+      writer.write_uint32(message_count.first);
+      writer.write_uint32(message_count.second);
+    }
+  }
+}
+
+std::shared_ptr<const BagIndex> read_bag_index_cache(
+  std::istream & cache, const std::string & bag_path, const BagFileStamp & stamp)
+{
+  // Caches are small compared to the bag, reading them in one go avoids many small stream reads
+  std::vector<char> data{std::istreambuf_iterator<char>(cache), std::istreambuf_iterator<char>()};
+  CacheReader reader(reinterpret_cast<const uint8_t *>(data.data()), data.size());
+  try {
+    return parse_bag_index_cache(reader, bag_path, stamp);
+  } catch (const std::runtime_error &) {
+    return nullptr;
+  }
+}
+
+std::shared_ptr<const BagIndex> read_bag_index_using_cache(
+  const std::string & bag_path, const std::string & cache_directory)
+{
+  BagFileStamp stamp;
+  if (!get_bag_file_stamp(bag_path, stamp)) {
+    return BagIndex::read(bag_path);
+  }
+
+  auto cache_path = get_bag_index_cache_path(stamp, cache_directory);
+  std::ifstream cache(cache_path, std::ios::binary);
+  if (cache) {
+    auto index = read_bag_index_cache(cache, bag_path, stamp);
+    if (index) {
+      return index;
+    }
+    ROSBAG2_BAG_V2_PLUGINS_LOG_DEBUG_STREAM(
+      "Index cache '" << cache_path << "' is outdated and will be rebuilt.");
+  }
+  cache.close();
+
+  auto index = BagIndex::read(bag_path);
+  // The cache would hold the decrypted connections of encrypted bags in plain text
+  if (index && !index->is_encrypted()) {
+    write_bag_index_cache_file(*index, stamp, cache_path);
+  }
+  return index;
+}
+
+}  // namespace rosbag2_bag_v2_plugins
@@ -0,0 +1,69 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROSBAG2_BAG_V2_PLUGINS__STORAGE__BAG_INDEX_CACHE_HPP_
+#define ROSBAG2_BAG_V2_PLUGINS__STORAGE__BAG_INDEX_CACHE_HPP_
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+
+#include "bag_index.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+/// Identifies the bag file and the version of it an index cache was written for
+struct BagFileStamp
+{
+  /// Absolute path of the bag
+  std::string path;
+  uint64_t size;
+  /// Modification time in nanoseconds, so that bags rewritten within a second differ as well
+  int64_t modification_time;
+};
+
+/// \returns false if the file does not exist or cannot be accessed
+bool get_bag_file_stamp(const std::string & path, BagFileStamp & stamp);
+
+/**
+ * Path of the index cache of a bag. It lies next to the bag, unless a cache directory is given,
+ * in which case it is named after the bag file and a hash of its absolute path, as bags of
+ * different directories often share their file names, e.g. run_0.bag.
+ */
+std::string get_bag_index_cache_path(
+  const BagFileStamp & stamp, const std::string & cache_directory);
+
+void write_bag_index_cache(
+  const BagIndex & index, const BagFileStamp & stamp, std::ostream & cache);
+
+/**
+ * Reads an index cache written by write_bag_index_cache.
+ * \returns nullptr if the cache is corrupt or was written for a different version of the bag
+ */
+std::shared_ptr<const BagIndex> read_bag_index_cache(
+  std::istream & cache, const std::string & bag_path, const BagFileStamp & stamp);
+
+/**
+ * Same as BagIndex::read, but reuses the index cache of the bag if it is up to date.
+ * Otherwise the index is read from the bag and the cache is rewritten. Failing to write the cache,
+ * e.g. because the bag lies in a read-only directory, is not an error.
+ */
+std::shared_ptr<const BagIndex> read_bag_index_using_cache(
+  const std::string & bag_path, const std::string & cache_directory);
+
+}  // namespace rosbag2_bag_v2_plugins
+
+#endif  // ROSBAG2_BAG_V2_PLUGINS__STORAGE__BAG_INDEX_CACHE_HPP_
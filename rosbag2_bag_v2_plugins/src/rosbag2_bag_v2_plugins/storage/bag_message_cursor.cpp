@@ -0,0 +1,184 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "bag_message_cursor.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace rosbag2_bag_v2_plugins
+{
+
+BagMessageCursor::BagMessageCursor(
+  std::shared_ptr<const BagIndex> bag_index,
+  std::unordered_set<uint32_t> connection_ids,
+  uint64_t start_time,
+  size_t read_ahead,
+  size_t prefetch_threads,
+  bool memory_mapped,
+  std::shared_ptr<ChunkStatistics> statistics,
+  std::shared_ptr<ChunkCache> chunk_cache,
+  size_t prefetch_max_bytes)
+: bag_index_(std::move(bag_index)),
+  connection_ids_(std::move(connection_ids)),
+  start_time_(start_time),
+  statistics_(std::move(statistics)),
+  chunk_cache_(std::move(chunk_cache)),
+  files_(bag_index_, memory_mapped, statistics_.get()),
+  next_chunk_to_read_(0)
+{
+  // Chunks before the first one ending at the start time are skipped without looking at them
+  const auto & chunk_infos = bag_index_->get_chunk_infos();
+  const auto & chunks_by_start_time = bag_index_->get_chunks_by_start_time();
+  for (auto position = bag_index_->find_first_chunk_ending_at_or_after(start_time_);
+    position < chunks_by_start_time.size(); ++position)
+  {
+    const auto & chunk_info = chunk_infos[chunks_by_start_time[position]];
+    const auto & message_counts = chunk_info.message_counts;
+    auto has_selected_messages = std::any_of(
+      message_counts.begin(), message_counts.end(),
+      [this](const std::pair<uint32_t, uint32_t> & message_count) {
+        return message_count.second > 0 && connection_ids_.count(message_count.first) > 0;
+      });
+    if (has_selected_messages && chunk_info.end_time >= start_time_) {
+      chunks_to_read_.push_back(chunks_by_start_time[position]);
+    }
+  }
+
+  if (read_ahead > 0 && !chunks_to_read_.empty()) {
+    // The merge below reads the chunks strictly in this order, so they can be prefetched
+    prefetcher_ = std::make_unique<ChunkPrefetcher>(
+      bag_index_, chunks_to_read_, connection_ids_, read_ahead, prefetch_threads, memory_mapped,
+      statistics_.get(), chunk_cache_.get(), prefetch_max_bytes);
+  }
+}
+
+bool BagMessageCursor::has_next()
+{
+  read_chunks_up_to_next_message();
+  drop_skipped_messages();
+  return !chunk_cursors_.empty();
+}
+
+BagMessage BagMessageCursor::next()
+{
+  read_chunks_up_to_next_message();
+  drop_skipped_messages();
+  if (chunk_cursors_.empty()) {
+    throw std::runtime_error("No more messages to read");
+  }
+  return pop_next_message();
+}
+
+void BagMessageCursor::skip_messages_at_start_time(
+  std::unordered_map<uint32_t, size_t> message_counts)
+{
+  skipped_message_counts_ = std::move(message_counts);
+}
+
+void BagMessageCursor::drop_skipped_messages()
+{
+  while (!skipped_message_counts_.empty()) {
+    if (chunk_cursors_.empty() || chunk_cursors_.front().next_time() != start_time_) {
+      // All messages at the start time were read
+      skipped_message_counts_.clear();
+      return;
+    }
+    const auto & chunk_cursor = chunk_cursors_.front();
+    const auto & message = chunk_cursor.chunk->get_messages()[chunk_cursor.next_message];
+    auto skipped_message_count = skipped_message_counts_.find(message.connection_id);
+    if (skipped_message_count == skipped_message_counts_.end()) {
+      return;
+    }
+    if (--skipped_message_count->second == 0) {
+      skipped_message_counts_.erase(skipped_message_count);
+    }
+    pop_next_message();
+    read_chunks_up_to_next_message();
+  }
+}
+
+BagMessage BagMessageCursor::pop_next_message()
+{
+  std::pop_heap(chunk_cursors_.begin(), chunk_cursors_.end(), &BagMessageCursor::is_later);
+  auto & chunk_cursor = chunk_cursors_.back();
+  BagMessage bag_message{
+    chunk_cursor.chunk, &chunk_cursor.chunk->get_messages()[chunk_cursor.next_message]};
+
+  ++chunk_cursor.next_message;
+  if (chunk_cursor.next_message < chunk_cursor.chunk->get_messages().size()) {
+    std::push_heap(chunk_cursors_.begin(), chunk_cursors_.end(), &BagMessageCursor::is_later);
+  } else {
+    chunk_cursors_.pop_back();
+  }
+  return bag_message;
+}
+
+bool BagMessageCursor::is_later(const ChunkCursor & lhs, const ChunkCursor & rhs)
+{
+  auto lhs_time = lhs.next_time();
+  auto rhs_time = rhs.next_time();
+  return lhs_time > rhs_time ||
+         (lhs_time == rhs_time && lhs.sequence_number > rhs.sequence_number);
+}
+
+void BagMessageCursor::read_chunks_up_to_next_message()
+{
+  // A chunk which starts after the earliest pending message cannot contain an earlier message
+  const auto & chunk_infos = bag_index_->get_chunk_infos();
+  while (next_chunk_to_read_ < chunks_to_read_.size()) {
+    const auto & chunk_info = chunk_infos[chunks_to_read_[next_chunk_to_read_]];
+    if (!chunk_cursors_.empty() && chunk_info.start_time > chunk_cursors_.front().next_time()) {
+      break;
+    }
+
+    auto chunk = read_next_chunk();
+    const auto & messages = chunk->get_messages();
+    auto first_message = std::lower_bound(
+      messages.begin(), messages.end(), start_time_,
+      [](const ChunkMessage & message, uint64_t time) {
+        return message.time < time;
+      });
+    if (first_message != messages.end()) {
+      auto next_message = static_cast<size_t>(first_message - messages.begin());
+      chunk_cursors_.push_back({std::move(chunk), next_message, next_chunk_to_read_});
+      std::push_heap(chunk_cursors_.begin(), chunk_cursors_.end(), &BagMessageCursor::is_later);
+    }
+    ++next_chunk_to_read_;
+  }
+}
+
+std::shared_ptr<const Chunk> BagMessageCursor::read_next_chunk()
+{
+  StatisticsTimer timer;
+  std::shared_ptr<const Chunk> chunk;
+  if (prefetcher_) {
+    chunk = prefetcher_->next();
+  } else {
+    chunk = read_cached_chunk(
+      files_, *bag_index_, chunks_to_read_[next_chunk_to_read_], connection_ids_,
+      chunk_cache_.get());
+  }
+  if (STATISTICS_ENABLED && statistics_) {
+    statistics_->wait_nanoseconds += timer.get_elapsed_nanoseconds();
+  }
+  return chunk;
+}
+
+}  // namespace rosbag2_bag_v2_plugins
@@ -0,0 +1,132 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROSBAG2_BAG_V2_PLUGINS__STORAGE__BAG_MESSAGE_CURSOR_HPP_
+#define ROSBAG2_BAG_V2_PLUGINS__STORAGE__BAG_MESSAGE_CURSOR_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "bag_chunk.hpp"
+#include "bag_index.hpp"
+#include "chunk_cache.hpp"
+#include "chunk_prefetcher.hpp"
+#include "../statistics.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+struct BagMessage
+{
+  /// The chunk the message lives in, keeps the message data alive
+  std::shared_ptr<const Chunk> chunk;
+  const ChunkMessage * message;
+};
+
+/**
+ * Iterates over the messages of a set of connections in time stamp order.
+ *
+ * Chunks are read only when the iteration reaches their start time, and chunks without messages
+ * of the selected connections are never read. As chunks of a bag may overlap in time, messages of
+ * all chunks read so far are merged.
+ *
+ * With a read ahead, the next chunks are decompressed on background threads while the messages
+ * of the current ones are used.
+ *
+ * The chunks of split bags are merged the same way, the files are opened when first read.
+ */
+class BagMessageCursor
+{
+public:
+  /**
+   * \param start_time messages before this time stamp (ns) are skipped, chunks which end earlier
+   * are not read at all
+   * \param read_ahead number of chunks to decompress in the background at most, 0 reads them on
+   * demand
+   * \param prefetch_threads number of background threads used if read_ahead is not 0
+   * \param memory_mapped whether the bag files are memory mapped instead of read, see
+   * BagFileStreams
+   * \param statistics counts the chunks read and the time waited for them, if not null
+   * \param chunk_cache chunks decompressed before are taken from it instead of being read, if not
+   * null. Chunks read are added to it.
+   * \param prefetch_max_bytes size of the chunks decompressed in the background at most, 0 for no
+   * limit, see ChunkPrefetcher
+   */
+  BagMessageCursor(
+    std::shared_ptr<const BagIndex> bag_index,
+    std::unordered_set<uint32_t> connection_ids,
+    uint64_t start_time = 0,
+    size_t read_ahead = 0,
+    size_t prefetch_threads = 1,
+    bool memory_mapped = false,
+    std::shared_ptr<ChunkStatistics> statistics = nullptr,
+    std::shared_ptr<ChunkCache> chunk_cache = nullptr,
+    size_t prefetch_max_bytes = 0);
+
+  bool has_next();
+
+  /// Must only be called if has_next() returned true
+  BagMessage next();
+
+  /**
+   * Skips messages with the start time as their time stamp which were read before, e.g. by a
+   * cursor of other connections: the first ones of each connection, as many as given for it.
+   */
+  void skip_messages_at_start_time(std::unordered_map<uint32_t, size_t> message_counts);
+
+private:
+  struct ChunkCursor
+  {
+    std::shared_ptr<const Chunk> chunk;
+    size_t next_message;
+    /// Order in which the chunk was read, used to keep the file order for equal time stamps
+    size_t sequence_number;
+
+    uint64_t next_time() const
+    {
+      return chunk->get_messages()[next_message].time;
+    }
+  };
+
+  static bool is_later(const ChunkCursor & lhs, const ChunkCursor & rhs);
+
+  void read_chunks_up_to_next_message();
+  void drop_skipped_messages();
+  BagMessage pop_next_message();
+  std::shared_ptr<const Chunk> read_next_chunk();
+
+  std::shared_ptr<const BagIndex> bag_index_;
+  std::unordered_set<uint32_t> connection_ids_;
+  uint64_t start_time_;
+  // Outlives the prefetcher, whose threads update it
+  std::shared_ptr<ChunkStatistics> statistics_;
+  std::shared_ptr<ChunkCache> chunk_cache_;
+  BagFileStreams files_;
+  /// Indices into the chunk infos of the chunks to read, sorted by start time
+  std::vector<size_t> chunks_to_read_;
+  size_t next_chunk_to_read_;
+  std::unique_ptr<ChunkPrefetcher> prefetcher_;
+  /// Heap of the chunks which still have messages, the one with the earliest message on top
+  std::vector<ChunkCursor> chunk_cursors_;
+  /// Messages still to skip at the start time by connection, see skip_messages_at_start_time
+  std::unordered_map<uint32_t, size_t> skipped_message_counts_;
+};
+
+}  // namespace rosbag2_bag_v2_plugins
+
+#endif  // ROSBAG2_BAG_V2_PLUGINS__STORAGE__BAG_MESSAGE_CURSOR_HPP_
@@ -0,0 +1,136 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "chunk_cache.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace rosbag2_bag_v2_plugins
+{
+
+ChunkCache::ChunkCache(size_t max_chunks, size_t max_bytes)
+: max_chunks_(max_chunks),
+  max_bytes_(max_bytes),
+  bytes_(0) {}
+
+std::shared_ptr<const Chunk> ChunkCache::find(size_t chunk_index)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto position = chunk_positions_.find(chunk_index);
+  if (position == chunk_positions_.end()) {
+    return nullptr;
+  }
+  chunks_.splice(chunks_.begin(), chunks_, position->second);
+  return position->second->chunk;
+}
+
+void ChunkCache::insert(size_t chunk_index, std::shared_ptr<const Chunk> chunk)
+{
+  if (max_chunks_ == 0) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto position = chunk_positions_.find(chunk_index);
+  if (position != chunk_positions_.end()) {
+    bytes_ -= position->second->chunk->get_size();
+    chunks_.erase(position->second);
+  }
+  bytes_ += chunk->get_size();
+  chunks_.push_front({chunk_index, std::move(chunk)});
+  chunk_positions_[chunk_index] = chunks_.begin();
+  drop_least_recently_used_chunks();
+}
+
+void ChunkCache::drop_least_recently_used_chunks()
+{
+  while (chunks_.size() > max_chunks_ || (chunks_.size() > 1 && bytes_ > max_bytes_)) {
+    bytes_ -= chunks_.back().chunk->get_size();
+    chunk_positions_.erase(chunks_.back().chunk_index);
+    chunks_.pop_back();
+  }
+}
+
+size_t ChunkCache::size() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return chunks_.size();
+}
+
+size_t ChunkCache::get_bytes() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return bytes_;
+}
+
+namespace
+{
+
+std::shared_ptr<const Chunk> select_messages(
+  std::shared_ptr<const Chunk> chunk, const ChunkInfoRecord & chunk_info,
+  const std::unordered_set<uint32_t> & connection_ids)
+{
+  auto has_all_connections = std::all_of(
+    chunk_info.message_counts.begin(), chunk_info.message_counts.end(),
+    [&connection_ids](const std::pair<uint32_t, uint32_t> & message_count) {
+      return connection_ids.count(message_count.first) > 0;
+    });
+  if (has_all_connections) {
+    return chunk;
+  }
+
+  std::vector<ChunkMessage> messages;
+  for (const auto & message : chunk->get_messages()) {
+    if (connection_ids.count(message.connection_id) > 0) {
+      messages.push_back(message);
+    }
+  }
+  auto data = chunk->get_data();
+  auto size = chunk->get_size();
+  return std::make_shared<Chunk>(std::move(chunk), data, size, std::move(messages));
+}
+
+}  // namespace
+
+std::shared_ptr<const Chunk> read_cached_chunk(
+  BagFileStreams & files,
+  const BagIndex & bag_index,
+  size_t chunk_index,
+  const std::unordered_set<uint32_t> & connection_ids,
+  ChunkCache * chunk_cache)
+{
+  const auto & chunk_info = bag_index.get_chunk_infos()[chunk_index];
+  if (!chunk_cache) {
+    return read_chunk(files, bag_index, chunk_info, connection_ids);
+  }
+
+  auto chunk = chunk_cache->find(chunk_index);
+  if (!chunk) {
+    std::unordered_set<uint32_t> all_connection_ids;
+    for (const auto & message_count : chunk_info.message_counts) {
+      all_connection_ids.insert(message_count.first);
+    }
+    chunk = read_chunk(files, bag_index, chunk_info, all_connection_ids);
+    chunk_cache->insert(chunk_index, chunk);
+  }
+  return select_messages(std::move(chunk), chunk_info, connection_ids);
+}
+
+}  // namespace rosbag2_bag_v2_plugins
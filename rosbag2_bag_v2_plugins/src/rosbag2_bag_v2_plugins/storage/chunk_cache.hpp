@@ -0,0 +1,101 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef ROSBAG2_BAG_V2_PLUGINS__STORAGE__CHUNK_CACHE_HPP_
+#define ROSBAG2_BAG_V2_PLUGINS__STORAGE__CHUNK_CACHE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "bag_chunk.hpp"
+#include "bag_index.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+/**
+ * Keeps the chunks decompressed last, so that seeking back into them or reading them again for
+ * other topics does not decompress them again. Once more chunks or bytes than the limits are
+ * cached, the least recently used chunks are dropped.
+ *
+ * The cache is safe to use from several threads, e.g. the prefetch threads and the readers of
+ * RosbagV2Storage::open_reader, which share the cache of the storage they were opened from.
+ */
+class ChunkCache
+{
+public:
+  /**
+   * \param max_chunks number of chunks kept at most, 0 keeps none
+   * \param max_bytes size of the chunk data kept at most. The chunk used last is kept even if it
+   * is larger on its own.
+   */
+  ChunkCache(size_t max_chunks, size_t max_bytes);
+
+  /**
+   * \param chunk_index index into the chunk infos of the bag index
+   * \returns the chunk, or nullptr if it is not cached
+   */
+  std::shared_ptr<const Chunk> find(size_t chunk_index);
+
+  /// Caches the chunk as the most recently used one
+  void insert(size_t chunk_index, std::shared_ptr<const Chunk> chunk);
+
+  /// Number of chunks cached
+  size_t size() const;
+
+  /// Size of the data of the chunks cached
+  size_t get_bytes() const;
+
+private:
+  struct CachedChunk
+  {
+    size_t chunk_index;
+    std::shared_ptr<const Chunk> chunk;
+  };
+
+  void drop_least_recently_used_chunks();
+
+  const size_t max_chunks_;
+  const size_t max_bytes_;
+  mutable std::mutex mutex_;
+  /// Most recently used chunk first
+  std::list<CachedChunk> chunks_;
+  std::unordered_map<size_t, std::list<CachedChunk>::iterator> chunk_positions_;
+  size_t bytes_;
+};
+
+/**
+ * Reads a chunk like read_chunk, taking it from the cache if it has been read before.
+ * The cache holds chunks with the messages of all their connections, so that readers of other
+ * connections find them as well. The chunk returned only has the messages of the given connections
+ * and shares the data of the cached one.
+ * \param chunk_index index into the chunk infos of the bag index
+ * \param chunk_cache may be null, then the chunk is just read
+ */
+std::shared_ptr<const Chunk> read_cached_chunk(
+  BagFileStreams & files,
+  const BagIndex & bag_index,
+  size_t chunk_index,
+  const std::unordered_set<uint32_t> & connection_ids,
+  ChunkCache * chunk_cache);
+
+}  // namespace rosbag2_bag_v2_plugins
+
+#endif  // ROSBAG2_BAG_V2_PLUGINS__STORAGE__CHUNK_CACHE_HPP_
@@ -0,0 +1,180 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "chunk_prefetcher.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace rosbag2_bag_v2_plugins
+{
+
+ChunkPrefetcher::ChunkPrefetcher(
+  std::shared_ptr<const BagIndex> bag_index,
+  std::vector<size_t> chunk_indices,
+  std::unordered_set<uint32_t> connection_ids,
+  size_t read_ahead,
+  size_t thread_count,
+  bool memory_mapped,
+  ChunkStatistics * statistics,
+  ChunkCache * chunk_cache,
+  size_t max_bytes)
+: bag_index_(std::move(bag_index)),
+  chunk_indices_(std::move(chunk_indices)),
+  connection_ids_(std::move(connection_ids)),
+  max_read_ahead_(std::max<size_t>(read_ahead, 1)),
+  max_bytes_(max_bytes),
+  chunk_cache_(chunk_cache),
+  statistics_(statistics),
+  stopped_(false),
+  next_chunk_(0),
+  chunks_being_read_(0),
+  pending_bytes_(0),
+  last_chunk_bytes_(0)
+{
+  // More threads than chunks in flight would never have anything to do
+  thread_count = std::max<size_t>(1, std::min(thread_count, max_read_ahead_));
+  // Every thread starts with a chunk, the read ahead adapts to the reader from then on
+  read_ahead_ = thread_count;
+  for (size_t i = 0; i < thread_count; ++i) {
+    files_.push_back(std::make_unique<BagFileStreams>(bag_index_, memory_mapped, statistics));
+  }
+  for (auto & file : files_) {
+    threads_.emplace_back(&ChunkPrefetcher::read_chunks, this, file.get());
+  }
+}
+
+ChunkPrefetcher::~ChunkPrefetcher()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+  }
+  chunk_taken_.notify_all();
+  for (auto & thread : threads_) {
+    thread.join();
+  }
+}
+
+std::shared_ptr<const Chunk> ChunkPrefetcher::next()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (next_chunk_ >= chunk_indices_.size()) {
+    throw std::runtime_error("No more chunks to read");
+  }
+  auto waited = pending_chunks_.empty() || !pending_chunks_.front().done;
+  chunk_done_.wait(
+    lock, [this]() {
+      return !pending_chunks_.empty() && pending_chunks_.front().done;
+    });
+
+  auto pending_chunk = std::move(pending_chunks_.front());
+  pending_chunks_.pop_front();
+  ++next_chunk_;
+  if (pending_chunk.chunk) {
+    pending_bytes_ -= pending_chunk.chunk->get_size();
+  }
+  adapt_read_ahead(waited);
+  lock.unlock();
+  chunk_taken_.notify_all();
+
+  if (pending_chunk.error) {
+    std::rethrow_exception(pending_chunk.error);
+  }
+  return std::move(pending_chunk.chunk);
+}
+
+size_t ChunkPrefetcher::get_read_ahead() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return read_ahead_;
+}
+
+void ChunkPrefetcher::adapt_read_ahead(bool waited)
+{
+  if (waited) {
+    // The reader is starving, e.g. when replaying fast, so more chunks are read at once
+    read_ahead_ = std::min(max_read_ahead_, 2 * read_ahead_);
+    if (STATISTICS_ENABLED && statistics_) {
+      ++statistics_->stalls;
+    }
+  } else if (chunks_being_read_ == 0 && pending_chunks_.size() + 1 >= read_ahead_) {
+    // All chunks read ahead were decompressed before they were asked for, so fewer will do
+    read_ahead_ = std::max<size_t>(1, read_ahead_ - 1);
+  }
+}
+
+bool ChunkPrefetcher::can_claim_chunk() const
+{
+  if (pending_chunks_.size() >= read_ahead_) {
+    return false;
+  }
+  // A single chunk is always read, however large it is
+  if (max_bytes_ == 0 || pending_chunks_.empty()) {
+    return true;
+  }
+  return pending_bytes_ + (chunks_being_read_ + 1) * last_chunk_bytes_ <= max_bytes_;
+}
+
+void ChunkPrefetcher::read_chunks(BagFileStreams * files)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    chunk_taken_.wait(
+      lock, [this]() {
+        auto chunk_to_claim = next_chunk_ + pending_chunks_.size();
+        return stopped_ || chunk_to_claim >= chunk_indices_.size() || can_claim_chunk();
+      });
+    auto chunk_to_claim = next_chunk_ + pending_chunks_.size();
+    if (stopped_ || chunk_to_claim >= chunk_indices_.size()) {
+      return;
+    }
+    pending_chunks_.emplace_back();
+    ++chunks_being_read_;
+    if (STATISTICS_ENABLED && statistics_ &&
+      pending_chunks_.size() > statistics_->max_prefetched_chunks)
+    {
+      statistics_->max_prefetched_chunks = pending_chunks_.size();
+    }
+    lock.unlock();
+
+    PendingChunk pending_chunk;
+    try {
+      pending_chunk.chunk = read_cached_chunk(
+        *files, *bag_index_, chunk_indices_[chunk_to_claim], connection_ids_, chunk_cache_);
+    } catch (const std::exception &) {
+      pending_chunk.error = std::current_exception();
+    }
+    pending_chunk.done = true;
+
+    lock.lock();
+    --chunks_being_read_;
+    if (pending_chunk.chunk) {
+      last_chunk_bytes_ = pending_chunk.chunk->get_size();
+      pending_bytes_ += last_chunk_bytes_;
+      if (STATISTICS_ENABLED && statistics_ && pending_bytes_ > statistics_->max_prefetched_bytes) {
+        statistics_->max_prefetched_bytes = pending_bytes_;
+      }
+    }
+    // Chunks are only taken once done, so the claimed one is still pending at the same place
+    pending_chunks_[chunk_to_claim - next_chunk_] = std::move(pending_chunk);
+    chunk_done_.notify_all();
+  }
+}
+
+}  // namespace rosbag2_bag_v2_plugins
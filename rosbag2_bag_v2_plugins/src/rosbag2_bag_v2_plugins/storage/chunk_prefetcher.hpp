@@ -0,0 +1,127 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROSBAG2_BAG_V2_PLUGINS__STORAGE__CHUNK_PREFETCHER_HPP_
+#define ROSBAG2_BAG_V2_PLUGINS__STORAGE__CHUNK_PREFETCHER_HPP_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "bag_chunk.hpp"
+#include "bag_index.hpp"
+#include "chunk_cache.hpp"
+#include "../statistics.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+/**
+ * Reads and decompresses chunks on background threads ahead of their use.
+ *
+ * The chunks are handed out in the given order. The number of chunks read ahead adapts to how
+ * fast they are taken: it starts at the number of threads, doubles whenever the reader has to wait
+ * for a chunk, and shrinks by one whenever the reader finds all chunks read ahead decompressed
+ * already. So a slow reader, e.g. replaying at a low rate, keeps few chunks in memory, while a fast
+ * one gets as many as it needs, up to read_ahead. The size of the chunks read ahead is bounded by
+ * max_bytes as well, except for a single chunk.
+ */
+class ChunkPrefetcher
+{
+public:
+  /**
+   * \param chunk_indices indices into the chunk infos of the bag index of the chunks to read
+   * \param read_ahead number of chunks read ahead at most
+   * \param chunk_cache chunks found in it are not read again, and chunks read are added to it,
+   * if not null
+   * \param max_bytes size of the chunks read ahead at most, 0 for no limit. As the size of a chunk
+   * is only known once it is decompressed, chunks being read are assumed to be as large as the
+   * last one.
+   */
+  ChunkPrefetcher(
+    std::shared_ptr<const BagIndex> bag_index,
+    std::vector<size_t> chunk_indices,
+    std::unordered_set<uint32_t> connection_ids,
+    size_t read_ahead,
+    size_t thread_count,
+    bool memory_mapped = false,
+    ChunkStatistics * statistics = nullptr,
+    ChunkCache * chunk_cache = nullptr,
+    size_t max_bytes = 0);
+
+  ~ChunkPrefetcher();
+
+  ChunkPrefetcher(const ChunkPrefetcher &) = delete;
+  ChunkPrefetcher & operator=(const ChunkPrefetcher &) = delete;
+
+  /**
+   * Returns the next chunk, waiting until it has been decompressed.
+   * Must be called at most once per chunk index.
+   * \throws std::runtime_error if the chunk could not be read
+   */
+  std::shared_ptr<const Chunk> next();
+
+  /// Number of chunks currently read ahead at most
+  size_t get_read_ahead() const;
+
+private:
+  struct PendingChunk
+  {
+    bool done = false;
+    std::shared_ptr<const Chunk> chunk;
+    std::exception_ptr error;
+  };
+
+  void read_chunks(BagFileStreams * files);
+  bool can_claim_chunk() const;
+  void adapt_read_ahead(bool waited);
+
+  std::shared_ptr<const BagIndex> bag_index_;
+  const std::vector<size_t> chunk_indices_;
+  const std::unordered_set<uint32_t> connection_ids_;
+  const size_t max_read_ahead_;
+  const size_t max_bytes_;
+  ChunkCache * const chunk_cache_;
+  ChunkStatistics * const statistics_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable chunk_done_;
+  std::condition_variable chunk_taken_;
+  bool stopped_;
+  /// Index of the chunk returned by the next call to next(), which is the front of pending_chunks_
+  size_t next_chunk_;
+  /// Chunks being read or waiting to be taken, starting at next_chunk_
+  std::deque<PendingChunk> pending_chunks_;
+  size_t read_ahead_;
+  /// Chunks of pending_chunks_ not done yet, and the size of the ones done
+  size_t chunks_being_read_;
+  size_t pending_bytes_;
+  /// Size of the chunk read last, assumed for the chunks being read
+  size_t last_chunk_bytes_;
+
+  // Every thread has files of its own, so that reads need not be serialized
+  std::vector<std::unique_ptr<BagFileStreams>> files_;
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace rosbag2_bag_v2_plugins
+
+#endif  // ROSBAG2_BAG_V2_PLUGINS__STORAGE__CHUNK_PREFETCHER_HPP_
@@ -0,0 +1,138 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace rosbag2_bag_v2_plugins
+{
+
+std::shared_ptr<const MappedFile> MappedFile::open(const std::string & path)
+{
+  std::shared_ptr<MappedFile> file(new MappedFile());
+#ifdef _WIN32
+  auto file_handle = CreateFileA(
+    path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+    FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file_handle == INVALID_HANDLE_VALUE) {
+    throw std::runtime_error("Could not open bag file '" + path + "'");
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file_handle, &size)) {
+    CloseHandle(file_handle);
+    throw std::runtime_error("Could not get the size of bag file '" + path + "'");
+  }
+  file->size_ = static_cast<size_t>(size.QuadPart);
+  if (file->size_ > 0) {
+    // Copy on write, so that a consumer writing into a borrowed message cannot change the file
+    file->mapping_handle_ = CreateFileMappingA(file_handle, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    if (file->mapping_handle_) {
+      file->data_ = static_cast<const uint8_t *>(
+        MapViewOfFile(file->mapping_handle_, FILE_MAP_COPY, 0, 0, 0));
+    }
+  }
+  // The mapping keeps the file open
+  CloseHandle(file_handle);
+  if (file->size_ > 0 && !file->data_) {
+    throw std::runtime_error("Could not map bag file '" + path + "' into memory");
+  }
+#else
+  auto descriptor = ::open(path.c_str(), O_RDONLY);
+  if (descriptor < 0) {
+    throw std::runtime_error("Could not open bag file '" + path + "'");
+  }
+  struct stat status;
+  if (fstat(descriptor, &status) != 0) {
+    close(descriptor);
+    throw std::runtime_error("Could not get the size of bag file '" + path + "'");
+  }
+  file->size_ = static_cast<size_t>(status.st_size);
+  if (file->size_ > 0) {
+    // Copy on write, so that a consumer writing into a borrowed message cannot change the file
+    auto data = mmap(nullptr, file->size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, descriptor, 0);
+    if (data == MAP_FAILED) {
+      close(descriptor);
+      throw std::runtime_error("Could not map bag file '" + path + "' into memory");
+    }
+    file->data_ = static_cast<const uint8_t *>(data);
+    madvise(data, file->size_, MADV_SEQUENTIAL);
+  }
+  // The mapping keeps the file open
+  close(descriptor);
+#endif
+  return file;
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+  if (data_) {
+    UnmapViewOfFile(const_cast<uint8_t *>(data_));
+  }
+  if (mapping_handle_) {
+    CloseHandle(mapping_handle_);
+  }
+#else
+  if (data_) {
+    munmap(const_cast<uint8_t *>(data_), size_);
+  }
+#endif
+}
+
+const uint8_t * MappedFile::data() const
+{
+  return data_;
+}
+
+size_t MappedFile::size() const
+{
+  return size_;
+}
+
+void MappedFile::will_need(uint64_t offset, size_t length) const
+{
+#ifdef _WIN32
+  // PrefetchVirtualMemory is not available on all supported versions, read ahead is left to the
+  // FILE_FLAG_SEQUENTIAL_SCAN hint
+  (void)offset;
+  (void)length;
+#else
+  if (offset >= size_) {
+    return;
+  }
+  // madvise needs a page aligned address
+  auto page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+  auto aligned_offset = offset - offset % page_size;
+  auto end = std::min<uint64_t>(offset + length, size_);
+  madvise(
+    const_cast<uint8_t *>(data_) + aligned_offset, static_cast<size_t>(end - aligned_offset),
+    MADV_WILLNEED);
+#endif
+}
+
+}  // namespace rosbag2_bag_v2_plugins
@@ -0,0 +1,64 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef ROSBAG2_BAG_V2_PLUGINS__STORAGE__MAPPED_FILE_HPP_
+#define ROSBAG2_BAG_V2_PLUGINS__STORAGE__MAPPED_FILE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace rosbag2_bag_v2_plugins
+{
+
+/**
+ * A file mapped read-only into memory, so that its records can be parsed without copying them.
+ * The mapping is released with the last reference to it, chunks referring into it keep it alive.
+ */
+class MappedFile
+{
+public:
+  /**
+   * Maps the whole file and advises the kernel that it is read sequentially.
+   * \throws std::runtime_error if the file cannot be opened or mapped
+   */
+  static std::shared_ptr<const MappedFile> open(const std::string & path);
+
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile & operator=(const MappedFile &) = delete;
+
+  const uint8_t * data() const;
+
+  size_t size() const;
+
+  /// Asks the kernel to read a range of the file ahead of its use. Only a hint, errors are ignored.
+  void will_need(uint64_t offset, size_t length) const;
+
+private:
+  MappedFile() = default;
+
+  const uint8_t * data_ = nullptr;
+  size_t size_ = 0;
+#ifdef _WIN32
+  void * mapping_handle_ = nullptr;
+#endif
+};
+
+}  // namespace rosbag2_bag_v2_plugins
+
+#endif  // ROSBAG2_BAG_V2_PLUGINS__STORAGE__MAPPED_FILE_HPP_
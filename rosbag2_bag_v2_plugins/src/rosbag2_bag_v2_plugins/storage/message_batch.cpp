@@ -0,0 +1,77 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "message_batch.hpp"
+
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../message_type_header.hpp"
+#include "../non_owning_uint8_array.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+MessageBatchBuilder::MessageBatchBuilder(size_t message_count, size_t data_size)
+: arena_(std::make_shared<Arena>()),
+  data_used_(0)
+{
+  arena_->data.resize(data_size);
+  // Reserving means the serialized data never moves once a message points at it
+  arena_->serialized_data.reserve(message_count);
+  messages_.reserve(message_count);
+}
+
+uint8_t * MessageBatchBuilder::add_message(
+  const std::string & topic_name,
+  rcutils_time_point_value_t time_stamp,
+  const ConverterHandle & converter,
+  size_t data_length)
+{
+  auto prefix_length = COMPACT_MESSAGE_HEADER_LENGTH;
+  if (arena_->serialized_data.size() == arena_->serialized_data.capacity() ||
+    arena_->data.size() - data_used_ < prefix_length + data_length)
+  {
+    throw std::runtime_error("Message does not fit into the batch");
+  }
+
+  auto buffer = arena_->data.data() + data_used_;
+  write_compact_message_header(converter, buffer);
+  data_used_ += prefix_length + data_length;
+
+  arena_->serialized_data.push_back(
+    make_non_owning_uint8_array(buffer, prefix_length + data_length, nullptr));
+
+  auto message = std::make_shared<rosbag2_storage::SerializedBagMessage>();
+  message->serialized_data =
+    std::shared_ptr<rcutils_uint8_array_t>(arena_, &arena_->serialized_data.back());
+  message->time_stamp = time_stamp;
+  message->topic_name = topic_name;
+  messages_.push_back(std::move(message));
+
+  return buffer + prefix_length;
+}
+
+void MessageBatchBuilder::append_messages_to(
+  std::vector<std::shared_ptr<rosbag2_storage::SerializedBagMessage>> & messages)
+{
+  messages.insert(messages.end(), messages_.begin(), messages_.end());
+  messages_.clear();
+}
+
+}  // namespace rosbag2_bag_v2_plugins
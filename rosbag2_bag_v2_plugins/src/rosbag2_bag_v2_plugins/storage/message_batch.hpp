@@ -0,0 +1,76 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROSBAG2_BAG_V2_PLUGINS__STORAGE__MESSAGE_BATCH_HPP_
+#define ROSBAG2_BAG_V2_PLUGINS__STORAGE__MESSAGE_BATCH_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rcutils/time.h"
+#include "rcutils/types/uint8_array.h"
+#include "rosbag2_storage/serialized_bag_message.hpp"
+
+#include "../converter_handle.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+/**
+ * Builds the messages of a batch read in one contiguous arena.
+ *
+ * The serialized data of every message starts with the compact type header, exactly like the data
+ * written by RosbagOutputStream, but all of it lives in one buffer allocated up front. Each
+ * message keeps the whole arena alive. Its serialized data must not be resized, its allocator
+ * refuses all allocations.
+ */
+class MessageBatchBuilder
+{
+public:
+  /// \param data_size total size of all messages including their COMPACT_MESSAGE_HEADER_LENGTH
+  MessageBatchBuilder(size_t message_count, size_t data_size);
+
+  /**
+   * Adds a message and writes its type header.
+   * \returns the space for the data_length bytes of the message itself
+   * \throws std::runtime_error if the message does not fit into what was reserved
+   */
+  uint8_t * add_message(
+    const std::string & topic_name,
+    rcutils_time_point_value_t time_stamp,
+    const ConverterHandle & converter,
+    size_t data_length);
+
+  /// Appends the messages added so far to the given ones
+  void append_messages_to(
+    std::vector<std::shared_ptr<rosbag2_storage::SerializedBagMessage>> & messages);
+
+private:
+  struct Arena
+  {
+    std::vector<uint8_t> data;
+    std::vector<rcutils_uint8_array_t> serialized_data;
+  };
+
+  std::shared_ptr<Arena> arena_;
+  size_t data_used_;
+  std::vector<std::shared_ptr<rosbag2_storage::SerializedBagMessage>> messages_;
+};
+
+}  // namespace rosbag2_bag_v2_plugins
+
+#endif  // ROSBAG2_BAG_V2_PLUGINS__STORAGE__MESSAGE_BATCH_HPP_
@@ -0,0 +1,216 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "message_pool.hpp"
+
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "rcutils/allocator.h"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+namespace
+{
+
+constexpr size_t MIN_SIZE_CLASS = 6;
+constexpr size_t MIN_BLOCK_SIZE = size_t{1} << MIN_SIZE_CLASS;
+constexpr size_t SIZE_CLASS_COUNT = sizeof(size_t) * 8;
+
+}  // namespace
+
+class MessagePool::State
+{
+public:
+  explicit State(size_t max_bytes_held)
+  : max_bytes_held_(max_bytes_held), free_blocks_(SIZE_CLASS_COUNT) {}
+
+  ~State()
+  {
+    for (auto & free_blocks : free_blocks_) {
+      for (auto block : free_blocks) {
+        std::free(block);
+      }
+    }
+  }
+
+  /// \returns the size of the blocks of the size class holding the given size
+  static size_t get_block_size(size_t size)
+  {
+    return size_t{1} << get_size_class(size);
+  }
+
+  /// Blocks are allocated with malloc, so that rcutils' default allocator can resize and free them
+  void * allocate(size_t size)
+  {
+    auto size_class = get_size_class(size);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto & free_blocks = free_blocks_[size_class];
+      if (!free_blocks.empty()) {
+        auto block = free_blocks.back();
+        free_blocks.pop_back();
+        statistics_.bytes_held -= size_t{1} << size_class;
+        ++statistics_.hits;
+        return block;
+      }
+      ++statistics_.misses;
+    }
+    auto block = std::malloc(size_t{1} << size_class);
+    if (!block) {
+      throw std::bad_alloc();
+    }
+    return block;
+  }
+
+  void deallocate(void * block, size_t block_size)
+  {
+    // Resized buffers no longer have the size of a class
+    if (block_size < MIN_BLOCK_SIZE || (block_size & (block_size - 1)) != 0) {
+      std::free(block);
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (statistics_.bytes_held + block_size <= max_bytes_held_) {
+        free_blocks_[get_size_class(block_size)].push_back(block);
+        statistics_.bytes_held += block_size;
+        return;
+      }
+      statistics_.bytes_discarded += block_size;
+    }
+    std::free(block);
+  }
+
+  MessagePoolStatistics get_statistics() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return statistics_;
+  }
+
+private:
+  static size_t get_size_class(size_t size)
+  {
+    if (size > (size_t{1} << (SIZE_CLASS_COUNT - 1))) {
+      throw std::bad_alloc();
+    }
+    auto size_class = MIN_SIZE_CLASS;
+    while ((size_t{1} << size_class) < size) {
+      ++size_class;
+    }
+    return size_class;
+  }
+
+  mutable std::mutex mutex_;
+  const size_t max_bytes_held_;
+  std::vector<std::vector<void *>> free_blocks_;
+  MessagePoolStatistics statistics_;
+};
+
+namespace
+{
+
+// Lets std::allocate_shared put objects and their control blocks into pool blocks
+template<typename T>
+struct PoolAllocator
+{
+  using value_type = T;
+
+  explicit PoolAllocator(std::shared_ptr<MessagePool::State> state)
+  : state(std::move(state)) {}
+
+  template<typename U>
+  PoolAllocator(const PoolAllocator<U> & other)  // NOLINT(runtime/explicit)
+  : state(other.state) {}
+
+  T * allocate(size_t n)
+  {
+    return static_cast<T *>(state->allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T * pointer, size_t n)
+  {
+    state->deallocate(pointer, MessagePool::State::get_block_size(n * sizeof(T)));
+  }
+
+  std::shared_ptr<MessagePool::State> state;
+};
+
+template<typename T, typename U>
+bool operator==(const PoolAllocator<T> & lhs, const PoolAllocator<U> & rhs)
+{
+  return lhs.state == rhs.state;
+}
+
+template<typename T, typename U>
+bool operator!=(const PoolAllocator<T> & lhs, const PoolAllocator<U> & rhs)
+{
+  return !(lhs == rhs);
+}
+
+struct PooledBuffer
+{
+  PooledBuffer(MessagePool::State * state, size_t capacity)
+  : state(state)
+  {
+    auto block_size = MessagePool::State::get_block_size(capacity);
+    array = rcutils_get_zero_initialized_uint8_array();
+    array.buffer = static_cast<uint8_t *>(state->allocate(block_size));
+    array.buffer_capacity = block_size;
+    array.allocator = rcutils_get_default_allocator();
+  }
+
+  ~PooledBuffer()
+  {
+    if (array.buffer) {
+      state->deallocate(array.buffer, array.buffer_capacity);
+    }
+  }
+
+  rcutils_uint8_array_t array;
+  // The allocator of the control block around this buffer keeps the state alive
+  MessagePool::State * state;
+};
+
+}  // namespace
+
+MessagePool::MessagePool(size_t max_bytes_held)
+: state_(std::make_shared<State>(max_bytes_held)) {}
+
+MessagePool::~MessagePool() = default;
+
+std::shared_ptr<rosbag2_storage::SerializedBagMessage> MessagePool::make_message()
+{
+  return std::allocate_shared<rosbag2_storage::SerializedBagMessage>(
+    PoolAllocator<rosbag2_storage::SerializedBagMessage>(state_));
+}
+
+std::shared_ptr<rcutils_uint8_array_t> MessagePool::make_buffer(size_t capacity)
+{
+  auto pooled_buffer = std::allocate_shared<PooledBuffer>(
+    PoolAllocator<PooledBuffer>(state_), state_.get(), capacity);
+  return std::shared_ptr<rcutils_uint8_array_t>(pooled_buffer, &pooled_buffer->array);
+}
+
+MessagePoolStatistics MessagePool::get_statistics() const
+{
+  return state_->get_statistics();
+}
+
+}  // namespace rosbag2_bag_v2_plugins
@@ -0,0 +1,83 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROSBAG2_BAG_V2_PLUGINS__STORAGE__MESSAGE_POOL_HPP_
+#define ROSBAG2_BAG_V2_PLUGINS__STORAGE__MESSAGE_POOL_HPP_
+
+#include <cstddef>
+#include <memory>
+
+#include "rcutils/types/uint8_array.h"
+#include "rosbag2_storage/serialized_bag_message.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+struct MessagePoolStatistics
+{
+  /// Allocations served from memory returned to the pool before
+  size_t hits = 0;
+  /// Allocations which had to go to the heap
+  size_t misses = 0;
+  /// Memory currently kept by the pool for reuse
+  size_t bytes_held = 0;
+  /// Memory freed instead of kept, because the pool already held max_bytes_held
+  size_t bytes_discarded = 0;
+
+  double hit_rate() const
+  {
+    auto allocations = hits + misses;
+    return allocations == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(allocations);
+  }
+};
+
+/**
+ * Recycles the memory of messages handed out by the storage.
+ *
+ * Messages, their serialized data and the shared_ptr control blocks are allocated in blocks of
+ * power of two size classes. Released blocks go back to a free list of their class, so that a
+ * steady-state replay does not allocate at all. Memory handed out stays valid after the pool is
+ * destroyed, it is only freed once released.
+ */
+class MessagePool
+{
+public:
+  /// \param max_bytes_held released memory beyond this is freed instead of kept
+  explicit MessagePool(size_t max_bytes_held);
+
+  ~MessagePool();
+
+  MessagePool(const MessagePool &) = delete;
+  MessagePool & operator=(const MessagePool &) = delete;
+
+  std::shared_ptr<rosbag2_storage::SerializedBagMessage> make_message();
+
+  /**
+   * Makes an empty buffer with room for at least the given number of bytes.
+   * It uses the default rcutils allocator and may be resized like any other serialized data.
+   */
+  std::shared_ptr<rcutils_uint8_array_t> make_buffer(size_t capacity);
+
+  MessagePoolStatistics get_statistics() const;
+
+  /// The free lists, shared with everything handed out by the pool
+  class State;
+
+private:
+  std::shared_ptr<State> state_;
+};
+
+}  // namespace rosbag2_bag_v2_plugins
+
+#endif  // ROSBAG2_BAG_V2_PLUGINS__STORAGE__MESSAGE_POOL_HPP_
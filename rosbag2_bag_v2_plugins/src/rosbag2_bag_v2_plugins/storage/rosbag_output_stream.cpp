@@ -14,29 +14,84 @@
 
 #include "rosbag_output_stream.hpp"
 
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <utility>
 
-#include "rosbag2_storage/ros_helper.hpp"
+#include "../logging.hpp"
+#include "../message_type_header.hpp"
 
 namespace rosbag2_bag_v2_plugins
 {
 
+std::shared_ptr<rcutils_uint8_array_t> make_uint8_array(
+  size_t capacity, const rcutils_allocator_t & allocator)
+{
+  auto uint8_array = new rcutils_uint8_array_t;
+  *uint8_array = rcutils_get_zero_initialized_uint8_array();
+  auto ret = rcutils_uint8_array_init(uint8_array, capacity, &allocator);
+  if (ret != RCUTILS_RET_OK) {
+    delete uint8_array;
+    throw std::runtime_error("No memory available. Error code " + std::to_string(ret));
+  }
+
+  return std::shared_ptr<rcutils_uint8_array_t>(
+    uint8_array,
+    [](rcutils_uint8_array_t * uint8_array) {
+      int error = rcutils_uint8_array_fini(uint8_array);
+      delete uint8_array;
+      if (error != RCUTILS_RET_OK) {
+        ROSBAG2_BAG_V2_PLUGINS_LOG_ERROR_STREAM(
+          "Leaking memory. Error code " << error);
+      }
+    });
+}
+
 RosbagOutputStream::RosbagOutputStream(const std::string & type)
+: RosbagOutputStream(type, 0)
+{}
+
+RosbagOutputStream::RosbagOutputStream(
+  const std::string & type, size_t message_size, rcutils_allocator_t allocator)
 {
-  char_array_ = rosbag2_storage::make_serialized_message(type.c_str(), type.length() + 1);
+  auto type_zero_terminated_length = type.length() + 1;
+  char_array_ = make_uint8_array(type_zero_terminated_length + message_size, allocator);
+  memcpy(char_array_->buffer, type.c_str(), type_zero_terminated_length);
+  char_array_->buffer_length = type_zero_terminated_length;
+}
+
+RosbagOutputStream::RosbagOutputStream(
+  const ConverterHandle & converter, size_t message_size, rcutils_allocator_t allocator)
+{
+  char_array_ = make_uint8_array(COMPACT_MESSAGE_HEADER_LENGTH + message_size, allocator);
+  write_compact_message_header(converter, advance(COMPACT_MESSAGE_HEADER_LENGTH));
+}
+
+RosbagOutputStream::RosbagOutputStream(
+  const ConverterHandle & converter, std::shared_ptr<rcutils_uint8_array_t> buffer)
+: char_array_(std::move(buffer))
+{
+  char_array_->buffer_length = 0;
+  write_compact_message_header(converter, advance(COMPACT_MESSAGE_HEADER_LENGTH));
 }
 
 uint8_t * RosbagOutputStream::advance(size_t size)
 {
-  auto old_capacity = char_array_->buffer_capacity;
-  auto ret = rcutils_uint8_array_resize(char_array_.get(), size + old_capacity);
-  if (ret != RCUTILS_RET_OK) {
-    throw std::runtime_error("No memory available. Error code " + std::to_string(ret));
+  auto old_length = char_array_->buffer_length;
+  auto required_capacity = old_length + size;
+  if (required_capacity > char_array_->buffer_capacity) {
+    auto new_capacity = std::max(required_capacity, 2 * char_array_->buffer_capacity);
+    auto ret = rcutils_uint8_array_resize(char_array_.get(), new_capacity);
+    if (ret != RCUTILS_RET_OK) {
+      throw std::runtime_error("No memory available. Error code " + std::to_string(ret));
+    }
   }
-  char_array_->buffer_length = char_array_->buffer_capacity;
-  return char_array_->buffer + old_capacity;
+  char_array_->buffer_length = required_capacity;
+  return char_array_->buffer + old_length;
 }
 
 std::shared_ptr<rcutils_uint8_array_t> RosbagOutputStream::get_content()
@@ -19,16 +19,57 @@
 #include <memory>
 #include <string>
 
+#include "rcutils/allocator.h"
 #include "rcutils/types/uint8_array.h"
 
+#include "../converter_handle.hpp"
+
 namespace rosbag2_bag_v2_plugins
 {
 
+/**
+ * Allocates empty serialized data with the given capacity.
+ * \throws std::runtime_error if no memory is available
+ */
+std::shared_ptr<rcutils_uint8_array_t> make_uint8_array(
+  size_t capacity, const rcutils_allocator_t & allocator = rcutils_get_default_allocator());
+
 class RosbagOutputStream
 {
 public:
   explicit RosbagOutputStream(const std::string & type);
 
+  /**
+   * Reserves space for the type prefix and a message of the given size in a single allocation.
+   * \param type the ROS 1 data type which is written in front of the message
+   * \param message_size the expected size of the serialized message, e.g. MessageInstance::size()
+   * \param allocator the allocator used for the serialized data
+   */
+  RosbagOutputStream(
+    const std::string & type,
+    size_t message_size,
+    rcutils_allocator_t allocator = rcutils_get_default_allocator());
+
+  /**
+   * Same as above, but writes the compact header with the id of the converter handle instead of
+   * the type name, see message_type_header.hpp. This is what the storage plugin uses.
+   */
+  RosbagOutputStream(
+    const ConverterHandle & converter,
+    size_t message_size,
+    rcutils_allocator_t allocator = rcutils_get_default_allocator());
+
+  /**
+   * Writes the compact header into the given empty buffer, e.g. one from a MessagePool, instead of
+   * allocating one. The buffer grows like an allocated one if it is too small.
+   */
+  RosbagOutputStream(
+    const ConverterHandle & converter, std::shared_ptr<rcutils_uint8_array_t> buffer);
+
+  /**
+   * Returns a pointer to size bytes at the end of the written data.
+   * If the reserved space does not suffice, the buffer at least doubles its capacity.
+   */
   uint8_t * advance(size_t size);
 
   std::shared_ptr<rcutils_uint8_array_t> get_content();
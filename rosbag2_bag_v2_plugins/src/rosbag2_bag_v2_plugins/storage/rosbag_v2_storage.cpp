@@ -14,8 +14,16 @@
 
 #include "rosbag_v2_storage.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <limits>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <utility>
 
@@ -27,9 +35,15 @@
 #include "rosbag2_storage/ros_helper.hpp"
 #include "rosbag2_storage/serialized_bag_message.hpp"
 #include "rosbag2_storage/topic_metadata.hpp"
+#include "bag_index_cache.hpp"
+#include "message_batch.hpp"
 #include "rosbag_output_stream.hpp"
+#include "split_bag.hpp"
+#include "../borrowed_message_buffer.hpp"
+#include "../cdr_transcoder.hpp"
 #include "../logging.hpp"
-#include "../convert_rosbag_message.hpp"
+#include "../message_type_header.hpp"
+#include "../converter_handle.hpp"
 
 namespace rosbag2_bag_v2_plugins
 {
@@ -37,14 +51,72 @@ namespace rosbag2_bag_v2_plugins
 namespace
 {
 constexpr const char * const IDENTIFIER = "rosbag_v2";
+constexpr const char * const ROSBAG_V2_SERIALIZATION_FORMAT = "rosbag_v2";
+
+// Collects topics in the order they are first seen, skipping repeated (topic, type) pairs.
+// Merged bags easily have thousands of connections, one per publisher, so lookups are hashed.
+class UniqueTopicsWithType
+{
+public:
+  explicit UniqueTopicsWithType(const std::string & serialization_format)
+  : serialization_format_(serialization_format) {}
+
+  void add(const std::string & topic, const std::string & type)
+  {
+    // Neither topic nor type names can contain a newline, which makes the key unambiguous
+    if (topics_and_types_seen_.insert(topic + '\n' + type).second) {
+      rosbag2_storage::TopicMetadata topic_metadata;
+      topic_metadata.name = topic;
+      topic_metadata.type = type;
+      topic_metadata.serialization_format = serialization_format_;
+      topics_with_type_.push_back(std::move(topic_metadata));
+    }
+  }
+
+  std::vector<rosbag2_storage::TopicMetadata> release()
+  {
+    topics_and_types_seen_.clear();
+    return std::move(topics_with_type_);
+  }
+
+private:
+  std::string serialization_format_;
+  std::unordered_set<std::string> topics_and_types_seen_;
+  std::vector<rosbag2_storage::TopicMetadata> topics_with_type_;
+};
+
+std::string make_view_converter_key(const std::string & datatype, const std::string & md5sum)
+{
+  return datatype + '\n' + md5sum;
 }
+}  // namespace
 
 RosbagV2Storage::RosbagV2Storage()
-: ros_v2_bag_(std::make_unique<rosbag::Bag>()), bag_view_of_replayable_messages_(nullptr) {}
+: options_(RosbagV2StorageOptions::from_environment()),
+  chunk_statistics_(std::make_shared<ChunkStatistics>()),
+  allocations_(0),
+  replay_time_(0),
+  transcode_to_cdr_(false),
+  bag_view_of_replayable_messages_(nullptr) {}
 
 RosbagV2Storage::~RosbagV2Storage()
 {
-  ros_v2_bag_->close();
+  if (STATISTICS_ENABLED && !topic_statistics_.empty()) {
+    ROSBAG2_BAG_V2_PLUGINS_LOG_DEBUG_STREAM(get_statistics());
+  }
+  for (auto & bag : ros_v2_bags_) {
+    bag->close();
+  }
+}
+
+void RosbagV2Storage::set_options(const RosbagV2StorageOptions & options)
+{
+  options_ = options;
+}
+
+const RosbagV2StorageOptions & RosbagV2Storage::get_options() const
+{
+  return options_;
 }
 
 void RosbagV2Storage::open(
@@ -54,16 +126,216 @@ void RosbagV2Storage::open(
     throw std::runtime_error("The rosbag_v2 storage plugin can only be used to read");
   }
 
-  ros_v2_bag_->open(uri);
-  auto bag_view = std::make_unique<rosbag::View>(*ros_v2_bag_);
+  if (options_.serialization_format != ROSBAG_V2_SERIALIZATION_FORMAT &&
+    options_.serialization_format != CDR_SERIALIZATION_FORMAT)
+  {
+    throw std::runtime_error(
+            "The rosbag_v2 storage plugin cannot read messages in serialization format '" +
+            options_.serialization_format + "'");
+  }
+  transcode_to_cdr_ = options_.serialization_format == CDR_SERIALIZATION_FORMAT;
+
+  bag_uri_ = uri;
+  bag_file_paths_ = find_split_bag_files(uri);
+  metadata_.reset();
+  message_pool_ = options_.message_pool ?
+    std::make_unique<MessagePool>(options_.message_pool_max_bytes) : nullptr;
+
+  // Opening a rosbag::Bag reads the index of every single chunk, which is not needed when reading
+  // the chunks ourselves
+  std::function<std::shared_ptr<const BagIndex>(const std::string &)> read_index =
+    options_.fast_open ? &BagIndex::read_deferring_chunk_infos : &BagIndex::read;
+  if (options_.index_cache) {
+    auto index_cache_directory = options_.index_cache_directory;
+    read_index = [index_cache_directory](const std::string & path) {
+        return read_bag_index_using_cache(path, index_cache_directory);
+      };
+  }
+  bag_index_ = read_split_bag_index(bag_file_paths_, read_index);
+  if (bag_index_) {
+    // Without a cache, chunks are read with the messages of the filtered connections only
+    chunk_cache_ = options_.chunk_cache_chunks > 0 ?
+      std::make_shared<ChunkCache>(options_.chunk_cache_chunks, options_.chunk_cache_bytes) :
+      nullptr;
+    open_replay_cursor();
+  } else {
+    open_ros_v2_bags();
+    open_replay_view();
+  }
+}
+
+void RosbagV2Storage::open_ros_v2_bags()
+{
+  ros_v2_bags_.clear();
+  for (const auto & path : bag_file_paths_) {
+    ros_v2_bags_.push_back(std::make_unique<rosbag::Bag>());
+    ros_v2_bags_.back()->open(path);
+  }
+}
+
+std::unique_ptr<rosbag::View> RosbagV2Storage::make_view() const
+{
+  // A view of several bags merges their messages by time stamp, just as for split bags
+  auto view = std::make_unique<rosbag::View>();
+  for (const auto & bag : ros_v2_bags_) {
+    view->addQuery(*bag);
+  }
+  return view;
+}
+
+std::unique_ptr<rosbag::View> RosbagV2Storage::make_view(
+  const rosbag::TopicQuery & query, const ros::Time & start_time) const
+{
+  auto view = std::make_unique<rosbag::View>();
+  for (const auto & bag : ros_v2_bags_) {
+    view->addQuery(*bag, query, start_time);
+  }
+  return view;
+}
+
+std::unique_ptr<RosbagV2Storage> RosbagV2Storage::open_reader() const
+{
+  if (!bag_index_ && ros_v2_bags_.empty()) {
+    throw std::runtime_error("Cannot open another reader of a storage which is not open");
+  }
+
+  auto reader = std::make_unique<RosbagV2Storage>();
+  reader->options_ = options_;
+  reader->transcode_to_cdr_ = transcode_to_cdr_;
+  reader->bag_uri_ = bag_uri_;
+  reader->bag_file_paths_ = bag_file_paths_;
+  reader->ros1_connections_ = ros1_connections_;
+  if (metadata_) {
+    reader->metadata_ = std::make_unique<rosbag2_storage::BagMetadata>(*metadata_);
+  }
+  // Messages are pooled per reader, so that readers do not contend for the pool
+  reader->message_pool_ = options_.message_pool ?
+    std::make_unique<MessagePool>(options_.message_pool_max_bytes) : nullptr;
+
+  // The index is immutable, the replayable connections point into it
+  reader->bag_index_ = bag_index_;
+  if (bag_index_) {
+    reader->replayable_connections_ = replayable_connections_;
+    // Readers of other topics take the chunks read before from the cache
+    reader->chunk_cache_ = chunk_cache_;
+    reader->reset_replay_cursor();
+  } else {
+    // rosbag::Bag is not thread safe, every reader opens the files itself
+    reader->open_ros_v2_bags();
+    reader->replayable_topics_ = replayable_topics_;
+    reader->view_converters_ = view_converters_;
+    reader->reset_replay_view();
+  }
+  return reader;
+}
+
+void RosbagV2Storage::open_replay_cursor()
+{
+  for (const auto & connection : bag_index_->get_connections()) {
+    // Resolving the converter here means the deserializer finds it already cached
+    auto converter = resolve_connection_converter(connection);
+    if (converter) {
+      replayable_connections_[connection.id] = {&connection, converter};
+      ros1_connections_.emplace(connection.topic, connection);
+    } else {
+      ROSBAG2_BAG_V2_PLUGINS_LOG_INFO_STREAM("ROS 1 to ROS 2 type mapping is not available for "
+        "topic '" << connection.topic << "' which is of type '" << connection.datatype <<
+        "'. Skipping messages of this topic when replaying.");
+    }
+  }
+
+  if (options_.zero_copy && transcode_to_cdr_) {
+    ROSBAG2_BAG_V2_PLUGINS_LOG_INFO(
+      "Zero copy reading is not supported with transcoding to CDR, messages are transcoded.");
+  }
+  reset_replay_cursor();
+}
+
+const ConverterHandle * RosbagV2Storage::resolve_connection_converter(
+  const ConnectionRecord & connection) const
+{
+  if (!options_.generic_conversion) {
+    return resolve_converter_handle(connection.datatype);
+  }
+  return resolve_converter_handle(
+    connection.datatype, connection.md5sum, connection.message_definition);
+}
+
+void RosbagV2Storage::reset_replay_cursor()
+{
+  // Created when the next message is read, so that setting the filter and seeking right after
+  // opening neither reads the chunk infos nor prefetches chunks more than once
+  message_cursor_.reset();
+}
+
+BagMessageCursor & RosbagV2Storage::get_replay_cursor()
+{
+  if (message_cursor_) {
+    return *message_cursor_;
+  }
+
+  std::unordered_set<uint32_t> connection_ids;
+  for (const auto & replayable_connection : replayable_connections_) {
+    if (passes_topic_filter(replayable_connection.second.connection->topic)) {
+      connection_ids.insert(replayable_connection.first);
+    }
+  }
+
+  auto prefetch_chunks = options_.get_effective_prefetch_chunks();
+  auto prefetch_threads = options_.get_effective_prefetch_threads();
+  if (prefetch_chunks == 0 && bag_index_->is_encrypted()) {
+    // Decrypting a chunk stalls the reader far longer than decompressing it, so encrypted chunks
+    // are always decrypted ahead, one per prefetch thread plus one to be picked up next
+    prefetch_chunks = prefetch_threads + 1;
+  }
+
+  message_cursor_ = std::make_unique<BagMessageCursor>(
+    bag_index_, std::move(connection_ids),
+    static_cast<uint64_t>(std::max<int64_t>(replay_time_, 0)), prefetch_chunks, prefetch_threads,
+    options_.memory_map, chunk_statistics_, chunk_cache_, options_.prefetch_max_bytes);
+  if (!connections_read_at_replay_time_.empty()) {
+    std::unordered_map<uint32_t, size_t> skipped_message_counts;
+    for (auto connection_id : connections_read_at_replay_time_) {
+      ++skipped_message_counts[connection_id];
+    }
+    message_cursor_->skip_messages_at_start_time(std::move(skipped_message_counts));
+  }
+  return *message_cursor_;
+}
+
+void RosbagV2Storage::open_replay_view()
+{
+  if (options_.zero_copy && !transcode_to_cdr_) {
+    ROSBAG2_BAG_V2_PLUGINS_LOG_INFO(
+      "Zero copy reading is not supported for this bag, messages are copied.");
+  }
+  if (options_.get_effective_prefetch_chunks() > 0) {
+    ROSBAG2_BAG_V2_PLUGINS_LOG_INFO(
+      "Prefetching chunks is not supported for this bag, chunks are read on demand.");
+  }
+  if (options_.memory_map) {
+    ROSBAG2_BAG_V2_PLUGINS_LOG_INFO(
+      "Memory mapping is not supported for this bag, it is read through rosbag_storage.");
+  }
+
+  auto bag_view = make_view();
 
-  std::vector<std::string> topics_valid_in_ros2;
+  replayable_topics_.clear();
+  view_converters_.clear();
+  std::unordered_set<std::string> topics_seen;
   auto connection_info = bag_view->getConnections();
   for (const auto & connection : connection_info) {
-    std::string ros2_type_name;
-    if (get_1to2_mapping(connection->datatype, ros2_type_name)) {
-      if (!vector_has_already_element<std::string>(topics_valid_in_ros2, connection->topic)) {
-        topics_valid_in_ros2.push_back(connection->topic);
+    ConnectionRecord connection_record{
+      connection->id, connection->topic, connection->datatype, connection->md5sum,
+      connection->msg_def};
+    // Resolving the converter here means the deserializer finds it already cached
+    auto converter = resolve_connection_converter(connection_record);
+    if (converter) {
+      view_converters_[make_view_converter_key(connection->datatype, connection->md5sum)] =
+        converter;
+      if (topics_seen.insert(connection->topic).second) {
+        replayable_topics_.push_back(connection->topic);
+        ros1_connections_[connection->topic] = std::move(connection_record);
       }
     } else {
       ROSBAG2_BAG_V2_PLUGINS_LOG_INFO_STREAM("ROS 1 to ROS 2 type mapping is not available for "
@@ -72,44 +344,332 @@ void RosbagV2Storage::open(
     }
   }
 
-  bag_view_of_replayable_messages_ = std::make_unique<rosbag::View>(
-    *ros_v2_bag_, rosbag::TopicQuery(topics_valid_in_ros2));
+  reset_replay_view();
+}
+
+const ConverterHandle * RosbagV2Storage::find_view_converter(
+  const rosbag::MessageInstance & message_instance) const
+{
+  auto converter = view_converters_.find(
+    make_view_converter_key(message_instance.getDataType(), message_instance.getMD5Sum()));
+  return converter != view_converters_.end() ? converter->second : nullptr;
+}
+
+void RosbagV2Storage::reset_replay_view()
+{
+  std::vector<std::string> topics;
+  for (const auto & topic : replayable_topics_) {
+    if (passes_topic_filter(topic)) {
+      topics.push_back(topic);
+    }
+  }
+
+  ros::Time start_time;
+  start_time.fromNSec(static_cast<uint64_t>(std::max<int64_t>(replay_time_, 0)));
+  bag_view_of_replayable_messages_ = make_view(rosbag::TopicQuery(topics), start_time);
   bag_iterator_ = bag_view_of_replayable_messages_->begin();
+  skipped_view_message_counts_.clear();
+  for (const auto & topic : topics_read_at_replay_time_) {
+    ++skipped_view_message_counts_[topic];
+  }
+}
+
+void RosbagV2Storage::drop_skipped_view_messages()
+{
+  // The view merges the bags by time stamp like the cursor, so messages of one topic keep their
+  // order whichever other topics are read
+  while (!skipped_view_message_counts_.empty()) {
+    if (bag_iterator_ == bag_view_of_replayable_messages_->end()) {
+      skipped_view_message_counts_.clear();
+      return;
+    }
+    const auto & message_instance = *bag_iterator_;
+    auto time_stamp = static_cast<rcutils_time_point_value_t>(message_instance.getTime().toNSec());
+    if (time_stamp != replay_time_) {
+      // All messages at the replay time were read
+      skipped_view_message_counts_.clear();
+      return;
+    }
+    auto skipped_message_count = skipped_view_message_counts_.find(message_instance.getTopic());
+    if (skipped_message_count == skipped_view_message_counts_.end()) {
+      return;
+    }
+    if (--skipped_message_count->second == 0) {
+      skipped_view_message_counts_.erase(skipped_message_count);
+    }
+    bag_iterator_++;
+  }
+}
+
+void RosbagV2Storage::record_read_message(
+  rcutils_time_point_value_t time_stamp, uint32_t connection_id)
+{
+  if (time_stamp != replay_time_) {
+    replay_time_ = time_stamp;
+    connections_read_at_replay_time_.clear();
+  }
+  connections_read_at_replay_time_.push_back(connection_id);
+}
+
+void RosbagV2Storage::record_read_view_message(
+  rcutils_time_point_value_t time_stamp, const std::string & topic)
+{
+  if (time_stamp != replay_time_) {
+    replay_time_ = time_stamp;
+    topics_read_at_replay_time_.clear();
+  }
+  topics_read_at_replay_time_.push_back(topic);
+}
+
+void RosbagV2Storage::reset_replay()
+{
+  // Before open, the filter and seek time are applied when opening
+  if (bag_index_) {
+    reset_replay_cursor();
+  } else if (!ros_v2_bags_.empty()) {
+    reset_replay_view();
+  }
+}
+
+bool RosbagV2Storage::passes_topic_filter(const std::string & topic) const
+{
+  return topic_filter_.empty() || topic_filter_.count(topic) > 0;
+}
+
+void RosbagV2Storage::set_filter(const std::vector<std::string> & topics)
+{
+  topic_filter_ = std::unordered_set<std::string>(topics.begin(), topics.end());
+  reset_replay();
+}
+
+void RosbagV2Storage::reset_filter()
+{
+  topic_filter_.clear();
+  reset_replay();
+}
+
+void RosbagV2Storage::seek(const rcutils_time_point_value_t & timestamp)
+{
+  replay_time_ = timestamp;
+  connections_read_at_replay_time_.clear();
+  topics_read_at_replay_time_.clear();
+  reset_replay();
 }
 
 bool RosbagV2Storage::has_next()
 {
+  if (bag_index_) {
+    return get_replay_cursor().has_next();
+  }
+  drop_skipped_view_messages();
+  if (transcode_to_cdr_) {
+    // Only messages of other connections of the same topic can be missing a converter
+    while (bag_iterator_ != bag_view_of_replayable_messages_->end() &&
+      !find_view_converter(*bag_iterator_))
+    {
+      bag_iterator_++;
+    }
+  }
   return bag_iterator_ != bag_view_of_replayable_messages_->end();
 }
 
 std::shared_ptr<rosbag2_storage::SerializedBagMessage> RosbagV2Storage::read_next()
 {
-  auto serialized_message = std::make_shared<rosbag2_storage::SerializedBagMessage>();
+  auto serialized_message = make_message();
+
+  if (bag_index_) {
+    auto bag_message = get_replay_cursor().next();
+    const auto & chunk_message = *bag_message.message;
+    const auto & replayable_connection = replayable_connections_.at(chunk_message.connection_id);
+    serialized_message->topic_name = replayable_connection.connection->topic;
+    serialized_message->time_stamp = static_cast<rcutils_time_point_value_t>(chunk_message.time);
+    record_read_message(serialized_message->time_stamp, chunk_message.connection_id);
+
+    StatisticsTimer timer;
+    if (transcode_to_cdr_) {
+      serialized_message->serialized_data = make_cdr_data(
+        *replayable_connection.converter,
+        bag_message.chunk->get_data() + chunk_message.data_offset, chunk_message.data_length);
+    } else if (options_.zero_copy) {
+      serialized_message->serialized_data = make_borrowed_message_buffer(
+        std::move(bag_message.chunk), chunk_message, replayable_connection.converter);
+      if (STATISTICS_ENABLED) {
+        ++allocations_;
+      }
+    } else {
+      auto output_stream = make_output_stream(
+        *replayable_connection.converter, chunk_message.data_length);
+      memcpy(
+        output_stream.advance(chunk_message.data_length),
+        bag_message.chunk->get_data() + chunk_message.data_offset,
+        chunk_message.data_length);
+      serialized_message->serialized_data = output_stream.get_content();
+    }
+    count_message(serialized_message->topic_name, chunk_message.data_length, timer);
+    return serialized_message;
+  }
+
+  drop_skipped_view_messages();
   auto message_instance = *bag_iterator_;
   serialized_message->topic_name = message_instance.getTopic();
   serialized_message->time_stamp = message_instance.getTime().toNSec();
-
-  auto output_stream = RosbagOutputStream(message_instance.getDataType());
+  record_read_view_message(serialized_message->time_stamp, serialized_message->topic_name);
+
+  // Includes reading the message, which rosbag_storage does on writing it
+  StatisticsTimer timer;
+  // A topic is replayed if one of its connections has a ROS 2 counterpart, not necessarily all
+  auto converter = find_view_converter(message_instance);
+  auto output_stream = converter ?
+    make_output_stream(*converter, message_instance.size()) :
+    RosbagOutputStream(message_instance.getDataType(), message_instance.size());
   message_instance.write(output_stream);
   serialized_message->serialized_data = output_stream.get_content();
+  if (transcode_to_cdr_ && converter) {
+    // The view can only write whole messages, so they are transcoded from the copy
+    auto ros1_data = output_stream.get_content();
+    serialized_message->serialized_data = make_cdr_data(
+      *converter, ros1_data->buffer + COMPACT_MESSAGE_HEADER_LENGTH,
+      ros1_data->buffer_length - COMPACT_MESSAGE_HEADER_LENGTH);
+  }
 
+  count_message(serialized_message->topic_name, message_instance.size(), timer);
   bag_iterator_++;
   return serialized_message;
 }
 
-std::vector<rosbag2_storage::TopicMetadata> RosbagV2Storage::get_all_topics_and_types()
+std::shared_ptr<rosbag2_storage::SerializedBagMessage> RosbagV2Storage::make_message()
+{
+  if (message_pool_) {
+    return message_pool_->make_message();
+  }
+  if (STATISTICS_ENABLED) {
+    ++allocations_;
+  }
+  return std::make_shared<rosbag2_storage::SerializedBagMessage>();
+}
+
+RosbagOutputStream RosbagV2Storage::make_output_stream(
+  const ConverterHandle & converter, size_t message_size)
 {
-  auto topics_with_type_including_ros1 = get_all_topics_and_types_including_ros1_topics();
+  if (message_pool_) {
+    return RosbagOutputStream(
+      converter, message_pool_->make_buffer(COMPACT_MESSAGE_HEADER_LENGTH + message_size));
+  }
+  if (STATISTICS_ENABLED) {
+    ++allocations_;
+  }
+  return RosbagOutputStream(converter, message_size);
+}
 
-  std::vector<rosbag2_storage::TopicMetadata> topics_with_type;
-  for (auto topic_with_type : topics_with_type_including_ros1) {
-    std::string ros2_type_name;
-    if (get_1to2_mapping(topic_with_type.type, ros2_type_name)) {
-      topic_with_type.type = ros2_type_name;
-      topics_with_type.push_back(std::move(topic_with_type));
+std::shared_ptr<rcutils_uint8_array_t> RosbagV2Storage::make_cdr_data(
+  const ConverterHandle & converter, const uint8_t * ros1_message, size_t ros1_message_length)
+{
+  auto cdr_data = message_pool_ ?
+    message_pool_->make_buffer(ros1_message_length) : make_uint8_array(ros1_message_length);
+  if (STATISTICS_ENABLED && !message_pool_) {
+    ++allocations_;
+  }
+  convert_to_cdr(converter, ros1_message, ros1_message_length, *cdr_data);
+  return cdr_data;
+}
+
+void RosbagV2Storage::count_message(
+  const std::string & topic, size_t size, const StatisticsTimer & timer)
+{
+  if (STATISTICS_ENABLED) {
+    auto & statistics = topic_statistics_[topic];
+    ++statistics.messages;
+    statistics.bytes += size;
+    statistics.nanoseconds += timer.get_elapsed_nanoseconds();
+  }
+}
+
+MessagePoolStatistics RosbagV2Storage::get_message_pool_statistics() const
+{
+  return message_pool_ ? message_pool_->get_statistics() : MessagePoolStatistics();
+}
+
+const ConnectionRecord * RosbagV2Storage::get_ros1_connection(const std::string & topic) const
+{
+  auto connection = ros1_connections_.find(topic);
+  return connection != ros1_connections_.end() ? &connection->second : nullptr;
+}
+
+StorageStatistics RosbagV2Storage::get_statistics() const
+{
+  StorageStatistics statistics;
+  statistics.topics.insert(topic_statistics_.begin(), topic_statistics_.end());
+  statistics.chunks = chunk_statistics_->chunks;
+  statistics.chunk_bytes = chunk_statistics_->bytes;
+  statistics.chunk_read_nanoseconds = chunk_statistics_->read_nanoseconds;
+  statistics.chunk_decrypt_nanoseconds = chunk_statistics_->decrypt_nanoseconds;
+  statistics.chunk_decompress_nanoseconds = chunk_statistics_->decompress_nanoseconds;
+  statistics.chunk_wait_nanoseconds = chunk_statistics_->wait_nanoseconds;
+  statistics.chunk_stalls = chunk_statistics_->stalls;
+  statistics.max_prefetched_chunks = chunk_statistics_->max_prefetched_chunks;
+  statistics.max_prefetched_bytes = chunk_statistics_->max_prefetched_bytes;
+  statistics.allocations = allocations_ + get_message_pool_statistics().misses;
+  return statistics;
+}
+
+size_t RosbagV2Storage::read_next_batch(
+  size_t max_messages, size_t max_bytes,
+  std::vector<std::shared_ptr<rosbag2_storage::SerializedBagMessage>> & messages)
+{
+  // Borrowed, transcoded and view messages cannot share an arena, they are batched one by one
+  if (!bag_index_ || options_.zero_copy || transcode_to_cdr_) {
+    size_t message_count = 0;
+    size_t batch_size = 0;
+    while (message_count < max_messages && batch_size < max_bytes && has_next()) {
+      messages.push_back(read_next());
+      batch_size += messages.back()->serialized_data->buffer_length;
+      ++message_count;
     }
+    return message_count;
   }
 
+  auto & message_cursor = get_replay_cursor();
+  std::vector<BagMessage> bag_messages;
+  size_t batch_size = 0;
+  while (bag_messages.size() < max_messages && batch_size < max_bytes &&
+    message_cursor.has_next())
+  {
+    bag_messages.push_back(message_cursor.next());
+    const auto & chunk_message = *bag_messages.back().message;
+    batch_size += COMPACT_MESSAGE_HEADER_LENGTH + chunk_message.data_length;
+  }
+
+  MessageBatchBuilder batch(bag_messages.size(), batch_size);
+  if (STATISTICS_ENABLED) {
+    // The arena of the batch and every message
+    allocations_ += 1 + bag_messages.size();
+  }
+  for (const auto & bag_message : bag_messages) {
+    const auto & chunk_message = *bag_message.message;
+    const auto & replayable_connection = replayable_connections_.at(chunk_message.connection_id);
+    auto time_stamp = static_cast<rcutils_time_point_value_t>(chunk_message.time);
+    record_read_message(time_stamp, chunk_message.connection_id);
+    StatisticsTimer timer;
+    auto data = batch.add_message(
+      replayable_connection.connection->topic, time_stamp,
+      *replayable_connection.converter, chunk_message.data_length);
+    memcpy(
+      data, bag_message.chunk->get_data() + chunk_message.data_offset, chunk_message.data_length);
+    count_message(replayable_connection.connection->topic, chunk_message.data_length, timer);
+  }
+  batch.append_messages_to(messages);
+  return bag_messages.size();
+}
+
+std::vector<rosbag2_storage::TopicMetadata> RosbagV2Storage::get_all_topics_and_types()
+{
+  if (options_.fast_open && bag_index_ && !metadata_) {
+    return get_replayable_topics_of_connections();
+  }
+  std::vector<rosbag2_storage::TopicMetadata> topics_with_type;
+  for (const auto & topic_information : get_cached_metadata().topics_with_message_count) {
+    topics_with_type.push_back(topic_information.topic_metadata);
+  }
   return topics_with_type;
 }
 
@@ -120,71 +680,177 @@ std::string RosbagV2Storage::get_storage_identifier() const
 
 uint64_t RosbagV2Storage::get_bagfile_size() const
 {
-  return rcutils_get_file_size(ros_v2_bag_->getFileName().c_str());
+  uint64_t size = 0;
+  for (const auto & path : bag_file_paths_) {
+    size += rcutils_get_file_size(path.c_str());
+  }
+  return size;
 }
 
 std::string RosbagV2Storage::get_relative_file_path() const
 {
-  return rcpputils::fs::path(ros_v2_bag_->getFileName()).filename().string();
+  // For split bags this is the directory or pattern, which the storage reads as a single bag
+  return rcpputils::fs::path(bag_uri_).filename().string();
 }
 
 rosbag2_storage::BagMetadata RosbagV2Storage::get_metadata()
 {
-  auto bag_view = std::make_unique<rosbag::View>(*ros_v2_bag_);
-  auto full_file_path = ros_v2_bag_->getFileName();
-  rosbag2_storage::BagMetadata metadata;
-  metadata.version = 2;
-  metadata.storage_identifier = get_storage_identifier();
-  metadata.bag_size = get_bagfile_size();
-  metadata.relative_file_paths = {get_relative_file_path()};
+  return get_cached_metadata();
+}
+
+const rosbag2_storage::BagMetadata & RosbagV2Storage::get_cached_metadata()
+{
+  if (!metadata_) {
+    metadata_ = std::make_unique<rosbag2_storage::BagMetadata>(
+      bag_index_ ? read_metadata_from_index() : read_metadata_from_view());
+  }
+  return *metadata_;
+}
+
+rosbag2_storage::BagMetadata RosbagV2Storage::read_metadata_from_index() const
+{
+  auto metadata = make_metadata_without_topics();
+
+  // A single pass over the chunk infos yields the time range and the counts of all connections
+  std::unordered_map<uint32_t, size_t> connection_message_counts;
+  uint64_t begin_time = std::numeric_limits<uint64_t>::max();
+  uint64_t end_time = 0;
+  metadata.message_count = 0;
+  for (const auto & chunk_info : bag_index_->get_chunk_infos()) {
+    begin_time = std::min(begin_time, chunk_info.start_time);
+    end_time = std::max(end_time, chunk_info.end_time);
+    for (const auto & message_count : chunk_info.message_counts) {
+      connection_message_counts[message_count.first] += message_count.second;
+      metadata.message_count += message_count.second;
+    }
+  }
+  if (metadata.message_count == 0) {
+    begin_time = end_time = 0;
+  }
+  metadata.duration = std::chrono::nanoseconds(end_time - begin_time);
+  metadata.starting_time = std::chrono::time_point<std::chrono::high_resolution_clock>(
+    std::chrono::nanoseconds(begin_time));
+
+  // Same as rosbag::View: only connections with messages, ordered by their id
+  std::vector<const ConnectionRecord *> connections;
+  for (const auto & connection : bag_index_->get_connections()) {
+    if (connection_message_counts[connection.id] > 0) {
+      connections.push_back(&connection);
+    }
+  }
+  std::sort(
+    connections.begin(), connections.end(),
+    [](const ConnectionRecord * lhs, const ConnectionRecord * rhs) {
+      return lhs->id < rhs->id;
+    });
+
+  UniqueTopicsWithType topics_with_type(options_.serialization_format);
+  std::unordered_map<std::string, size_t> topic_message_counts;
+  for (const auto & connection : connections) {
+    topic_message_counts[connection->topic] += connection_message_counts[connection->id];
+    topics_with_type.add(connection->topic, connection->datatype);
+  }
+
+  add_replayable_topics(topics_with_type.release(), topic_message_counts, metadata);
+  return metadata;
+}
+
+rosbag2_storage::BagMetadata RosbagV2Storage::read_metadata_from_view() const
+{
+  auto metadata = make_metadata_without_topics();
+
+  auto bag_view = make_view();
   metadata.duration = std::chrono::nanoseconds(
     bag_view->getEndTime().toNSec() - bag_view->getBeginTime().toNSec());
   metadata.starting_time = std::chrono::time_point<std::chrono::high_resolution_clock>(
     std::chrono::nanoseconds(bag_view->getBeginTime().toNSec()));
   metadata.message_count = bag_view->size();
-  metadata.topics_with_message_count = get_topic_information();
 
+  auto topics_with_type = get_all_topics_and_types_including_ros1_topics();
+  std::unordered_map<std::string, size_t> topic_message_counts;
+  for (const auto & topic : topics_with_type) {
+    if (topic_message_counts.count(topic.name) == 0) {
+      auto view_with_topic_query = make_view(rosbag::TopicQuery({topic.name}), ros::TIME_MIN);
+      topic_message_counts[topic.name] = view_with_topic_query->size();
+    }
+  }
+
+  add_replayable_topics(topics_with_type, topic_message_counts, metadata);
   return metadata;
 }
 
-std::vector<rosbag2_storage::TopicInformation> RosbagV2Storage::get_topic_information()
+rosbag2_storage::BagMetadata RosbagV2Storage::make_metadata_without_topics() const
 {
-  std::vector<rosbag2_storage::TopicInformation> topic_information;
-  auto topics_with_type = get_all_topics_and_types();
+  rosbag2_storage::BagMetadata metadata;
+  metadata.version = 2;
+  metadata.storage_identifier = get_storage_identifier();
+  metadata.bag_size = get_bagfile_size();
+  // A single entry, rosbag2 would otherwise open each file of a split bag on its own again
+  metadata.relative_file_paths = {get_relative_file_path()};
+  return metadata;
+}
 
-  for (const auto & topic : topics_with_type) {
-    rosbag2_storage::TopicInformation topic_info;
-    rosbag::View view_with_topic_query(*ros_v2_bag_, rosbag::TopicQuery({topic.name}));
-    topic_info.topic_metadata = topic;
-    topic_info.message_count = view_with_topic_query.size();
+std::vector<rosbag2_storage::TopicMetadata>
+RosbagV2Storage::get_replayable_topics_of_connections() const
+{
+  // Same order as the metadata. It only counts connections with messages, but rosbag writes the
+  // record of a connection along with its first message anyway.
+  std::vector<const ConnectionRecord *> connections;
+  for (const auto & connection : bag_index_->get_connections()) {
+    connections.push_back(&connection);
+  }
+  std::sort(
+    connections.begin(), connections.end(),
+    [](const ConnectionRecord * lhs, const ConnectionRecord * rhs) {
+      return lhs->id < rhs->id;
+    });
+
+  UniqueTopicsWithType topics_with_type(options_.serialization_format);
+  for (const auto & connection : connections) {
+    topics_with_type.add(connection->topic, connection->datatype);
+  }
 
-    topic_information.push_back(topic_info);
+  std::vector<rosbag2_storage::TopicMetadata> replayable_topics;
+  for (auto topic_with_type : topics_with_type.release()) {
+    auto converter = resolve_converter_handle(topic_with_type.type);
+    if (converter) {
+      topic_with_type.type = converter->ros2_type_name;
+      replayable_topics.push_back(std::move(topic_with_type));
+    }
   }
+  return replayable_topics;
+}
 
-  return topic_information;
+void RosbagV2Storage::add_replayable_topics(
+  const std::vector<rosbag2_storage::TopicMetadata> & topics_with_ros1_type,
+  const std::unordered_map<std::string, size_t> & topic_message_counts,
+  rosbag2_storage::BagMetadata & metadata) const
+{
+  for (auto topic_with_type : topics_with_ros1_type) {
+    auto converter = resolve_converter_handle(topic_with_type.type);
+    if (converter) {
+      topic_with_type.type = converter->ros2_type_name;
+
+      rosbag2_storage::TopicInformation topic_info;
+      topic_info.message_count = topic_message_counts.at(topic_with_type.name);
+      topic_info.topic_metadata = std::move(topic_with_type);
+      metadata.topics_with_message_count.push_back(std::move(topic_info));
+    }
+  }
 }
 
 std::vector<rosbag2_storage::TopicMetadata>
-RosbagV2Storage::get_all_topics_and_types_including_ros1_topics()
+RosbagV2Storage::get_all_topics_and_types_including_ros1_topics() const
 {
-  auto bag_view = std::make_unique<rosbag::View>(*ros_v2_bag_);
-  std::vector<rosbag2_storage::TopicMetadata> topics_with_type;
+  auto bag_view = make_view();
+  UniqueTopicsWithType topics_with_type(options_.serialization_format);
   auto connection_info = bag_view->getConnections();
 
   for (const auto & connection : connection_info) {
-    rosbag2_storage::TopicMetadata topic_metadata;
-    topic_metadata.name = connection->topic;
-    topic_metadata.type = connection->datatype;
-    topic_metadata.serialization_format = "rosbag_v2";
-
-    if (!vector_has_already_element<rosbag2_storage::TopicMetadata>(
-        topics_with_type, topic_metadata))
-    {
-      topics_with_type.push_back(topic_metadata);
-    }
+    topics_with_type.add(connection->topic, connection->datatype);
   }
 
-  return topics_with_type;
+  return topics_with_type.release();
 }
 
 }  // namespace rosbag2_bag_v2_plugins
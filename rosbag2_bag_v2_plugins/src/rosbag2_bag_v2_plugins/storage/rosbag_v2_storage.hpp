@@ -17,8 +17,11 @@
 
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include "rcutils/time.h"
 #include "rosbag2_storage/bag_metadata.hpp"
 #include "rosbag2_storage/storage_interfaces/read_only_interface.hpp"
 #include "rosbag2_storage/serialized_bag_message.hpp"
@@ -26,6 +29,15 @@
 #include "rosbag/bag.h"
 #include "rosbag/view.h"
 
+#include "bag_index.hpp"
+#include "bag_message_cursor.hpp"
+#include "chunk_cache.hpp"
+#include "message_pool.hpp"
+#include "rosbag_output_stream.hpp"
+#include "rosbag_v2_storage_options.hpp"
+#include "../converter_handle.hpp"
+#include "../statistics.hpp"
+
 namespace rosbag2_bag_v2_plugins
 {
 
@@ -36,12 +48,45 @@ public:
 
   ~RosbagV2Storage() override;
 
+  /// Changes the options read from the environment, only has an effect before open
+  void set_options(const RosbagV2StorageOptions & options);
+
+  const RosbagV2StorageOptions & get_options() const;
+
+  /**
+   * Opens a bag file, or a split bag given as directory or file name pattern, whose files are read
+   * as one bag, see find_split_bag_files.
+   */
   void open(const std::string & uri, rosbag2_storage::storage_interfaces::IOFlag flag) override;
 
+  /**
+   * Opens another reader of the same bag, e.g. to read other topics on another thread.
+   * The reader shares the parsed index and the resolved converters with this storage, but has its
+   * own file handle, decompression, filter and seek position, so readers do not block each other.
+   * It starts at the beginning of the bag with all topics, using the same options.
+   * Chunks are shared through the chunk cache if it is enabled, see
+   * RosbagV2StorageOptions::chunk_cache_chunks.
+   * Each reader must only be used by one thread at a time.
+   * \throws std::runtime_error if the storage has not been opened
+   */
+  std::unique_ptr<RosbagV2Storage> open_reader() const;
+
   bool has_next() override;
 
   std::shared_ptr<rosbag2_storage::SerializedBagMessage> read_next() override;
 
+  /**
+   * Reads the next messages at once, which is cheaper than reading them one by one.
+   * Copied messages share a single allocation for their data.
+   * The batch ends after max_messages messages, or after the message with which the data of the
+   * batch reaches max_bytes. Unless a limit is 0, it holds at least one message if there is any.
+   * \param messages the messages read are appended to it
+   * \returns the number of messages read
+   */
+  size_t read_next_batch(
+    size_t max_messages, size_t max_bytes,
+    std::vector<std::shared_ptr<rosbag2_storage::SerializedBagMessage>> & messages);
+
   std::vector<rosbag2_storage::TopicMetadata> get_all_topics_and_types() override;
 
   rosbag2_storage::BagMetadata get_metadata() override;
@@ -56,18 +101,130 @@ public:
    */
   std::string get_storage_identifier() const override;
 
+  /**
+   * Only messages of the given topics are read from now on, all topics if the list is empty.
+   * Reading continues after the message read last, or at the time stamp last passed to seek if no
+   * message was read since. Chunks without messages of these topics are not decompressed.
+   */
+  void set_filter(const std::vector<std::string> & topics);
+
+  /// Reads messages of all topics again, see set_filter
+  void reset_filter();
+
+  /**
+   * Continues reading at the first message with a time stamp (ns) not earlier than the given one.
+   * Chunks which end before are not decompressed. The first chunk to read is found by a binary
+   * search of the chunks sorted by time, and the chunks of the chunk cache are not decompressed
+   * again, see RosbagV2StorageOptions::chunk_cache_chunks.
+   */
+  void seek(const rcutils_time_point_value_t & timestamp);
+
+  /// Statistics of the message pool, all zero if RosbagV2StorageOptions::message_pool is off
+  MessagePoolStatistics get_message_pool_statistics() const;
+
+  /**
+   * Messages and chunks read since the bag was opened, all zero unless statistics are compiled in,
+   * see statistics.hpp. They are also logged at debug level when the storage is destroyed.
+   * Chunks are only counted for bags which are not read through rosbag_storage.
+   */
+  StorageStatistics get_statistics() const;
+
+  /**
+   * The ROS 1 connection of a topic which is read, e.g. for forwarding its messages to ROS 1 as
+   * they are, see LazyRos1Message. If a topic was recorded with several connections, this is the
+   * first one in the bag, their types are the same.
+   * \returns the connection, or nullptr if the topic is not in the bag or has no ROS 2 counterpart
+   */
+  const ConnectionRecord * get_ros1_connection(const std::string & topic) const;
+
 private:
-  template<typename T>
-  bool vector_has_already_element(std::vector<T> vector, const T & element)
+  std::vector<rosbag2_storage::TopicMetadata>
+  get_all_topics_and_types_including_ros1_topics() const;
+  const rosbag2_storage::BagMetadata & get_cached_metadata();
+  rosbag2_storage::BagMetadata read_metadata_from_index() const;
+  rosbag2_storage::BagMetadata read_metadata_from_view() const;
+  rosbag2_storage::BagMetadata make_metadata_without_topics() const;
+  /// The topics of the metadata, without reading the chunk infos for counting their messages
+  std::vector<rosbag2_storage::TopicMetadata> get_replayable_topics_of_connections() const;
+  void add_replayable_topics(
+    const std::vector<rosbag2_storage::TopicMetadata> & topics_with_ros1_type,
+    const std::unordered_map<std::string, size_t> & topic_message_counts,
+    rosbag2_storage::BagMetadata & metadata) const;
+  void open_ros_v2_bags();
+  std::unique_ptr<rosbag::View> make_view() const;
+  std::unique_ptr<rosbag::View> make_view(
+    const rosbag::TopicQuery & query, const ros::Time & start_time) const;
+  void open_replay_view();
+  void open_replay_cursor();
+  /// Falls back to a generic converter for types without a generated one, if enabled
+  const ConverterHandle * resolve_connection_converter(const ConnectionRecord & connection) const;
+  /// \returns the converter of the connection of the message, nullptr if it has none
+  const ConverterHandle * find_view_converter(
+    const rosbag::MessageInstance & message_instance) const;
+  void reset_replay_view();
+  void reset_replay_cursor();
+  BagMessageCursor & get_replay_cursor();
+  void reset_replay();
+  void drop_skipped_view_messages();
+  void record_read_message(rcutils_time_point_value_t time_stamp, uint32_t connection_id);
+  void record_read_view_message(rcutils_time_point_value_t time_stamp, const std::string & topic);
+  bool passes_topic_filter(const std::string & topic) const;
+  std::shared_ptr<rosbag2_storage::SerializedBagMessage> make_message();
+  RosbagOutputStream make_output_stream(const ConverterHandle & converter, size_t message_size);
+  std::shared_ptr<rcutils_uint8_array_t> make_cdr_data(
+    const ConverterHandle & converter, const uint8_t * ros1_message, size_t ros1_message_length);
+  void count_message(const std::string & topic, size_t size, const StatisticsTimer & timer);
+
+  struct ReplayableConnection
   {
-    return std::find(vector.begin(), vector.end(), element) != vector.end();
-  }
-  std::vector<rosbag2_storage::TopicMetadata> get_all_topics_and_types_including_ros1_topics();
-  std::vector<rosbag2_storage::TopicInformation> get_topic_information();
-
-  std::unique_ptr<rosbag::Bag> ros_v2_bag_;
+    const ConnectionRecord * connection;
+    const ConverterHandle * converter;
+  };
+
+  RosbagV2StorageOptions options_;
+  std::string bag_uri_;
+  // More than one for split bags, in the order they were split in
+  std::vector<std::string> bag_file_paths_;
+  // Computed on first use and shared by get_metadata and get_all_topics_and_types
+  std::unique_ptr<rosbag2_storage::BagMetadata> metadata_;
+  std::unique_ptr<MessagePool> message_pool_;
+
+  // Only updated if statistics are compiled in
+  std::shared_ptr<ChunkStatistics> chunk_statistics_;
+  std::unordered_map<std::string, TopicStatistics> topic_statistics_;
+  uint64_t allocations_;
+
+  // First connection of each replayable topic
+  std::unordered_map<std::string, ConnectionRecord> ros1_connections_;
+
+  std::unordered_set<std::string> topic_filter_;
+  // Reading continues at this time stamp (ns) after seeking or changing the filter, the one passed
+  // to seek or that of the message read last. The messages read with it before are skipped.
+  rcutils_time_point_value_t replay_time_;
+  std::vector<uint32_t> connections_read_at_replay_time_;
+  std::vector<std::string> topics_read_at_replay_time_;
+  // Whether messages are read in the serialization format "cdr" instead of "rosbag_v2"
+  bool transcode_to_cdr_;
+
+  // Bags in format 2.0 are replayed by reading their chunks directly
+  std::shared_ptr<const BagIndex> bag_index_;
+  std::unordered_map<uint32_t, ReplayableConnection> replayable_connections_;
+  // Created on first read after opening, seeking or changing the filter, see get_replay_cursor
+  std::unique_ptr<BagMessageCursor> message_cursor_;
+  // Chunks decompressed last, kept across seeks and filter changes and shared with other readers,
+  // nullptr unless chunk_cache_chunks is set
+  std::shared_ptr<ChunkCache> chunk_cache_;
+
+  // Other bags, e.g. ones of older format versions, are replayed through a view of the ROS 1 bags
+  std::vector<std::unique_ptr<rosbag::Bag>> ros_v2_bags_;
+  std::vector<std::string> replayable_topics_;
+  // Converters of the connections of the view by type and md5sum, as types without a generated
+  // converter get one per version of their message definition
+  std::unordered_map<std::string, const ConverterHandle *> view_converters_;
   std::unique_ptr<rosbag::View> bag_view_of_replayable_messages_;
   rosbag::View::iterator bag_iterator_;
+  // Messages at the replay time which are still to skip by topic, see reset_replay_view
+  std::unordered_map<std::string, size_t> skipped_view_message_counts_;
 };
 
 }  // namespace rosbag2_bag_v2_plugins
@@ -0,0 +1,116 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rosbag_v2_storage_options.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include "../logging.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+namespace
+{
+
+bool get_flag_from_environment(const char * name, bool default_value)
+{
+  auto value = std::getenv(name);
+  if (!value || *value == '\0') {
+    return default_value;
+  }
+  auto flag = std::string(value);
+  return flag == "1" || flag == "true" || flag == "TRUE" || flag == "True" || flag == "on";
+}
+
+std::string get_string_from_environment(const char * name, const std::string & default_value)
+{
+  auto value = std::getenv(name);
+  if (!value || *value == '\0') {
+    return default_value;
+  }
+  return value;
+}
+
+size_t get_size_from_environment(const char * name, size_t default_value)
+{
+  auto value = std::getenv(name);
+  if (!value || *value == '\0') {
+    return default_value;
+  }
+  char * end = nullptr;
+  auto size = std::strtoull(value, &end, 10);
+  if (*end != '\0' || *value == '-') {
+    ROSBAG2_BAG_V2_PLUGINS_LOG_WARN_STREAM(
+      "Ignoring " << name << "='" << value << "', which is not a non-negative number.");
+    return default_value;
+  }
+  return static_cast<size_t>(size);
+}
+
+}  // namespace
+
+RosbagV2StorageOptions RosbagV2StorageOptions::from_environment()
+{
+  RosbagV2StorageOptions options;
+  options.zero_copy = get_flag_from_environment("ROSBAG2_BAG_V2_ZERO_COPY", options.zero_copy);
+  options.index_cache = get_flag_from_environment(
+    "ROSBAG2_BAG_V2_INDEX_CACHE", options.index_cache);
+  options.index_cache_directory = get_string_from_environment(
+    "ROSBAG2_BAG_V2_INDEX_CACHE_DIR", options.index_cache_directory);
+  options.prefetch_chunks = get_size_from_environment(
+    "ROSBAG2_BAG_V2_PREFETCH_CHUNKS", options.prefetch_chunks);
+  options.prefetch_max_bytes = get_size_from_environment(
+    "ROSBAG2_BAG_V2_PREFETCH_MAX_BYTES", options.prefetch_max_bytes);
+  options.prefetch_threads = get_size_from_environment(
+    "ROSBAG2_BAG_V2_PREFETCH_THREADS", options.prefetch_threads);
+  options.bulk_read = get_flag_from_environment("ROSBAG2_BAG_V2_BULK_READ", options.bulk_read);
+  options.message_pool = get_flag_from_environment(
+    "ROSBAG2_BAG_V2_MESSAGE_POOL", options.message_pool);
+  options.message_pool_max_bytes = get_size_from_environment(
+    "ROSBAG2_BAG_V2_MESSAGE_POOL_MAX_BYTES", options.message_pool_max_bytes);
+  options.serialization_format = get_string_from_environment(
+    "ROSBAG2_BAG_V2_SERIALIZATION_FORMAT", options.serialization_format);
+  options.memory_map = get_flag_from_environment("ROSBAG2_BAG_V2_MEMORY_MAP", options.memory_map);
+  options.chunk_cache_chunks = get_size_from_environment(
+    "ROSBAG2_BAG_V2_CHUNK_CACHE_CHUNKS", options.chunk_cache_chunks);
+  options.chunk_cache_bytes = get_size_from_environment(
+    "ROSBAG2_BAG_V2_CHUNK_CACHE_BYTES", options.chunk_cache_bytes);
+  options.generic_conversion = get_flag_from_environment(
+    "ROSBAG2_BAG_V2_GENERIC_CONVERSION", options.generic_conversion);
+  options.fast_open = get_flag_from_environment("ROSBAG2_BAG_V2_FAST_OPEN", options.fast_open);
+  return options;
+}
+
+size_t RosbagV2StorageOptions::get_effective_prefetch_chunks() const
+{
+  if (!bulk_read) {
+    return prefetch_chunks;
+  }
+  return std::max(prefetch_chunks, 2 * get_effective_prefetch_threads());
+}
+
+size_t RosbagV2StorageOptions::get_effective_prefetch_threads() const
+{
+  if (!bulk_read) {
+    return prefetch_threads;
+  }
+  // hardware_concurrency may not know the number of cores and return 0
+  return std::max<size_t>({prefetch_threads, std::thread::hardware_concurrency(), 1});
+}
+
+}  // namespace rosbag2_bag_v2_plugins
@@ -0,0 +1,137 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROSBAG2_BAG_V2_PLUGINS__STORAGE__ROSBAG_V2_STORAGE_OPTIONS_HPP_
+#define ROSBAG2_BAG_V2_PLUGINS__STORAGE__ROSBAG_V2_STORAGE_OPTIONS_HPP_
+
+#include <cstddef>
+#include <string>
+
+namespace rosbag2_bag_v2_plugins
+{
+
+/**
+ * Tuning options of the rosbag_v2 storage plugin.
+ * As the plugin is usually loaded by rosbag2 itself, the options are read from the environment
+ * when the storage is created. They can be changed with RosbagV2Storage::set_options before open.
+ */
+struct RosbagV2StorageOptions
+{
+  /**
+   * Messages point into the decompressed chunk instead of being copied (ROSBAG2_BAG_V2_ZERO_COPY).
+   * The data of such messages does not carry the type prefix, so it can only be read by the
+   * rosbag_v2 converter of the same process. Each message keeps its chunk in memory.
+   */
+  bool zero_copy = false;
+
+  /**
+   * The index of the bag is stored in a sidecar file and reused when the bag is opened again
+   * without having changed in size or modification time (ROSBAG2_BAG_V2_INDEX_CACHE).
+   */
+  bool index_cache = false;
+
+  /**
+   * Directory of the index cache files (ROSBAG2_BAG_V2_INDEX_CACHE_DIR).
+   * If empty, the cache is written next to the bag.
+   */
+  std::string index_cache_directory;
+
+  /**
+   * Number of chunks decompressed ahead on background threads at most
+   * (ROSBAG2_BAG_V2_PREFETCH_CHUNKS). 0 decompresses each chunk when its first message is read,
+   * which stalls the reader. Chunks of encrypted bags are prefetched nevertheless, one more than
+   * there are prefetch threads. Fewer chunks are decompressed ahead as long as the reader does not
+   * have to wait for them, see ChunkPrefetcher.
+   */
+  size_t prefetch_chunks = 0;
+
+  /**
+   * Size of the chunks decompressed ahead at most (ROSBAG2_BAG_V2_PREFETCH_MAX_BYTES), 0 for no
+   * limit. A single chunk is decompressed ahead however large it is.
+   */
+  size_t prefetch_max_bytes = 0;
+
+  /// Number of threads decompressing chunks ahead (ROSBAG2_BAG_V2_PREFETCH_THREADS)
+  size_t prefetch_threads = 1;
+
+  /**
+   * Decompresses chunks on all cores, for converting whole bags as fast as possible
+   * (ROSBAG2_BAG_V2_BULK_READ). Raises prefetch_threads to the number of cores and prefetch_chunks
+   * to twice the number of threads, so that every thread always has a chunk to work on.
+   */
+  bool bulk_read = false;
+
+  /**
+   * Messages read are allocated from a pool which recycles their memory once they are released
+   * (ROSBAG2_BAG_V2_MESSAGE_POOL). See RosbagV2Storage::get_message_pool_statistics for sizing it.
+   */
+  bool message_pool = false;
+
+  /// Released memory the pool keeps for reuse at most (ROSBAG2_BAG_V2_MESSAGE_POOL_MAX_BYTES)
+  size_t message_pool_max_bytes = 64 * 1024 * 1024;
+
+  /**
+   * Serialization format of the messages read (ROSBAG2_BAG_V2_SERIALIZATION_FORMAT).
+   * "rosbag_v2" passes on the ROS 1 messages, which the rosbag_v2 converter plugin converts.
+   * "cdr" transcodes them into CDR right away, so that rosbag2 can publish them without
+   * converting them. Most common message types are transcoded without deserializing them.
+   */
+  std::string serialization_format = "rosbag_v2";
+
+  /**
+   * Bag files are memory mapped and parsed in place instead of being read into buffers
+   * (ROSBAG2_BAG_V2_MEMORY_MAP). Uncompressed chunks are then not copied at all, which together
+   * with zero_copy replays bags on fast local disks at the speed of the page cache.
+   */
+  bool memory_map = false;
+
+  /**
+   * Number of the chunks decompressed last which are kept in memory
+   * (ROSBAG2_BAG_V2_CHUNK_CACHE_CHUNKS). Seeking back into them, e.g. when scrubbing through a
+   * bag, or reading them for other topics does not decompress them again. The cache is shared by
+   * the readers opened with RosbagV2Storage::open_reader.
+   */
+  size_t chunk_cache_chunks = 0;
+
+  /// Size of the decompressed chunks kept in memory at most (ROSBAG2_BAG_V2_CHUNK_CACHE_BYTES)
+  size_t chunk_cache_bytes = 256 * 1024 * 1024;
+
+  /**
+   * Messages of types without a generated converter are converted by the message definition
+   * stored in the bag, if there is a ROS 2 type of the same name
+   * (ROSBAG2_BAG_V2_GENERIC_CONVERSION). Fields are matched by name, see GenericConverter.
+   */
+  bool generic_conversion = true;
+
+  /**
+   * Only the bag header and the connections are read on open (ROSBAG2_BAG_V2_FAST_OPEN), the
+   * chunk infos of the index are read once the first message is read or the metadata is needed.
+   * Opening a bag to list its topics or connections then reads a fraction of the index, e.g. from
+   * network storage. Has no effect with index_cache, whose cache files are read quickly anyway.
+   */
+  bool fast_open = false;
+
+  /// prefetch_chunks, raised as needed for bulk_read
+  size_t get_effective_prefetch_chunks() const;
+
+  /// prefetch_threads, raised as needed for bulk_read
+  size_t get_effective_prefetch_threads() const;
+
+  /// Reads the options from ROSBAG2_BAG_V2_* environment variables, e.g. ROSBAG2_BAG_V2_ZERO_COPY=1
+  static RosbagV2StorageOptions from_environment();
+};
+
+}  // namespace rosbag2_bag_v2_plugins
+
+#endif  // ROSBAG2_BAG_V2_PLUGINS__STORAGE__ROSBAG_V2_STORAGE_OPTIONS_HPP_
@@ -0,0 +1,227 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "split_bag.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rcpputils/filesystem_helper.hpp"
+#include "rcutils/filesystem.h"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+namespace
+{
+
+constexpr const char BAG_FILE_EXTENSION[] = ".bag";
+
+std::vector<std::string> list_directory(const std::string & directory)
+{
+  std::vector<std::string> names;
+#ifdef _WIN32
+  WIN32_FIND_DATAA entry;
+  auto handle = FindFirstFileA((directory + "\\*").c_str(), &entry);
+  if (handle == INVALID_HANDLE_VALUE) {
+    throw std::runtime_error("Could not list directory '" + directory + "'");
+  }
+  do {
+    names.emplace_back(entry.cFileName);
+  } while (FindNextFileA(handle, &entry));
+  FindClose(handle);
+#else
+  auto dir = opendir(directory.c_str());
+  if (!dir) {
+    throw std::runtime_error("Could not list directory '" + directory + "'");
+  }
+  while (auto entry = readdir(dir)) {
+    names.emplace_back(entry->d_name);
+  }
+  closedir(dir);
+#endif
+  return names;
+}
+
+bool ends_with(const std::string & value, const std::string & suffix)
+{
+  return value.size() >= suffix.size() &&
+         value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool has_wildcards(const std::string & name)
+{
+  return name.find_first_of("*?") != std::string::npos;
+}
+
+bool matches_wildcards(const std::string & name, const std::string & pattern)
+{
+  // Backtracks to the last '*' only, which suffices as '*' matches any sequence
+  size_t name_position = 0;
+  size_t pattern_position = 0;
+  size_t star_position = std::string::npos;
+  size_t star_name_position = 0;
+  while (name_position < name.size()) {
+    if (pattern_position < pattern.size() &&
+      (pattern[pattern_position] == '?' || pattern[pattern_position] == name[name_position]))
+    {
+      ++name_position;
+      ++pattern_position;
+    } else if (pattern_position < pattern.size() && pattern[pattern_position] == '*') {
+      star_position = pattern_position++;
+      star_name_position = name_position;
+    } else if (star_position != std::string::npos) {
+      pattern_position = star_position + 1;
+      name_position = ++star_name_position;
+    } else {
+      return false;
+    }
+  }
+  while (pattern_position < pattern.size() && pattern[pattern_position] == '*') {
+    ++pattern_position;
+  }
+  return pattern_position == pattern.size();
+}
+
+std::vector<std::string> find_files(
+  const std::string & directory, const std::function<bool(const std::string &)> & matches)
+{
+  std::vector<std::string> names;
+  for (const auto & name : list_directory(directory)) {
+    auto path = (rcpputils::fs::path(directory) / name).string();
+    if (matches(name) && rcutils_is_file(path.c_str())) {
+      names.push_back(name);
+    }
+  }
+  std::sort(names.begin(), names.end(), &compare_split_bag_file_names);
+
+  std::vector<std::string> paths;
+  for (const auto & name : names) {
+    paths.push_back((rcpputils::fs::path(directory) / name).string());
+  }
+  return paths;
+}
+
+}  // namespace
+
+std::vector<std::string> find_split_bag_files(const std::string & uri)
+{
+  std::vector<std::string> paths;
+  if (rcutils_is_directory(uri.c_str())) {
+    paths = find_files(
+      uri, [](const std::string & name) {
+        return ends_with(name, BAG_FILE_EXTENSION);
+      });
+  } else {
+    rcpputils::fs::path path(uri);
+    auto pattern = path.filename().string();
+    if (!has_wildcards(pattern)) {
+      return {uri};
+    }
+    auto directory = path.parent_path().string();
+    paths = find_files(
+      directory.empty() ? "." : directory, [&pattern](const std::string & name) {
+        return matches_wildcards(name, pattern);
+      });
+  }
+
+  if (paths.empty()) {
+    throw std::runtime_error("No bag files found at '" + uri + "'");
+  }
+  return paths;
+}
+
+bool compare_split_bag_file_names(const std::string & lhs, const std::string & rhs)
+{
+  size_t lhs_position = 0;
+  size_t rhs_position = 0;
+  while (lhs_position < lhs.size() && rhs_position < rhs.size()) {
+    if (std::isdigit(static_cast<unsigned char>(lhs[lhs_position])) &&
+      std::isdigit(static_cast<unsigned char>(rhs[rhs_position])))
+    {
+      auto lhs_end = lhs.find_first_not_of("0123456789", lhs_position);
+      auto rhs_end = rhs.find_first_not_of("0123456789", rhs_position);
+      auto lhs_number = lhs.substr(lhs_position, lhs_end - lhs_position);
+      auto rhs_number = rhs.substr(rhs_position, rhs_end - rhs_position);
+      // Without leading zeros, the longer number is the larger one
+      lhs_number.erase(0, std::min(lhs_number.find_first_not_of('0'), lhs_number.size() - 1));
+      rhs_number.erase(0, std::min(rhs_number.find_first_not_of('0'), rhs_number.size() - 1));
+      if (lhs_number.size() != rhs_number.size()) {
+        return lhs_number.size() < rhs_number.size();
+      }
+      if (lhs_number != rhs_number) {
+        return lhs_number < rhs_number;
+      }
+      lhs_position = lhs_end == std::string::npos ? lhs.size() : lhs_end;
+      rhs_position = rhs_end == std::string::npos ? rhs.size() : rhs_end;
+    } else {
+      if (lhs[lhs_position] != rhs[rhs_position]) {
+        return lhs[lhs_position] < rhs[rhs_position];
+      }
+      ++lhs_position;
+      ++rhs_position;
+    }
+  }
+  if ((lhs.size() - lhs_position) != (rhs.size() - rhs_position)) {
+    return lhs.size() - lhs_position < rhs.size() - rhs_position;
+  }
+  // Names which only differ in leading zeros
+  return lhs < rhs;
+}
+
+std::shared_ptr<const BagIndex> read_split_bag_index(
+  const std::vector<std::string> & file_paths,
+  const std::function<std::shared_ptr<const BagIndex>(const std::string &)> & read_index)
+{
+  if (file_paths.size() == 1) {
+    return read_index(file_paths.front());
+  }
+
+  // Reading an index is mostly waiting for the disk, the files are read a few at a time
+  size_t parallel_reads = std::max<size_t>(std::thread::hardware_concurrency(), 2);
+  std::vector<std::shared_ptr<const BagIndex>> indexes;
+  indexes.reserve(file_paths.size());
+  for (size_t first = 0; first < file_paths.size(); first += parallel_reads) {
+    std::vector<std::future<std::shared_ptr<const BagIndex>>> reads;
+    auto last = std::min(first + parallel_reads, file_paths.size());
+    for (size_t i = first; i < last; ++i) {
+      reads.push_back(std::async(std::launch::async, read_index, std::cref(file_paths[i])));
+    }
+    for (auto & read : reads) {
+      indexes.push_back(read.get());
+    }
+  }
+
+  for (const auto & index : indexes) {
+    if (!index) {
+      return nullptr;
+    }
+  }
+  return BagIndex::merge(indexes);
+}
+
+}  // namespace rosbag2_bag_v2_plugins
@@ -0,0 +1,52 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef ROSBAG2_BAG_V2_PLUGINS__STORAGE__SPLIT_BAG_HPP_
+#define ROSBAG2_BAG_V2_PLUGINS__STORAGE__SPLIT_BAG_HPP_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bag_index.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+/**
+ * The bag files a URI refers to. This is the file itself, all .bag files of a directory, or the
+ * files matching a file name with the wildcards '*' and '?', e.g. "/logs/run_*.bag".
+ * Several files are sorted by compare_split_bag_file_names, which is the order they were split in.
+ * \throws std::runtime_error if a directory or pattern matches no bag file
+ */
+std::vector<std::string> find_split_bag_files(const std::string & uri);
+
+/// Orders names like strings, except that numbers are compared by value, so "_2" is before "_10"
+bool compare_split_bag_file_names(const std::string & lhs, const std::string & rhs);
+
+/**
+ * Reads the indexes of the files of a split bag at the same time and merges them, see
+ * BagIndex::merge.
+ * \param read_index reads the index of one file, e.g. BagIndex::read
+ * \returns nullptr if the plugin cannot read one of the files itself
+ */
+std::shared_ptr<const BagIndex> read_split_bag_index(
+  const std::vector<std::string> & file_paths,
+  const std::function<std::shared_ptr<const BagIndex>(const std::string &)> & read_index);
+
+}  // namespace rosbag2_bag_v2_plugins
+
+#endif  // ROSBAG2_BAG_V2_PLUGINS__STORAGE__SPLIT_BAG_HPP_
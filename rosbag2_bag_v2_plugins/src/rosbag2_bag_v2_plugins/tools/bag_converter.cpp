@@ -0,0 +1,213 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "bag_converter.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "rosbag2_storage/serialized_bag_message.hpp"
+#include "rosbag2_storage/topic_metadata.hpp"
+
+#include "../converter_handle.hpp"
+#include "../lazy_ros1_message.hpp"
+#include "../storage/rosbag_output_stream.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+BagConverter::BagConverter(std::shared_ptr<RosbagV2Storage> input, const Options & options)
+: input_(std::move(input)),
+  batch_messages_(std::max<size_t>(options.batch_messages, 1)),
+  batch_bytes_(options.batch_bytes),
+  stopped_(false),
+  end_of_input_(false),
+  next_batch_(0)
+{
+  if (input_->get_options().serialization_format != "rosbag_v2") {
+    throw std::runtime_error("Cannot convert messages which are not read as rosbag_v2 messages");
+  }
+  // hardware_concurrency may not know the number of cores and return 0
+  thread_count_ = options.conversion_threads > 0 ?
+    options.conversion_threads : std::max<size_t>(std::thread::hardware_concurrency(), 1);
+  read_ahead_ = options.read_ahead > 0 ? options.read_ahead : 2 * thread_count_;
+}
+
+BagConverter::~BagConverter()
+{
+  stop();
+}
+
+std::vector<rosbag2_storage::TopicMetadata> BagConverter::get_output_topics() const
+{
+  auto topics = input_->get_all_topics_and_types();
+  for (auto & topic : topics) {
+    topic.serialization_format = "cdr";
+  }
+  return topics;
+}
+
+ConversionProgress BagConverter::convert(
+  const WriteFunction & write,
+  const ProgressFunction & progress,
+  std::chrono::milliseconds progress_interval)
+{
+  if (!threads_.empty()) {
+    throw std::runtime_error("Cannot convert a bag twice");
+  }
+
+  ConversionProgress current_progress;
+  current_progress.total_messages = input_->get_metadata().message_count;
+  auto start = std::chrono::steady_clock::now();
+  auto next_report = start + progress_interval;
+
+  for (size_t i = 0; i < thread_count_; ++i) {
+    threads_.emplace_back(&BagConverter::convert_batches, this);
+  }
+  try {
+    while (true) {
+      PendingBatch batch;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        batch_done_.wait(
+          lock, [this]() {
+            return !pending_batches_.empty() && pending_batches_.front().done;
+          });
+        batch = std::move(pending_batches_.front());
+        pending_batches_.pop_front();
+        ++next_batch_;
+      }
+      batch_taken_.notify_all();
+
+      if (batch.error) {
+        std::rethrow_exception(batch.error);
+      }
+      if (batch.end) {
+        break;
+      }
+
+      for (auto & message : batch.messages) {
+        current_progress.bytes_written += message->serialized_data->buffer_length;
+        write(std::move(message));
+      }
+      current_progress.messages += batch.messages.size();
+      current_progress.bytes_read += batch.bytes_read;
+
+      auto now = std::chrono::steady_clock::now();
+      if (progress && now >= next_report) {
+        current_progress.elapsed = now - start;
+        progress(current_progress);
+        next_report = now + progress_interval;
+      }
+    }
+  } catch (...) {
+    stop();
+    throw;
+  }
+  stop();
+
+  current_progress.elapsed = std::chrono::steady_clock::now() - start;
+  if (progress) {
+    progress(current_progress);
+  }
+  return current_progress;
+}
+
+void BagConverter::convert_batches()
+{
+  while (true) {
+    std::unique_lock<std::mutex> read_lock(read_mutex_);
+    size_t batch_index;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      batch_taken_.wait(
+        lock, [this]() {
+          return stopped_ || end_of_input_ || pending_batches_.size() < read_ahead_;
+        });
+      if (stopped_ || end_of_input_) {
+        return;
+      }
+      batch_index = next_batch_ + pending_batches_.size();
+      pending_batches_.emplace_back();
+    }
+
+    PendingBatch batch;
+    try {
+      input_->read_next_batch(batch_messages_, batch_bytes_, batch.messages);
+    } catch (const std::exception &) {
+      batch.error = std::current_exception();
+    }
+    batch.end = batch.messages.empty();
+    if (batch.end) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      end_of_input_ = true;
+    }
+    read_lock.unlock();
+
+    if (!batch.error && !batch.end) {
+      try {
+        convert_batch(batch);
+      } catch (const std::exception &) {
+        batch.error = std::current_exception();
+      }
+    }
+    batch.done = true;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Batches are only taken once done, so the claimed one is still pending
+    pending_batches_[batch_index - next_batch_] = std::move(batch);
+    batch_done_.notify_all();
+  }
+}
+
+void BagConverter::convert_batch(PendingBatch & batch)
+{
+  for (auto & message : batch.messages) {
+    LazyRos1Message ros1_message(message);
+    auto cdr_data = make_uint8_array(ros1_message.get_ros1_data_length());
+    convert_to_cdr(
+      ros1_message.get_converter(), ros1_message.get_ros1_data(),
+      ros1_message.get_ros1_data_length(), *cdr_data);
+    batch.bytes_read += ros1_message.get_ros1_data_length();
+
+    // Replaces the message instead of its data, as it may be borrowed from the storage
+    auto cdr_message = std::make_shared<rosbag2_storage::SerializedBagMessage>();
+    cdr_message->topic_name = message->topic_name;
+    cdr_message->time_stamp = message->time_stamp;
+    cdr_message->serialized_data = std::move(cdr_data);
+    message = std::move(cdr_message);
+  }
+}
+
+void BagConverter::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+  }
+  batch_taken_.notify_all();
+  for (auto & thread : threads_) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+}
+
+}  // namespace rosbag2_bag_v2_plugins
@@ -0,0 +1,139 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef ROSBAG2_BAG_V2_PLUGINS__TOOLS__BAG_CONVERTER_HPP_
+#define ROSBAG2_BAG_V2_PLUGINS__TOOLS__BAG_CONVERTER_HPP_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "rosbag2_storage/serialized_bag_message.hpp"
+#include "rosbag2_storage/topic_metadata.hpp"
+
+#include "../storage/rosbag_v2_storage.hpp"
+
+namespace rosbag2_bag_v2_plugins
+{
+
+struct ConversionProgress
+{
+  uint64_t messages = 0;
+  /// Messages in the bag which can be converted, see RosbagV2Storage::get_metadata
+  uint64_t total_messages = 0;
+  /// Serialized ROS 1 messages read
+  uint64_t bytes_read = 0;
+  /// CDR messages written
+  uint64_t bytes_written = 0;
+  std::chrono::nanoseconds elapsed{0};
+};
+
+/**
+ * Converts all messages of a ROS 1 bag into CDR messages, e.g. for writing them to a ROS 2 bag.
+ *
+ * The conversion is pipelined: the storage decompresses its chunks on its prefetch threads, a
+ * pool of threads takes turns reading batches of messages from it and converts each batch on its
+ * own, and the thread calling convert writes the converted messages in the order of the bag.
+ */
+class BagConverter
+{
+public:
+  struct Options
+  {
+    /// Threads converting batches, all cores if 0
+    size_t conversion_threads = 0;
+    size_t batch_messages = 1024;
+    size_t batch_bytes = 4 * 1024 * 1024;
+    /// Converted batches waiting to be written at most, twice the number of threads if 0
+    size_t read_ahead = 0;
+  };
+
+  using WriteFunction =
+    std::function<void (std::shared_ptr<rosbag2_storage::SerializedBagMessage>)>;
+  using ProgressFunction = std::function<void (const ConversionProgress &)>;
+
+  /**
+   * \param input an opened storage reading rosbag_v2 messages, preferably with zero_copy and
+   * bulk_read set in its options. It must not be used by anybody else while converting.
+   * \throws std::runtime_error if the storage transcodes to CDR itself
+   */
+  BagConverter(std::shared_ptr<RosbagV2Storage> input, const Options & options);
+
+  ~BagConverter();
+
+  BagConverter(const BagConverter &) = delete;
+  BagConverter & operator=(const BagConverter &) = delete;
+
+  /// Topics of the converted messages, to be created in the output before converting
+  std::vector<rosbag2_storage::TopicMetadata> get_output_topics() const;
+
+  /**
+   * Converts all messages and passes them to write, one after the other in the order of the bag.
+   * \param progress is called about every progress_interval and once at the end, on this thread
+   * \returns the final progress
+   * \throws std::runtime_error if a message cannot be read or converted, or whatever write throws
+   */
+  ConversionProgress convert(
+    const WriteFunction & write,
+    const ProgressFunction & progress = nullptr,
+    std::chrono::milliseconds progress_interval = std::chrono::seconds(1));
+
+private:
+  struct PendingBatch
+  {
+    bool done = false;
+    /// No message was left to read
+    bool end = false;
+    std::vector<std::shared_ptr<rosbag2_storage::SerializedBagMessage>> messages;
+    uint64_t bytes_read = 0;
+    std::exception_ptr error;
+  };
+
+  void convert_batches();
+  void stop();
+  static void convert_batch(PendingBatch & batch);
+
+  std::shared_ptr<RosbagV2Storage> input_;
+  size_t thread_count_;
+  size_t batch_messages_;
+  size_t batch_bytes_;
+  size_t read_ahead_;
+
+  // Serializes reading from the input, which is held while claiming the next batch so that the
+  // batches are claimed in the order they are read
+  std::mutex read_mutex_;
+  std::mutex mutex_;
+  std::condition_variable batch_done_;
+  std::condition_variable batch_taken_;
+  bool stopped_;
+  bool end_of_input_;
+  /// Index of the batch written next, which is the front of pending_batches_
+  size_t next_batch_;
+  /// Batches being converted or waiting to be written, in the order they were read
+  std::deque<PendingBatch> pending_batches_;
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace rosbag2_bag_v2_plugins
+
+#endif  // ROSBAG2_BAG_V2_PLUGINS__TOOLS__BAG_CONVERTER_HPP_
@@ -0,0 +1,155 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Converts ROS 1 bags into ROS 2 bags of any storage plugin, see the README
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "rosbag2_cpp/converter_options.hpp"
+#include "rosbag2_cpp/storage_options.hpp"
+#include "rosbag2_cpp/writer.hpp"
+#include "rosbag2_storage/serialized_bag_message.hpp"
+
+#include "bag_converter.hpp"
+#include "../storage/rosbag_v2_storage.hpp"
+#include "../storage/rosbag_v2_storage_options.hpp"
+
+namespace
+{
+
+const char USAGE[] =
+  "Usage: rosbag2_bag_v2_convert [options] <ROS 1 bag> <ROS 2 bag>\n"
+  "Converts a ROS 1 bag, or a split bag given as directory or file name pattern, into a ROS 2\n"
+  "bag of CDR messages.\n"
+  "\n"
+  "Options:\n"
+  "  --storage-id <id>             Storage plugin of the ROS 2 bag, sqlite3 by default\n"
+  "  --max-bagfile-size <bytes>    Splits the ROS 2 bag into files of about this size\n"
+  "  --threads <n>                 Threads converting messages, all cores by default\n"
+  "  --batch-messages <n>          Messages converted at once by a thread, 1024 by default\n"
+  "\n"
+  "The ROSBAG2_BAG_V2_* environment variables of the storage plugin apply to reading.\n";
+
+struct Arguments
+{
+  std::string input_uri;
+  rosbag2_cpp::StorageOptions output_options;
+  rosbag2_bag_v2_plugins::BagConverter::Options converter_options;
+};
+
+uint64_t parse_number(const std::string & option, const char * value)
+{
+  char * end = nullptr;
+  auto number = std::strtoull(value, &end, 10);
+  if (*value == '\0' || *end != '\0' || *value == '-') {
+    throw std::invalid_argument(option + " expects a non-negative number, not '" + value + "'");
+  }
+  return number;
+}
+
+Arguments parse_arguments(int argc, char ** argv)
+{
+  Arguments arguments;
+  arguments.output_options.storage_id = "sqlite3";
+  std::string * positional[] = {&arguments.input_uri, &arguments.output_options.uri};
+  size_t positional_count = 0;
+  for (int i = 1; i < argc; ++i) {
+    std::string argument = argv[i];
+    if (argument.compare(0, 2, "--") != 0) {
+      if (positional_count == 2) {
+        throw std::invalid_argument("Unexpected argument '" + argument + "'");
+      }
+      *positional[positional_count++] = argument;
+      continue;
+    }
+    if (i + 1 == argc) {
+      throw std::invalid_argument("Missing value of " + argument);
+    }
+    const char * value = argv[++i];
+    if (argument == "--storage-id") {
+      arguments.output_options.storage_id = value;
+    } else if (argument == "--max-bagfile-size") {
+      arguments.output_options.max_bagfile_size = parse_number(argument, value);
+    } else if (argument == "--threads") {
+      arguments.converter_options.conversion_threads = parse_number(argument, value);
+    } else if (argument == "--batch-messages") {
+      arguments.converter_options.batch_messages = parse_number(argument, value);
+    } else {
+      throw std::invalid_argument("Unknown option " + argument);
+    }
+  }
+  if (positional_count != 2) {
+    throw std::invalid_argument("Expected a ROS 1 bag and a ROS 2 bag");
+  }
+  return arguments;
+}
+
+void print_progress(const rosbag2_bag_v2_plugins::ConversionProgress & progress)
+{
+  auto seconds = std::chrono::duration<double>(progress.elapsed).count();
+  auto mebibytes_read = static_cast<double>(progress.bytes_read) / (1024 * 1024);
+  std::cout << std::fixed << std::setprecision(1) << "Converted " << progress.messages << " of " <<
+    progress.total_messages << " messages (" << mebibytes_read << " MiB) in " << seconds <<
+    " s, " << (seconds > 0 ? progress.messages / seconds : 0) << " messages/s, " <<
+    (seconds > 0 ? mebibytes_read / seconds : 0) << " MiB/s" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char ** argv)
+{
+  Arguments arguments;
+  try {
+    arguments = parse_arguments(argc, argv);
+  } catch (const std::invalid_argument & e) {
+    std::cerr << e.what() << "\n\n" << USAGE;
+    return 2;
+  }
+
+  try {
+    // Messages are taken from the chunks as they are and converted on the converter's threads
+    auto input_options = rosbag2_bag_v2_plugins::RosbagV2StorageOptions::from_environment();
+    input_options.serialization_format = "rosbag_v2";
+    input_options.zero_copy = true;
+    input_options.bulk_read = true;
+    auto input = std::make_shared<rosbag2_bag_v2_plugins::RosbagV2Storage>();
+    input->set_options(input_options);
+    input->open(arguments.input_uri, rosbag2_storage::storage_interfaces::IOFlag::READ_ONLY);
+
+    rosbag2_bag_v2_plugins::BagConverter converter(input, arguments.converter_options);
+    rosbag2_cpp::Writer writer;
+    writer.open(arguments.output_options, {"cdr", "cdr"});
+    for (const auto & topic : converter.get_output_topics()) {
+      writer.create_topic(topic);
+    }
+
+    converter.convert(
+      [&writer](std::shared_ptr<rosbag2_storage::SerializedBagMessage> message) {
+        writer.write(std::move(message));
+      }, &print_progress);
+  } catch (const std::exception & e) {
+    std::cerr << "Failed to convert '" << arguments.input_uri << "': " << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
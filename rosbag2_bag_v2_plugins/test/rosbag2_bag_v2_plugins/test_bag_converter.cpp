@@ -0,0 +1,136 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <gmock/gmock.h>
+
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "rcpputils/filesystem_helper.hpp"
+#include "rosbag2_storage/serialized_bag_message.hpp"
+#include "rosbag_v2_storage_test_fixture.hpp"
+#include "../../src/rosbag2_bag_v2_plugins/tools/bag_converter.hpp"
+
+using namespace ::testing;  // NOLINT
+using rosbag2_bag_v2_plugins::BagConverter;
+
+namespace
+{
+
+std::shared_ptr<rosbag2_bag_v2_plugins::RosbagV2Storage> open_storage(
+  const std::string & bag_path, const std::string & serialization_format)
+{
+  rosbag2_bag_v2_plugins::RosbagV2StorageOptions options;
+  options.zero_copy = serialization_format == "rosbag_v2";
+  options.serialization_format = serialization_format;
+  auto storage = std::make_shared<rosbag2_bag_v2_plugins::RosbagV2Storage>();
+  storage->set_options(options);
+  storage->open(bag_path, rosbag2_storage::storage_interfaces::IOFlag::READ_ONLY);
+  return storage;
+}
+
+std::vector<std::shared_ptr<rosbag2_storage::SerializedBagMessage>> convert(
+  const std::string & bag_path, const BagConverter::Options & options)
+{
+  BagConverter converter(open_storage(bag_path, "rosbag_v2"), options);
+  std::vector<std::shared_ptr<rosbag2_storage::SerializedBagMessage>> messages;
+  converter.convert(
+    [&messages](std::shared_ptr<rosbag2_storage::SerializedBagMessage> message) {
+      messages.push_back(message);
+    });
+  return messages;
+}
+
+}  // namespace
+
+TEST_F(RosbagV2StorageTestFixture, converted_messages_equal_the_transcoded_messages_in_order)
+{
+  bag_path_ = (rcpputils::fs::path(database_path_) / "test_bag_multiple_connections.bag").string();
+  BagConverter::Options options;
+  // Every message in a batch of its own, so that the threads finish batches out of order
+  options.conversion_threads = 4;
+  options.batch_messages = 1;
+
+  auto converted_messages = convert(bag_path_, options);
+
+  auto cdr_storage = open_storage(bag_path_, "cdr");
+  size_t i = 0;
+  while (cdr_storage->has_next()) {
+    auto cdr_message = cdr_storage->read_next();
+    ASSERT_THAT(i, Lt(converted_messages.size()));
+    const auto & converted_message = *converted_messages[i++];
+    EXPECT_THAT(converted_message.topic_name, StrEq(cdr_message->topic_name));
+    EXPECT_THAT(converted_message.time_stamp, Eq(cdr_message->time_stamp));
+    ASSERT_THAT(
+      converted_message.serialized_data->buffer_length,
+      Eq(cdr_message->serialized_data->buffer_length));
+    EXPECT_THAT(
+      memcmp(
+        converted_message.serialized_data->buffer, cdr_message->serialized_data->buffer,
+        cdr_message->serialized_data->buffer_length), Eq(0));
+  }
+  EXPECT_THAT(converted_messages, SizeIs(i));
+}
+
+TEST_F(RosbagV2StorageTestFixture, conversion_reports_the_progress_at_the_end)
+{
+  BagConverter converter(open_storage(bag_path_, "rosbag_v2"), BagConverter::Options());
+  std::vector<rosbag2_bag_v2_plugins::ConversionProgress> reports;
+
+  auto progress = converter.convert(
+    [](std::shared_ptr<rosbag2_storage::SerializedBagMessage>) {},
+    [&reports](const rosbag2_bag_v2_plugins::ConversionProgress & progress) {
+      reports.push_back(progress);
+    });
+
+  ASSERT_THAT(reports, Not(IsEmpty()));
+  EXPECT_THAT(reports.back().messages, Eq(progress.messages));
+  EXPECT_THAT(progress.messages, Eq(storage_->get_metadata().message_count));
+  EXPECT_THAT(progress.total_messages, Eq(progress.messages));
+  EXPECT_THAT(progress.bytes_read, Gt(0u));
+  EXPECT_THAT(progress.bytes_written, Gt(0u));
+}
+
+TEST_F(RosbagV2StorageTestFixture, output_topics_are_serialized_as_cdr)
+{
+  BagConverter converter(open_storage(bag_path_, "rosbag_v2"), BagConverter::Options());
+
+  auto topics = converter.get_output_topics();
+
+  ASSERT_THAT(topics, SizeIs(storage_->get_all_topics_and_types().size()));
+  for (const auto & topic : topics) {
+    EXPECT_THAT(topic.serialization_format, StrEq("cdr"));
+  }
+}
+
+TEST_F(RosbagV2StorageTestFixture, errors_writing_messages_stop_the_conversion)
+{
+  BagConverter converter(open_storage(bag_path_, "rosbag_v2"), BagConverter::Options());
+
+  EXPECT_THROW(
+    converter.convert(
+      [](std::shared_ptr<rosbag2_storage::SerializedBagMessage>) {
+        throw std::runtime_error("disk full");
+      }), std::runtime_error);
+}
+
+TEST_F(RosbagV2StorageTestFixture, storages_transcoding_to_cdr_cannot_be_converted)
+{
+  EXPECT_THROW(
+    BagConverter(open_storage(bag_path_, "cdr"), BagConverter::Options()), std::runtime_error);
+}
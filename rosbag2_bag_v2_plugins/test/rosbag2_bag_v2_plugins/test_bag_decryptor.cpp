@@ -0,0 +1,312 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <gmock/gmock.h>
+
+#include <openssl/evp.h>
+
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "rcpputils/filesystem_helper.hpp"
+#include "rosbag2_test_common/temporary_directory_fixture.hpp"
+
+#include "rosbag2_bag_v2_plugins/storage/bag_chunk.hpp"
+#include "rosbag2_bag_v2_plugins/storage/bag_decryptor.hpp"
+#include "rosbag2_bag_v2_plugins/storage/bag_format.hpp"
+#include "rosbag2_bag_v2_plugins/storage/bag_index.hpp"
+
+using namespace ::testing;  // NOLINT
+
+namespace
+{
+
+const std::string key = "0123456789abcdef";  // NOLINT
+
+// Encrypts like the AesCbcEncryptor of rosbag_storage: initialization vector, then the cipher
+// text of the PKCS#7 padded data
+std::vector<uint8_t> encrypt(const std::string & plain_text, const std::string & encryption_key)
+{
+  std::vector<uint8_t> encrypted(16 + plain_text.size() + 16);
+  for (size_t i = 0; i < 16; ++i) {
+    encrypted[i] = static_cast<uint8_t>(i * 7);
+  }
+  auto context = EVP_CIPHER_CTX_new();
+  EVP_EncryptInit_ex(
+    context, EVP_aes_128_cbc(), nullptr,
+    reinterpret_cast<const unsigned char *>(encryption_key.data()), encrypted.data());
+  int update_length = 0;
+  int final_length = 0;
+  EVP_EncryptUpdate(
+    context, encrypted.data() + 16, &update_length,
+    reinterpret_cast<const unsigned char *>(plain_text.data()),
+    static_cast<int>(plain_text.size()));
+  EVP_EncryptFinal_ex(context, encrypted.data() + 16 + update_length, &final_length);
+  EVP_CIPHER_CTX_free(context);
+  encrypted.resize(16 + update_length + final_length);
+  return encrypted;
+}
+
+std::vector<uint8_t> encrypt(const std::vector<uint8_t> & plain_data)
+{
+  return encrypt(std::string(plain_data.begin(), plain_data.end()), key);
+}
+
+std::string decrypt(const std::vector<uint8_t> & encrypted, const std::string & decryption_key)
+{
+  rosbag2_bag_v2_plugins::BagDecryptor decryptor(decryption_key);
+  std::vector<uint8_t> decrypted;
+  decryptor.decrypt(encrypted.data(), encrypted.size(), decrypted);
+  return std::string(decrypted.begin(), decrypted.end());
+}
+
+}  // namespace
+
+TEST(BagDecryptor, decrypts_data_encrypted_like_rosbag_storage_does)
+{
+  auto chunk = std::string(100000, 'x') + "end of chunk";
+  EXPECT_THAT(decrypt(encrypt(chunk, key), key), Eq(chunk));
+  EXPECT_THAT(decrypt(encrypt("sixteen bytes!!!", key), key), Eq("sixteen bytes!!!"));
+  EXPECT_THAT(decrypt(encrypt("", key), key), Eq(""));
+}
+
+TEST(BagDecryptor, throws_if_the_data_is_not_a_whole_number_of_blocks)
+{
+  auto encrypted = encrypt("some data", key);
+  encrypted.pop_back();
+  EXPECT_THROW(decrypt(encrypted, key), std::runtime_error);
+  EXPECT_THROW(decrypt(std::vector<uint8_t>(16), key), std::runtime_error);
+}
+
+TEST(BagDecryptor, throws_if_the_data_was_encrypted_with_a_different_key)
+{
+  EXPECT_THROW(
+    decrypt(encrypt("some data", key), "fedcba9876543210"), std::runtime_error);
+}
+
+TEST(BagDecryptor, only_accepts_aes_128_keys)
+{
+  EXPECT_THROW(rosbag2_bag_v2_plugins::BagDecryptor("short"), std::runtime_error);
+}
+
+TEST(SymmetricKeyCache, decrypts_every_key_only_once)
+{
+  rosbag2_bag_v2_plugins::SymmetricKeyCache cache;
+  int decrypt_count = 0;
+  auto decrypt_key = [&decrypt_count](const std::string & encrypted_key) {
+      ++decrypt_count;
+      return "key of " + encrypted_key;
+    };
+
+  EXPECT_THAT(cache.get("first", decrypt_key), Eq("key of first"));
+  EXPECT_THAT(cache.get("second", decrypt_key), Eq("key of second"));
+  EXPECT_THAT(cache.get("first", decrypt_key), Eq("key of first"));
+  EXPECT_THAT(decrypt_count, Eq(2));
+}
+
+TEST(SymmetricKeyCache, does_not_cache_keys_that_could_not_be_decrypted)
+{
+  rosbag2_bag_v2_plugins::SymmetricKeyCache cache;
+  auto failing_decrypt_key = [](const std::string &) -> std::string {
+      throw std::runtime_error("no passphrase given");
+    };
+
+  EXPECT_THROW(cache.get("key", failing_decrypt_key), std::runtime_error);
+  EXPECT_THAT(
+    cache.get("key", [](const std::string &) {return std::string("decrypted");}),
+    Eq("decrypted"));
+}
+
+namespace
+{
+
+namespace bag_format = rosbag2_bag_v2_plugins::bag_format;
+
+// Not a GPG message, the key is put into the SymmetricKeyCache instead of being decrypted
+const std::string encrypted_key = "encrypted key of the test bag";  // NOLINT
+
+void append_uint32(std::vector<uint8_t> & buffer, uint32_t value)
+{
+  for (size_t i = 0; i < 4; ++i) {
+    buffer.push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+void append_field(
+  std::vector<uint8_t> & header, const std::string & name, const std::string & value)
+{
+  append_uint32(header, static_cast<uint32_t>(name.size() + 1 + value.size()));
+  header.insert(header.end(), name.begin(), name.end());
+  header.push_back('=');
+  header.insert(header.end(), value.begin(), value.end());
+}
+
+void replace_uint64_field(std::vector<uint8_t> & header, const char * name, uint64_t value)
+{
+  const uint8_t * field_value = nullptr;
+  size_t field_value_length = 0;
+  bag_format::RecordHeader(header.data(), header.size()).find_field(
+    name, field_value, field_value_length);
+  auto offset = static_cast<size_t>(field_value - header.data());
+  for (size_t i = 0; i < 8; ++i) {
+    header[offset + i] = static_cast<uint8_t>(value >> (8 * i));
+  }
+}
+
+void append_record(
+  std::vector<uint8_t> & bag,
+  const std::vector<uint8_t> & header, const std::vector<uint8_t> & data)
+{
+  append_uint32(bag, static_cast<uint32_t>(header.size()));
+  bag.insert(bag.end(), header.begin(), header.end());
+  append_uint32(bag, static_cast<uint32_t>(data.size()));
+  bag.insert(bag.end(), data.begin(), data.end());
+}
+
+// Rewrites a bag like the AesCbcEncryptor of rosbag_storage writes it: chunk data is encrypted, as
+// are the headers and data of the connection records of the index
+void write_encrypted_bag(const std::string & plain_path, const std::string & encrypted_path)
+{
+  std::ifstream plain_bag(plain_path, std::ios::binary);
+  std::vector<uint8_t> version_line(bag_format::VERSION_LINE_LENGTH);
+  plain_bag.read(reinterpret_cast<char *>(version_line.data()), version_line.size());
+  bag_format::Record bag_header;
+  bag_format::read_record(plain_bag, bag_header);
+  auto bag_header_length = 8 + bag_header.header_buffer.size() + bag_header.data.size();
+  auto index_position = bag_header.header().get_uint64("index_pos");
+
+  append_field(bag_header.header_buffer, "encryptor", "rosbag/AesCbcEncryptor");
+  append_field(bag_header.header_buffer, "gpg_user", "test user");
+  append_field(bag_header.header_buffer, "encrypted_key", encrypted_key);
+  // The bag header keeps its length, its data is padding
+  bag_header.data.assign(bag_header_length - 8 - bag_header.header_buffer.size(), ' ');
+
+  std::vector<uint8_t> records;
+  std::map<uint64_t, uint64_t> encrypted_chunk_positions;
+  auto records_position = version_line.size() + bag_header_length;
+  bag_format::Record record;
+  while (static_cast<uint64_t>(plain_bag.tellg()) < index_position) {
+    auto position = static_cast<uint64_t>(plain_bag.tellg());
+    bag_format::read_record(plain_bag, record);
+    if (record.header().get_op() == bag_format::OpCode::CHUNK) {
+      encrypted_chunk_positions[position] = records_position + records.size();
+      record.data = encrypt(record.data);
+    }
+    append_record(records, record.header_buffer, record.data);
+  }
+  replace_uint64_field(
+    bag_header.header_buffer, "index_pos", records_position + records.size());
+  while (plain_bag.peek() != std::char_traits<char>::eof()) {
+    bag_format::read_record(plain_bag, record);
+    if (record.header().get_op() == bag_format::OpCode::CONNECTION) {
+      append_record(records, encrypt(record.header_buffer), encrypt(record.data));
+    } else {
+      if (record.header().get_op() == bag_format::OpCode::CHUNK_INFO) {
+        replace_uint64_field(
+          record.header_buffer, "chunk_pos",
+          encrypted_chunk_positions.at(record.header().get_uint64("chunk_pos")));
+      }
+      append_record(records, record.header_buffer, record.data);
+    }
+  }
+
+  std::vector<uint8_t> encrypted_bag(version_line);
+  append_record(encrypted_bag, bag_header.header_buffer, bag_header.data);
+  encrypted_bag.insert(encrypted_bag.end(), records.begin(), records.end());
+  std::ofstream(encrypted_path, std::ios::binary).write(
+    reinterpret_cast<const char *>(encrypted_bag.data()), encrypted_bag.size());
+}
+
+}  // namespace
+
+class EncryptedBagTestFixture : public TemporaryDirectoryFixture
+{
+public:
+  EncryptedBagTestFixture()
+  {
+    plain_path_ = (rcpputils::fs::path(_SRC_RESOURCES_DIR_PATH) / "test_bag.bag").string();
+    encrypted_path_ = (rcpputils::fs::path(temporary_dir_path_) / "encrypted.bag").string();
+    write_encrypted_bag(plain_path_, encrypted_path_);
+    // Opening the bag takes the key from the cache instead of asking GPG for it
+    rosbag2_bag_v2_plugins::SymmetricKeyCache::get_instance().get(
+      encrypted_key, [](const std::string &) {return key;});
+  }
+
+  std::string plain_path_;
+  std::string encrypted_path_;
+};
+
+TEST_F(EncryptedBagTestFixture, index_of_an_encrypted_bag_has_the_decrypted_connections)
+{
+  auto plain_index = rosbag2_bag_v2_plugins::BagIndex::read(plain_path_);
+  auto encrypted_index = rosbag2_bag_v2_plugins::BagIndex::read(encrypted_path_);
+
+  ASSERT_THAT(plain_index, NotNull());
+  ASSERT_THAT(encrypted_index, NotNull());
+  EXPECT_FALSE(plain_index->is_encrypted());
+  EXPECT_TRUE(encrypted_index->is_encrypted());
+  ASSERT_THAT(
+    encrypted_index->get_connections(), SizeIs(plain_index->get_connections().size()));
+  for (const auto & connection : plain_index->get_connections()) {
+    auto encrypted_connection = encrypted_index->get_connection(connection.id);
+    ASSERT_THAT(encrypted_connection, NotNull());
+    EXPECT_THAT(encrypted_connection->topic, StrEq(connection.topic));
+    EXPECT_THAT(encrypted_connection->datatype, StrEq(connection.datatype));
+    EXPECT_THAT(encrypted_connection->md5sum, StrEq(connection.md5sum));
+    EXPECT_THAT(
+      encrypted_connection->message_definition, StrEq(connection.message_definition));
+  }
+  EXPECT_THAT(
+    encrypted_index->get_chunk_infos(), SizeIs(plain_index->get_chunk_infos().size()));
+}
+
+TEST_F(EncryptedBagTestFixture, chunks_of_an_encrypted_bag_are_decrypted_when_read)
+{
+  auto plain_index = rosbag2_bag_v2_plugins::BagIndex::read(plain_path_);
+  auto encrypted_index = rosbag2_bag_v2_plugins::BagIndex::read(encrypted_path_);
+  ASSERT_THAT(plain_index, NotNull());
+  ASSERT_THAT(encrypted_index, NotNull());
+  ASSERT_THAT(plain_index->get_chunk_infos(), Not(IsEmpty()));
+  std::unordered_set<uint32_t> connection_ids;
+  for (const auto & connection : plain_index->get_connections()) {
+    connection_ids.insert(connection.id);
+  }
+
+  rosbag2_bag_v2_plugins::BagFileStreams plain_files(plain_index);
+  for (bool memory_mapped : {false, true}) {
+    rosbag2_bag_v2_plugins::BagFileStreams encrypted_files(encrypted_index, memory_mapped);
+    for (size_t i = 0; i < plain_index->get_chunk_infos().size(); ++i) {
+      auto plain_chunk = rosbag2_bag_v2_plugins::read_chunk(
+        plain_files, *plain_index, plain_index->get_chunk_infos()[i], connection_ids);
+      auto encrypted_chunk = rosbag2_bag_v2_plugins::read_chunk(
+        encrypted_files, *encrypted_index, encrypted_index->get_chunk_infos()[i], connection_ids);
+
+      ASSERT_THAT(encrypted_chunk->get_size(), Eq(plain_chunk->get_size()));
+      EXPECT_THAT(
+        std::vector<uint8_t>(
+          encrypted_chunk->get_data(), encrypted_chunk->get_data() + encrypted_chunk->get_size()),
+        ElementsAreArray(plain_chunk->get_data(), plain_chunk->get_size()));
+      EXPECT_THAT(
+        encrypted_chunk->get_messages(), SizeIs(plain_chunk->get_messages().size()));
+    }
+  }
+}
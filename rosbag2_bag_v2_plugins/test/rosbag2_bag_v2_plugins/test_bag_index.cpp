@@ -0,0 +1,114 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <gmock/gmock.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "rcpputils/filesystem_helper.hpp"
+#include "rosbag2_bag_v2_plugins/storage/bag_index.hpp"
+
+using namespace ::testing;  // NOLINT
+
+namespace
+{
+rosbag2_bag_v2_plugins::ChunkInfoRecord make_chunk_info(uint64_t start_time, uint64_t end_time)
+{
+  rosbag2_bag_v2_plugins::ChunkInfoRecord chunk_info;
+  chunk_info.chunk_position = 0;
+  chunk_info.start_time = start_time;
+  chunk_info.end_time = end_time;
+  chunk_info.message_counts = {{0u, 1u}};
+  return chunk_info;
+}
+
+std::string get_bag_path()
+{
+  return (rcpputils::fs::path(_SRC_RESOURCES_DIR_PATH) /
+         "test_bag_multiple_connections.bag").string();
+}
+
+void expect_same_chunk_infos(
+  const std::vector<rosbag2_bag_v2_plugins::ChunkInfoRecord> & chunk_infos,
+  const std::vector<rosbag2_bag_v2_plugins::ChunkInfoRecord> & other_chunk_infos)
+{
+  ASSERT_THAT(other_chunk_infos, SizeIs(chunk_infos.size()));
+  for (size_t i = 0; i < chunk_infos.size(); ++i) {
+    EXPECT_THAT(other_chunk_infos[i].chunk_position, Eq(chunk_infos[i].chunk_position));
+    EXPECT_THAT(other_chunk_infos[i].start_time, Eq(chunk_infos[i].start_time));
+    EXPECT_THAT(other_chunk_infos[i].end_time, Eq(chunk_infos[i].end_time));
+    EXPECT_THAT(other_chunk_infos[i].message_counts, Eq(chunk_infos[i].message_counts));
+    EXPECT_THAT(other_chunk_infos[i].file_index, Eq(chunk_infos[i].file_index));
+  }
+}
+}  // namespace
+
+TEST(BagIndex, chunks_are_sorted_by_start_time_keeping_the_file_order_of_equal_ones)
+{
+  auto index = rosbag2_bag_v2_plugins::BagIndex::create(
+    "test.bag", {}, {make_chunk_info(30, 40), make_chunk_info(10, 20), make_chunk_info(10, 15)});
+
+  EXPECT_THAT(index->get_chunks_by_start_time(), ElementsAre(1u, 2u, 0u));
+}
+
+TEST(BagIndex, first_chunk_ending_at_or_after_a_time_is_found_in_overlapping_chunks)
+{
+  // The chunk starting first overlaps the two after it
+  auto index = rosbag2_bag_v2_plugins::BagIndex::create(
+    "test.bag", {},
+    {make_chunk_info(0, 50), make_chunk_info(10, 20), make_chunk_info(30, 40),
+      make_chunk_info(60, 70)});
+
+  EXPECT_THAT(index->find_first_chunk_ending_at_or_after(0), Eq(0u));
+  EXPECT_THAT(index->find_first_chunk_ending_at_or_after(50), Eq(0u));
+  EXPECT_THAT(index->find_first_chunk_ending_at_or_after(51), Eq(3u));
+  EXPECT_THAT(index->find_first_chunk_ending_at_or_after(70), Eq(3u));
+  EXPECT_THAT(index->find_first_chunk_ending_at_or_after(71), Eq(4u));
+}
+
+TEST(BagIndex, deferred_chunk_infos_are_read_on_first_use)
+{
+  auto index = rosbag2_bag_v2_plugins::BagIndex::read(get_bag_path());
+  auto deferred_index = rosbag2_bag_v2_plugins::BagIndex::read_deferring_chunk_infos(
+    get_bag_path());
+  ASSERT_THAT(index, NotNull());
+  ASSERT_THAT(deferred_index, NotNull());
+
+  EXPECT_TRUE(index->are_chunk_infos_loaded());
+  EXPECT_FALSE(deferred_index->are_chunk_infos_loaded());
+  EXPECT_THAT(deferred_index->get_connections(), SizeIs(index->get_connections().size()));
+  EXPECT_FALSE(deferred_index->are_chunk_infos_loaded());
+
+  expect_same_chunk_infos(index->get_chunk_infos(), deferred_index->get_chunk_infos());
+  EXPECT_TRUE(deferred_index->are_chunk_infos_loaded());
+  EXPECT_THAT(deferred_index->get_chunks_by_start_time(), Eq(index->get_chunks_by_start_time()));
+}
+
+TEST(BagIndex, deferred_chunk_infos_of_split_bags_are_merged_on_first_use)
+{
+  auto merged_index = rosbag2_bag_v2_plugins::BagIndex::merge(
+    {rosbag2_bag_v2_plugins::BagIndex::read(get_bag_path()),
+      rosbag2_bag_v2_plugins::BagIndex::read(get_bag_path())});
+  auto deferred_index = rosbag2_bag_v2_plugins::BagIndex::merge(
+    {rosbag2_bag_v2_plugins::BagIndex::read_deferring_chunk_infos(get_bag_path()),
+      rosbag2_bag_v2_plugins::BagIndex::read_deferring_chunk_infos(get_bag_path())});
+
+  EXPECT_FALSE(deferred_index->are_chunk_infos_loaded());
+  EXPECT_THAT(deferred_index->get_connections(), SizeIs(merged_index->get_connections().size()));
+  expect_same_chunk_infos(merged_index->get_chunk_infos(), deferred_index->get_chunk_infos());
+  EXPECT_TRUE(deferred_index->are_chunk_infos_loaded());
+}
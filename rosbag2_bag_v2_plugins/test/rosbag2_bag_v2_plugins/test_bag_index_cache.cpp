@@ -0,0 +1,178 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gmock/gmock.h>
+
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "rcpputils/filesystem_helper.hpp"
+#include "rcutils/filesystem.h"
+#include "rosbag2_test_common/temporary_directory_fixture.hpp"
+#include "rosbag2_bag_v2_plugins/storage/bag_index.hpp"
+#include "rosbag2_bag_v2_plugins/storage/bag_index_cache.hpp"
+
+using namespace ::testing;  // NOLINT
+
+class BagIndexCacheTestFixture : public Test
+{
+public:
+  BagIndexCacheTestFixture()
+  {
+    bag_path_ = (rcpputils::fs::path(_SRC_RESOURCES_DIR_PATH) /
+      "test_bag_multiple_connections.bag").string();
+    index_ = rosbag2_bag_v2_plugins::BagIndex::read(bag_path_);
+    stamp_ = {"/bags/run_0.bag", 1234u, 5678};
+  }
+
+  std::string write_cache()
+  {
+    std::stringstream cache;
+    rosbag2_bag_v2_plugins::write_bag_index_cache(*index_, stamp_, cache);
+    return cache.str();
+  }
+
+  std::shared_ptr<const rosbag2_bag_v2_plugins::BagIndex> read_cache(
+    const std::string & data, const rosbag2_bag_v2_plugins::BagFileStamp & stamp)
+  {
+    std::stringstream cache(data);
+    return rosbag2_bag_v2_plugins::read_bag_index_cache(cache, bag_path_, stamp);
+  }
+
+  std::string bag_path_;
+  std::shared_ptr<const rosbag2_bag_v2_plugins::BagIndex> index_;
+  rosbag2_bag_v2_plugins::BagFileStamp stamp_;
+};
+
+TEST_F(BagIndexCacheTestFixture, cached_index_equals_index_read_from_bag)
+{
+  ASSERT_THAT(index_, NotNull());
+
+  auto cached_index = read_cache(write_cache(), stamp_);
+
+  ASSERT_THAT(cached_index, NotNull());
+  EXPECT_THAT(cached_index->get_path(), StrEq(bag_path_));
+  ASSERT_THAT(cached_index->get_connections(), SizeIs(index_->get_connections().size()));
+  for (const auto & connection : index_->get_connections()) {
+    auto cached_connection = cached_index->get_connection(connection.id);
+    ASSERT_THAT(cached_connection, NotNull());
+    EXPECT_THAT(cached_connection->topic, StrEq(connection.topic));
+    EXPECT_THAT(cached_connection->datatype, StrEq(connection.datatype));
+    EXPECT_THAT(cached_connection->md5sum, StrEq(connection.md5sum));
+    EXPECT_THAT(cached_connection->message_definition, StrEq(connection.message_definition));
+  }
+  ASSERT_THAT(cached_index->get_chunk_infos(), SizeIs(index_->get_chunk_infos().size()));
+  for (size_t i = 0; i < index_->get_chunk_infos().size(); ++i) {
+    const auto & chunk_info = index_->get_chunk_infos()[i];
+    const auto & cached_chunk_info = cached_index->get_chunk_infos()[i];
+    EXPECT_THAT(cached_chunk_info.chunk_position, Eq(chunk_info.chunk_position));
+    EXPECT_THAT(cached_chunk_info.start_time, Eq(chunk_info.start_time));
+    EXPECT_THAT(cached_chunk_info.end_time, Eq(chunk_info.end_time));
+    EXPECT_THAT(cached_chunk_info.message_counts, ContainerEq(chunk_info.message_counts));
+  }
+}
+
+TEST_F(BagIndexCacheTestFixture, cache_is_ignored_if_the_bag_has_changed)
+{
+  ASSERT_THAT(index_, NotNull());
+  auto cache = write_cache();
+
+  EXPECT_THAT(
+    read_cache(cache, {stamp_.path, stamp_.size + 1, stamp_.modification_time}), IsNull());
+  EXPECT_THAT(
+    read_cache(cache, {stamp_.path, stamp_.size, stamp_.modification_time + 1}), IsNull());
+}
+
+TEST_F(BagIndexCacheTestFixture, cache_is_ignored_if_written_for_another_bag)
+{
+  ASSERT_THAT(index_, NotNull());
+  auto cache = write_cache();
+
+  EXPECT_THAT(
+    read_cache(cache, {"/other_bags/run_0.bag", stamp_.size, stamp_.modification_time}),
+    IsNull());
+}
+
+TEST_F(BagIndexCacheTestFixture, caches_of_bags_with_the_same_name_do_not_collide)
+{
+  rosbag2_bag_v2_plugins::BagFileStamp other_stamp = stamp_;
+  other_stamp.path = "/other_bags/run_0.bag";
+
+  auto cache_path = rosbag2_bag_v2_plugins::get_bag_index_cache_path(stamp_, "/cache");
+  auto other_cache_path = rosbag2_bag_v2_plugins::get_bag_index_cache_path(other_stamp, "/cache");
+
+  EXPECT_THAT(cache_path, StartsWith("/cache"));
+  EXPECT_THAT(cache_path, HasSubstr("run_0.bag"));
+  EXPECT_THAT(cache_path, StrNe(other_cache_path));
+  EXPECT_THAT(
+    rosbag2_bag_v2_plugins::get_bag_index_cache_path(stamp_, ""),
+    StrEq("/bags/run_0.bag.rosbag2_v2_index"));
+}
+
+TEST_F(BagIndexCacheTestFixture, bag_file_stamp_holds_the_absolute_path_of_the_bag)
+{
+  rosbag2_bag_v2_plugins::BagFileStamp stamp;
+
+  ASSERT_TRUE(rosbag2_bag_v2_plugins::get_bag_file_stamp(bag_path_, stamp));
+  EXPECT_TRUE(rcpputils::fs::path(stamp.path).is_absolute());
+  EXPECT_THAT(rcpputils::fs::path(stamp.path).filename().string(),
+    StrEq("test_bag_multiple_connections.bag"));
+  EXPECT_FALSE(rosbag2_bag_v2_plugins::get_bag_file_stamp(bag_path_ + ".missing", stamp));
+}
+
+TEST_F(BagIndexCacheTestFixture, corrupt_cache_is_ignored)
+{
+  ASSERT_THAT(index_, NotNull());
+  auto cache = write_cache();
+
+  EXPECT_THAT(read_cache(cache.substr(0, cache.size() - 1), stamp_), IsNull());
+  EXPECT_THAT(read_cache(cache + "x", stamp_), IsNull());
+  EXPECT_THAT(read_cache("", stamp_), IsNull());
+}
+
+class BagIndexCacheFileTestFixture : public TemporaryDirectoryFixture
+{
+public:
+  BagIndexCacheFileTestFixture()
+  {
+    bag_path_ = (rcpputils::fs::path(temporary_dir_path_) / "run_0.bag").string();
+    std::ifstream source(
+      (rcpputils::fs::path(_SRC_RESOURCES_DIR_PATH) / "test_bag_multiple_connections.bag").string(),
+      std::ios::binary);
+    std::ofstream destination(bag_path_, std::ios::binary);
+    destination << source.rdbuf();
+  }
+
+  std::string bag_path_;
+};
+
+TEST_F(BagIndexCacheFileTestFixture, cache_is_written_beside_leftover_temporary_files)
+{
+  rosbag2_bag_v2_plugins::BagFileStamp stamp;
+  ASSERT_TRUE(rosbag2_bag_v2_plugins::get_bag_file_stamp(bag_path_, stamp));
+  auto cache_path = rosbag2_bag_v2_plugins::get_bag_index_cache_path(stamp, "");
+  // A file left behind by another writer must neither be reused nor block writing the cache
+  ASSERT_TRUE(rcutils_mkdir((cache_path + ".tmp").c_str()));
+
+  auto index = rosbag2_bag_v2_plugins::read_bag_index_using_cache(bag_path_, "");
+
+  ASSERT_THAT(index, NotNull());
+  EXPECT_TRUE(rcutils_is_file(cache_path.c_str()));
+  std::ifstream cache(cache_path, std::ios::binary);
+  auto cached_index = rosbag2_bag_v2_plugins::read_bag_index_cache(cache, bag_path_, stamp);
+  ASSERT_THAT(cached_index, NotNull());
+  EXPECT_THAT(cached_index->get_chunk_infos(), SizeIs(index->get_chunk_infos().size()));
+}
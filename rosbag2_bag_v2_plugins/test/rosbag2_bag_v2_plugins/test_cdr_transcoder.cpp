@@ -0,0 +1,260 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gmock/gmock.h>
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "rcutils/allocator.h"
+#include "rcutils/types/uint8_array.h"
+#include "rmw/rmw.h"
+#include "rosidl_typesupport_cpp/message_type_support.hpp"
+#include "sensor_msgs/msg/joint_state.hpp"
+
+#include "rosbag2_bag_v2_plugins/cdr_transcoder.hpp"
+#include "rosbag2_bag_v2_plugins/converter_handle.hpp"
+
+using namespace ::testing;  // NOLINT
+using rosbag2_bag_v2_plugins::CdrArrayKind;
+using rosbag2_bag_v2_plugins::CdrFieldKind;
+using rosbag2_bag_v2_plugins::CdrFieldPlan;
+using rosbag2_bag_v2_plugins::CdrFieldPresence;
+using rosbag2_bag_v2_plugins::CdrTranscoderPlan;
+
+namespace
+{
+
+const CdrFieldPlan time_fields[] = {
+  {CdrFieldKind::PRIMITIVE, 4, CdrArrayKind::NONE, 0, nullptr, CdrFieldPresence::BOTH},
+  {CdrFieldKind::PRIMITIVE, 4, CdrArrayKind::NONE, 0, nullptr, CdrFieldPresence::BOTH},
+};
+const CdrTranscoderPlan time_plan = {time_fields, 2};
+
+// Like std_msgs/Header
+const CdrFieldPlan header_fields[] = {
+  {CdrFieldKind::PRIMITIVE, 4, CdrArrayKind::NONE, 0, nullptr, CdrFieldPresence::ROS1_ONLY},
+  {CdrFieldKind::MESSAGE, 0, CdrArrayKind::NONE, 0, &time_plan, CdrFieldPresence::BOTH},
+  {CdrFieldKind::STRING, 0, CdrArrayKind::NONE, 0, nullptr, CdrFieldPresence::BOTH},
+};
+const CdrTranscoderPlan header_plan = {header_fields, 3};
+
+class ByteWriter
+{
+public:
+  ByteWriter & uint8(uint8_t value)
+  {
+    bytes.push_back(value);
+    return *this;
+  }
+
+  ByteWriter & uint32(uint32_t value)
+  {
+    for (size_t i = 0; i < 4; ++i) {
+      bytes.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+    return *this;
+  }
+
+  ByteWriter & float64(double value)
+  {
+    uint8_t value_bytes[8];
+    memcpy(value_bytes, &value, sizeof(value_bytes));
+    bytes.insert(bytes.end(), value_bytes, value_bytes + sizeof(value_bytes));
+    return *this;
+  }
+
+  ByteWriter & characters(const std::string & value)
+  {
+    bytes.insert(bytes.end(), value.begin(), value.end());
+    return *this;
+  }
+
+  ByteWriter & padding(size_t length)
+  {
+    bytes.insert(bytes.end(), length, 0);
+    return *this;
+  }
+
+  std::vector<uint8_t> bytes;
+};
+
+ByteWriter cdr_message()
+{
+  return ByteWriter().uint8(0x00).uint8(0x01).uint8(0x00).uint8(0x00);
+}
+
+std::vector<uint8_t> transcode(const CdrTranscoderPlan & plan, const std::vector<uint8_t> & ros1)
+{
+  auto allocator = rcutils_get_default_allocator();
+  auto cdr = rcutils_get_zero_initialized_uint8_array();
+  rcutils_uint8_array_init(&cdr, 0, &allocator);
+  try {
+    rosbag2_bag_v2_plugins::transcode_to_cdr(plan, ros1.data(), ros1.size(), cdr);
+  } catch (...) {
+    rcutils_uint8_array_fini(&cdr);
+    throw;
+  }
+  std::vector<uint8_t> cdr_bytes(cdr.buffer, cdr.buffer + cdr.buffer_length);
+  rcutils_uint8_array_fini(&cdr);
+  return cdr_bytes;
+}
+
+std::vector<uint8_t> serialize_ros1_joint_state(const sensor_msgs::msg::JointState & joint_state)
+{
+  ByteWriter ros1;
+  ros1.uint32(0)
+    .uint32(static_cast<uint32_t>(joint_state.header.stamp.sec))
+    .uint32(joint_state.header.stamp.nanosec)
+    .uint32(static_cast<uint32_t>(joint_state.header.frame_id.size()))
+    .characters(joint_state.header.frame_id);
+  ros1.uint32(static_cast<uint32_t>(joint_state.name.size()));
+  for (const auto & name : joint_state.name) {
+    ros1.uint32(static_cast<uint32_t>(name.size())).characters(name);
+  }
+  for (const auto * values : {&joint_state.position, &joint_state.velocity, &joint_state.effort}) {
+    ros1.uint32(static_cast<uint32_t>(values->size()));
+    for (auto value : *values) {
+      ros1.float64(value);
+    }
+  }
+  return ros1.bytes;
+}
+
+std::vector<uint8_t> rmw_serialize_joint_state(const sensor_msgs::msg::JointState & joint_state)
+{
+  auto allocator = rcutils_get_default_allocator();
+  auto cdr = rcutils_get_zero_initialized_uint8_array();
+  rcutils_uint8_array_init(&cdr, 0, &allocator);
+  auto ret = rmw_serialize(
+    &joint_state,
+    rosidl_typesupport_cpp::get_message_type_support_handle<sensor_msgs::msg::JointState>(),
+    &cdr);
+  std::vector<uint8_t> cdr_bytes(cdr.buffer, cdr.buffer + cdr.buffer_length);
+  rcutils_uint8_array_fini(&cdr);
+  if (ret != RMW_RET_OK) {
+    throw std::runtime_error("Failed to serialize sensor_msgs/JointState");
+  }
+  return cdr_bytes;
+}
+
+}  // namespace
+
+TEST(CdrTranscoder, skips_ros1_only_fields_and_terminates_strings)
+{
+  auto ros1 = ByteWriter().uint32(7).uint32(1).uint32(2).uint32(2).characters("ab").bytes;
+
+  auto expected = cdr_message().uint32(1).uint32(2).uint32(3).characters("ab").uint8(0).bytes;
+  EXPECT_THAT(transcode(header_plan, ros1), ContainerEq(expected));
+}
+
+TEST(CdrTranscoder, aligns_primitives_to_their_size)
+{
+  // Like sensor_msgs/Image, shortened to header, data and a trailing float64
+  const CdrFieldPlan fields[] = {
+    {CdrFieldKind::MESSAGE, 0, CdrArrayKind::NONE, 0, &header_plan, CdrFieldPresence::BOTH},
+    {CdrFieldKind::PRIMITIVE, 1, CdrArrayKind::SEQUENCE, 0, nullptr, CdrFieldPresence::BOTH},
+    {CdrFieldKind::PRIMITIVE, 8, CdrArrayKind::NONE, 0, nullptr, CdrFieldPresence::BOTH},
+  };
+  const CdrTranscoderPlan plan = {fields, 3};
+  auto ros1 = ByteWriter()
+    .uint32(7).uint32(1).uint32(2).uint32(2).characters("ab")
+    .uint32(3).uint8(1).uint8(2).uint8(3)
+    .float64(1.5).bytes;
+
+  auto expected = cdr_message()
+    .uint32(1).uint32(2).uint32(3).characters("ab").uint8(0)
+    .padding(1).uint32(3).uint8(1).uint8(2).uint8(3)
+    .padding(1).float64(1.5).bytes;
+  EXPECT_THAT(transcode(plan, ros1), ContainerEq(expected));
+}
+
+TEST(CdrTranscoder, writes_fixed_size_arrays_without_length)
+{
+  const CdrFieldPlan fields[] = {
+    {CdrFieldKind::PRIMITIVE, 4, CdrArrayKind::FIXED_SIZE, 2, nullptr, CdrFieldPresence::BOTH},
+    {CdrFieldKind::STRING, 0, CdrArrayKind::SEQUENCE, 0, nullptr, CdrFieldPresence::BOTH},
+    {CdrFieldKind::MESSAGE, 0, CdrArrayKind::FIXED_SIZE, 2, &time_plan, CdrFieldPresence::BOTH},
+  };
+  const CdrTranscoderPlan plan = {fields, 3};
+  auto ros1 = ByteWriter()
+    .uint32(10).uint32(11)
+    .uint32(2).uint32(1).characters("a").uint32(0)
+    .uint32(1).uint32(2).uint32(3).uint32(4).bytes;
+
+  auto expected = cdr_message()
+    .uint32(10).uint32(11)
+    .uint32(2).uint32(2).characters("a").uint8(0).padding(2).uint32(1).uint8(0)
+    .padding(3).uint32(1).uint32(2).uint32(3).uint32(4).bytes;
+  EXPECT_THAT(transcode(plan, ros1), ContainerEq(expected));
+}
+
+TEST(CdrTranscoder, writes_ros2_only_fields_as_zero)
+{
+  // Like std_msgs/Empty
+  const CdrFieldPlan fields[] = {
+    {CdrFieldKind::PRIMITIVE, 1, CdrArrayKind::NONE, 0, nullptr, CdrFieldPresence::ROS2_ONLY},
+  };
+  const CdrTranscoderPlan plan = {fields, 1};
+
+  EXPECT_THAT(transcode(plan, {}), ContainerEq(cdr_message().uint8(0).bytes));
+}
+
+TEST(CdrTranscoder, throws_on_truncated_messages)
+{
+  auto ros1 = ByteWriter().uint32(7).uint32(1).uint32(2).uint32(200).characters("ab").bytes;
+
+  EXPECT_THROW(transcode(header_plan, ros1), std::runtime_error);
+}
+
+TEST(CdrTranscoder, throws_on_sequences_longer_than_the_message)
+{
+  const CdrFieldPlan fields[] = {
+    {CdrFieldKind::PRIMITIVE, 8, CdrArrayKind::SEQUENCE, 0, nullptr, CdrFieldPresence::BOTH},
+  };
+  const CdrTranscoderPlan plan = {fields, 1};
+  auto ros1 = ByteWriter().uint32(0xffffffff).float64(1.0).bytes;
+
+  EXPECT_THROW(transcode(plan, ros1), std::runtime_error);
+}
+
+TEST(CdrTranscoder, transcodes_empty_and_filled_sequences_like_rmw_serialize)
+{
+  auto converter = rosbag2_bag_v2_plugins::resolve_converter_handle("sensor_msgs/JointState");
+  ASSERT_THAT(converter, NotNull());
+  ASSERT_THAT(converter->cdr_plan, NotNull());
+
+  // The frame ids move the lengths of the float64 sequences both onto and off 8 byte boundaries
+  for (const std::string frame_id : {"", "base", "base_link"}) {
+    sensor_msgs::msg::JointState joint_state;
+    joint_state.header.stamp.sec = 1;
+    joint_state.header.stamp.nanosec = 2;
+    joint_state.header.frame_id = frame_id;
+    joint_state.velocity = {1.5, -2.5};
+    EXPECT_THAT(
+      transcode(*converter->cdr_plan, serialize_ros1_joint_state(joint_state)),
+      ContainerEq(rmw_serialize_joint_state(joint_state))) << "frame_id '" << frame_id << "'";
+
+    joint_state.name = {"joint"};
+    joint_state.position = {0.5};
+    joint_state.velocity.clear();
+    joint_state.effort = {3.5};
+    EXPECT_THAT(
+      transcode(*converter->cdr_plan, serialize_ros1_joint_state(joint_state)),
+      ContainerEq(rmw_serialize_joint_state(joint_state))) << "frame_id '" << frame_id << "'";
+  }
+}
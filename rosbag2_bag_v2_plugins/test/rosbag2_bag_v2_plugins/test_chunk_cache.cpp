@@ -0,0 +1,125 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <gmock/gmock.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "rcpputils/filesystem_helper.hpp"
+#include "rosbag2_bag_v2_plugins/storage/bag_chunk.hpp"
+#include "rosbag2_bag_v2_plugins/storage/bag_index.hpp"
+#include "rosbag2_bag_v2_plugins/storage/chunk_cache.hpp"
+
+using namespace ::testing;  // NOLINT
+
+namespace
+{
+std::shared_ptr<const rosbag2_bag_v2_plugins::Chunk> make_chunk(size_t size = 16)
+{
+  return std::make_shared<rosbag2_bag_v2_plugins::Chunk>(
+    std::vector<uint8_t>(size),
+    std::vector<rosbag2_bag_v2_plugins::ChunkMessage>{{1u, 0u, 0u, 1u}});
+}
+}  // namespace
+
+TEST(ChunkCache, inserted_chunks_are_found)
+{
+  rosbag2_bag_v2_plugins::ChunkCache cache(2, 1024);
+  auto chunk = make_chunk();
+  cache.insert(3, chunk);
+
+  EXPECT_THAT(cache.find(3), Eq(chunk));
+  EXPECT_THAT(cache.find(4), IsNull());
+  EXPECT_THAT(cache.get_bytes(), Eq(16u));
+}
+
+TEST(ChunkCache, least_recently_used_chunk_is_dropped_beyond_the_maximum_chunks)
+{
+  rosbag2_bag_v2_plugins::ChunkCache cache(2, 1024);
+  cache.insert(0, make_chunk());
+  cache.insert(1, make_chunk());
+  // Using the first chunk makes the second one the least recently used
+  EXPECT_THAT(cache.find(0), NotNull());
+  cache.insert(2, make_chunk());
+
+  EXPECT_THAT(cache.size(), Eq(2u));
+  EXPECT_THAT(cache.find(0), NotNull());
+  EXPECT_THAT(cache.find(1), IsNull());
+  EXPECT_THAT(cache.find(2), NotNull());
+}
+
+TEST(ChunkCache, least_recently_used_chunks_are_dropped_beyond_the_maximum_bytes)
+{
+  rosbag2_bag_v2_plugins::ChunkCache cache(10, 100);
+  cache.insert(0, make_chunk(40));
+  cache.insert(1, make_chunk(40));
+  cache.insert(2, make_chunk(40));
+
+  EXPECT_THAT(cache.size(), Eq(2u));
+  EXPECT_THAT(cache.get_bytes(), Eq(80u));
+  EXPECT_THAT(cache.find(0), IsNull());
+
+  // The chunk inserted last is kept even if it exceeds the limit on its own
+  cache.insert(3, make_chunk(200));
+  EXPECT_THAT(cache.size(), Eq(1u));
+  EXPECT_THAT(cache.find(3), NotNull());
+}
+
+TEST(ChunkCache, nothing_is_kept_without_capacity)
+{
+  rosbag2_bag_v2_plugins::ChunkCache cache(0, 1024);
+  cache.insert(0, make_chunk());
+
+  EXPECT_THAT(cache.size(), Eq(0u));
+  EXPECT_THAT(cache.find(0), IsNull());
+}
+
+TEST(ChunkCache, cached_chunk_is_shared_by_readers_of_other_connections)
+{
+  auto bag_path = (rcpputils::fs::path(_SRC_RESOURCES_DIR_PATH) /
+    "test_bag_multiple_connections.bag").string();
+  auto index = rosbag2_bag_v2_plugins::BagIndex::read(bag_path);
+  ASSERT_THAT(index, NotNull());
+  ASSERT_THAT(index->get_chunk_infos(), Not(IsEmpty()));
+  std::unordered_set<uint32_t> all_connection_ids;
+  for (const auto & connection : index->get_connections()) {
+    all_connection_ids.insert(connection.id);
+  }
+  ASSERT_THAT(all_connection_ids.size(), Gt(1u));
+  auto connection_id = index->get_chunk_infos()[0].message_counts[0].first;
+
+  rosbag2_bag_v2_plugins::ChunkCache cache(4, 1024 * 1024);
+  rosbag2_bag_v2_plugins::BagFileStreams files(index);
+  auto chunk = rosbag2_bag_v2_plugins::read_cached_chunk(
+    files, *index, 0, {connection_id}, &cache);
+  ASSERT_THAT(cache.size(), Eq(1u));
+  auto all_messages = rosbag2_bag_v2_plugins::read_cached_chunk(
+    files, *index, 0, all_connection_ids, &cache);
+
+  EXPECT_THAT(all_messages, Eq(cache.find(0)));
+  EXPECT_THAT(chunk->get_data(), Eq(all_messages->get_data()));
+  EXPECT_THAT(chunk->get_messages().size(), Lt(all_messages->get_messages().size()));
+  for (const auto & message : chunk->get_messages()) {
+    EXPECT_THAT(message.connection_id, Eq(connection_id));
+  }
+  EXPECT_THAT(
+    rosbag2_bag_v2_plugins::read_chunk(files, *index, index->get_chunk_infos()[0], {connection_id})
+    ->get_messages().size(),
+    Eq(chunk->get_messages().size()));
+}
@@ -0,0 +1,93 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <gmock/gmock.h>
+
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "rcpputils/filesystem_helper.hpp"
+#include "rosbag2_bag_v2_plugins/statistics.hpp"
+#include "rosbag2_bag_v2_plugins/storage/bag_index.hpp"
+#include "rosbag2_bag_v2_plugins/storage/chunk_prefetcher.hpp"
+
+using namespace ::testing;  // NOLINT
+
+class ChunkPrefetcherTestFixture : public Test
+{
+public:
+  ChunkPrefetcherTestFixture()
+  {
+    auto bag_path = (rcpputils::fs::path(_SRC_RESOURCES_DIR_PATH) /
+      "test_bag_multiple_connections.bag").string();
+    index_ = rosbag2_bag_v2_plugins::BagIndex::read(bag_path);
+    for (const auto & connection : index_->get_connections()) {
+      connection_ids_.insert(connection.id);
+    }
+    // The bag has a single chunk, which is read over and over again
+    chunk_indices_ = std::vector<size_t>(20, 0);
+  }
+
+  std::shared_ptr<const rosbag2_bag_v2_plugins::BagIndex> index_;
+  std::unordered_set<uint32_t> connection_ids_;
+  std::vector<size_t> chunk_indices_;
+};
+
+TEST_F(ChunkPrefetcherTestFixture, chunks_are_read_in_the_given_order)
+{
+  rosbag2_bag_v2_plugins::ChunkPrefetcher prefetcher(
+    index_, chunk_indices_, connection_ids_, 4, 2);
+
+  for (size_t i = 0; i < chunk_indices_.size(); ++i) {
+    auto chunk = prefetcher.next();
+    ASSERT_THAT(chunk, NotNull());
+    EXPECT_THAT(chunk->get_messages(), Not(IsEmpty()));
+  }
+  EXPECT_THROW(prefetcher.next(), std::runtime_error);
+}
+
+TEST_F(ChunkPrefetcherTestFixture, fewer_chunks_are_read_ahead_of_a_slow_reader)
+{
+  rosbag2_bag_v2_plugins::ChunkPrefetcher prefetcher(
+    index_, chunk_indices_, connection_ids_, 8, 4);
+  EXPECT_THAT(prefetcher.get_read_ahead(), Eq(4u));
+
+  for (size_t i = 0; i < chunk_indices_.size(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    prefetcher.next();
+  }
+  EXPECT_THAT(prefetcher.get_read_ahead(), Lt(4u));
+}
+
+TEST_F(ChunkPrefetcherTestFixture, a_single_chunk_is_read_ahead_if_chunks_exceed_the_max_bytes)
+{
+  rosbag2_bag_v2_plugins::ChunkStatistics statistics;
+  rosbag2_bag_v2_plugins::ChunkPrefetcher prefetcher(
+    index_, chunk_indices_, connection_ids_, 8, 4, false, &statistics, nullptr, 1);
+
+  for (size_t i = 0; i < chunk_indices_.size(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    EXPECT_THAT(prefetcher.next(), NotNull());
+  }
+  if (rosbag2_bag_v2_plugins::STATISTICS_ENABLED) {
+    EXPECT_THAT(statistics.max_prefetched_chunks.load(), Eq(1u));
+    EXPECT_THAT(statistics.chunks.load(), Eq(chunk_indices_.size()));
+  }
+}
@@ -0,0 +1,271 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gmock/gmock.h>
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "boost/make_shared.hpp"
+#include "rcpputils/filesystem_helper.hpp"
+#include "ros/message_traits.h"
+#include "ros/serialization.h"
+#include "rosbag/bag.h"
+#include "rosbag/query.h"
+#include "rosbag/view.h"
+#include "rosbag2_test_common/temporary_directory_fixture.hpp"
+#include "std_msgs/String.h"
+
+#include "rosbag2_bag_v2_plugins/message_type_header.hpp"
+#include "rosbag2_bag_v2_plugins/storage/bag_index.hpp"
+#include "rosbag2_bag_v2_plugins/storage/rosbag_v2_storage.hpp"
+#include "rosbag2_bag_v2_plugins/storage/rosbag_v2_storage_options.hpp"
+
+using namespace ::testing;  // NOLINT
+using rosbag2_bag_v2_plugins::RosbagV2Storage;
+using rosbag2_bag_v2_plugins::RosbagV2StorageOptions;
+
+namespace
+{
+
+// A multiple of 32, so that the time stamps below are a permutation of the message indices
+constexpr uint64_t MESSAGE_COUNT = 512;
+// Small enough for every chunk to hold only a few messages
+constexpr uint32_t CHUNK_THRESHOLD = 1024;
+// Only the first messages are of this topic, so that filtering for it skips most chunks
+constexpr uint64_t SPARSE_TOPIC_MESSAGE_COUNT = 64;
+
+struct Message
+{
+  std::string topic;
+  rcutils_time_point_value_t time_stamp;
+  std::vector<uint8_t> data;
+
+  bool operator==(const Message & other) const
+  {
+    return topic == other.topic && time_stamp == other.time_stamp && data == other.data;
+  }
+};
+
+std::ostream & operator<<(std::ostream & stream, const Message & message)
+{
+  return stream << message.topic << " at " << message.time_stamp << " with " <<
+         message.data.size() << " bytes";
+}
+
+rcutils_time_point_value_t get_time_stamp(uint64_t message_index)
+{
+  // Messages are written up to 24 positions out of time order, so consecutive chunks overlap
+  return static_cast<rcutils_time_point_value_t>(
+    1000000000ull + (message_index ^ 24ull) * 1000000ull);
+}
+
+size_t count_chunks_overlapping_their_predecessor(const std::string & path)
+{
+  const auto & chunk_infos = rosbag2_bag_v2_plugins::BagIndex::read(path)->get_chunk_infos();
+  size_t overlapping_chunk_count = 0;
+  for (size_t i = 1; i < chunk_infos.size(); ++i) {
+    if (chunk_infos[i].start_time <= chunk_infos[i - 1].end_time) {
+      ++overlapping_chunk_count;
+    }
+  }
+  return overlapping_chunk_count;
+}
+
+std::vector<Message> read_messages(RosbagV2Storage & storage)
+{
+  std::vector<Message> messages;
+  while (storage.has_next()) {
+    auto message = storage.read_next();
+    // Messages read in the rosbag_v2 format start with the compact type header
+    const auto & serialized_data = *message->serialized_data;
+    auto data = serialized_data.buffer + rosbag2_bag_v2_plugins::COMPACT_MESSAGE_HEADER_LENGTH;
+    messages.push_back({
+        message->topic_name, message->time_stamp,
+        std::vector<uint8_t>(data, serialized_data.buffer + serialized_data.buffer_length)});
+  }
+  return messages;
+}
+
+std::vector<Message> read_messages(rosbag::View & view)
+{
+  std::vector<Message> messages;
+  for (const auto & message_instance : view) {
+    std::vector<uint8_t> data(message_instance.size());
+    ros::serialization::OStream stream(data.data(), static_cast<uint32_t>(data.size()));
+    message_instance.write(stream);
+    messages.push_back({
+        message_instance.getTopic(),
+        static_cast<rcutils_time_point_value_t>(message_instance.getTime().toNSec()),
+        std::move(data)});
+  }
+  return messages;
+}
+
+/// Reading options which read chunks ahead, evict them from the cache or map the bag
+std::vector<RosbagV2StorageOptions> get_reading_options()
+{
+  std::vector<RosbagV2StorageOptions> reading_options(4);
+  reading_options[1].prefetch_chunks = 4;
+  reading_options[1].prefetch_threads = 2;
+  reading_options[2].chunk_cache_chunks = 2;
+  reading_options[3].memory_map = true;
+  reading_options[3].prefetch_chunks = 2;
+  return reading_options;
+}
+
+}  // namespace
+
+class CompressedBagTestFixture : public TemporaryDirectoryFixture
+{
+public:
+  std::string write_bag(rosbag::compression::CompressionType compression)
+  {
+    auto path = (rcpputils::fs::path(temporary_dir_path_) /
+      ("compressed_" + std::to_string(static_cast<int>(compression)) + ".bag")).string();
+    rosbag::Bag bag;
+    bag.open(path, rosbag::bagmode::Write);
+    bag.setCompression(compression);
+    bag.setChunkThreshold(CHUNK_THRESHOLD);
+
+    // rosbag_storage creates a connection per distinct connection header of a topic
+    std::vector<boost::shared_ptr<ros::M_string>> connection_headers;
+    for (const auto & writer : {"/writer_0", "/writer_1"}) {
+      auto header = boost::make_shared<ros::M_string>();
+      (*header)["callerid"] = writer;
+      (*header)["type"] = ros::message_traits::datatype<std_msgs::String>();
+      (*header)["md5sum"] = ros::message_traits::md5sum<std_msgs::String>();
+      (*header)["message_definition"] = ros::message_traits::definition<std_msgs::String>();
+      connection_headers.push_back(header);
+    }
+
+    std_msgs::String message;
+    for (uint64_t i = 0; i < MESSAGE_COUNT; ++i) {
+      auto topic = i % 3 == 2 && i >= SPARSE_TOPIC_MESSAGE_COUNT ?
+        std::string("/topic_0") : "/topic_" + std::to_string(i % 3);
+      message.data = "message " + std::to_string(i) + std::string(i % 50, static_cast<char>('a' + i % 26));
+      bag.write(
+        topic, ros::Time().fromNSec(static_cast<uint64_t>(get_time_stamp(i))), message,
+        connection_headers[i % connection_headers.size()]);
+    }
+    bag.close();
+    return path;
+  }
+
+  std::shared_ptr<RosbagV2Storage> open_storage(
+    const std::string & path, const RosbagV2StorageOptions & options)
+  {
+    auto storage = std::make_shared<RosbagV2Storage>();
+    storage->set_options(options);
+    storage->open(path, rosbag2_storage::storage_interfaces::IOFlag::READ_ONLY);
+    return storage;
+  }
+};
+
+TEST_F(CompressedBagTestFixture, read_next_reads_the_messages_of_a_view)
+{
+  for (auto compression : {rosbag::compression::BZ2, rosbag::compression::LZ4}) {
+    auto path = write_bag(compression);
+    ASSERT_THAT(count_chunks_overlapping_their_predecessor(path), Gt(MESSAGE_COUNT / 32));
+    rosbag::Bag bag;
+    bag.open(path);
+    rosbag::View view(bag);
+    auto expected_messages = read_messages(view);
+    ASSERT_THAT(expected_messages, SizeIs(MESSAGE_COUNT));
+
+    for (const auto & options : get_reading_options()) {
+      auto storage = open_storage(path, options);
+      EXPECT_THAT(read_messages(*storage), ElementsAreArray(expected_messages));
+    }
+    bag.close();
+  }
+}
+
+TEST_F(CompressedBagTestFixture, seek_reads_the_messages_of_a_view_starting_at_the_time)
+{
+  for (auto compression : {rosbag::compression::BZ2, rosbag::compression::LZ4}) {
+    auto path = write_bag(compression);
+    rosbag::Bag bag;
+    bag.open(path);
+
+    for (const auto & options : get_reading_options()) {
+      auto storage = open_storage(path, options);
+      // Seeking back and forth reads chunks from the cache or evicts them
+      for (uint64_t message_index : {300u, 10u, 511u, 150u, 0u, 151u}) {
+        auto seek_time = get_time_stamp(message_index);
+        rosbag::View view(bag, ros::Time().fromNSec(static_cast<uint64_t>(seek_time)));
+
+        storage->seek(seek_time);
+
+        EXPECT_THAT(read_messages(*storage), ElementsAreArray(read_messages(view)));
+      }
+    }
+    bag.close();
+  }
+}
+
+TEST_F(CompressedBagTestFixture, set_filter_reads_the_messages_of_a_view_of_the_topics)
+{
+  for (auto compression : {rosbag::compression::BZ2, rosbag::compression::LZ4}) {
+    auto path = write_bag(compression);
+    rosbag::Bag bag;
+    bag.open(path);
+
+    for (const auto & options : get_reading_options()) {
+      for (const auto & topics : std::vector<std::vector<std::string>>{
+          {"/topic_2"}, {"/topic_0", "/topic_1"}})
+      {
+        rosbag::View view(bag, rosbag::TopicQuery(topics));
+        auto storage = open_storage(path, options);
+
+        storage->set_filter(topics);
+
+        EXPECT_THAT(read_messages(*storage), ElementsAreArray(read_messages(view)));
+      }
+    }
+    bag.close();
+  }
+}
+
+TEST_F(CompressedBagTestFixture, set_filter_after_reading_continues_like_a_view_of_the_topics)
+{
+  for (auto compression : {rosbag::compression::BZ2, rosbag::compression::LZ4}) {
+    auto path = write_bag(compression);
+    rosbag::Bag bag;
+    bag.open(path);
+    std::vector<std::string> topics = {"/topic_1"};
+
+    for (const auto & options : get_reading_options()) {
+      auto storage = open_storage(path, options);
+      rcutils_time_point_value_t last_time_stamp = 0;
+      for (size_t i = 0; i < MESSAGE_COUNT / 2; ++i) {
+        ASSERT_TRUE(storage->has_next());
+        last_time_stamp = storage->read_next()->time_stamp;
+      }
+
+      storage->set_filter(topics);
+
+      // The time stamps are unique, so the view starts right after the message read last
+      rosbag::View view(
+        bag, rosbag::TopicQuery(topics),
+        ros::Time().fromNSec(static_cast<uint64_t>(last_time_stamp + 1)));
+      EXPECT_THAT(read_messages(*storage), ElementsAreArray(read_messages(view)));
+    }
+    bag.close();
+  }
+}
@@ -0,0 +1,90 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <gmock/gmock.h>
+
+#include <array>
+#include <string>
+
+#include "rosbag2_bag_v2_plugins/converter_registry.hpp"
+
+using namespace ::testing;  // NOLINT
+using rosbag2_bag_v2_plugins::ConverterTableEntry;
+
+namespace
+{
+
+void convert_first(ros::serialization::IStream &, void *) {}
+
+void convert_second(ros::serialization::IStream &, void *) {}
+
+const rosbag2_bag_v2_plugins::CdrTranscoderPlan first_plan = {nullptr, 0};
+
+// Registered out of order and by two packages, as the generated code of each package may be
+// loaded in any order
+const std::array<ConverterTableEntry, 2> test_package_table = {{
+    {"test_registry_msgs/Second", "test_registry_msgs/msg/Second", &convert_second, nullptr},
+    {"test_registry_msgs/First", "test_registry_msgs/msg/First", &convert_first, &first_plan},
+  }};
+const std::array<ConverterTableEntry, 1> other_package_table = {{
+    {"other_registry_msgs/First", "other_registry_msgs/msg/Renamed", &convert_second, nullptr},
+  }};
+
+class ConverterRegistryTest : public Test
+{
+public:
+  static void SetUpTestCase()
+  {
+    rosbag2_bag_v2_plugins::register_converters(
+      "test_registry_msgs", test_package_table.data(), test_package_table.size());
+    rosbag2_bag_v2_plugins::register_converters(
+      "other_registry_msgs", other_package_table.data(), other_package_table.size());
+  }
+};
+
+}  // namespace
+
+TEST_F(ConverterRegistryTest, registered_converters_are_found_by_their_type_names)
+{
+  EXPECT_THAT(
+    rosbag2_bag_v2_plugins::get_1to2_converter(
+      "test_registry_msgs/First", "test_registry_msgs/msg/First"), Eq(&convert_first));
+  EXPECT_THAT(
+    rosbag2_bag_v2_plugins::get_1to2_converter(
+      "test_registry_msgs/Second", "test_registry_msgs/msg/Second"), Eq(&convert_second));
+  EXPECT_THAT(
+    rosbag2_bag_v2_plugins::get_1to2_converter(
+      "other_registry_msgs/First", "other_registry_msgs/msg/Renamed"), Eq(&convert_second));
+}
+
+TEST_F(ConverterRegistryTest, cdr_plans_are_found_for_the_mappings_which_have_one)
+{
+  EXPECT_THAT(
+    rosbag2_bag_v2_plugins::get_1to2_cdr_plan(
+      "test_registry_msgs/First", "test_registry_msgs/msg/First"), Eq(&first_plan));
+  EXPECT_THAT(
+    rosbag2_bag_v2_plugins::get_1to2_cdr_plan(
+      "test_registry_msgs/Second", "test_registry_msgs/msg/Second"), IsNull());
+}
+
+TEST_F(ConverterRegistryTest, converters_are_only_found_for_the_registered_ros2_type)
+{
+  EXPECT_THAT(
+    rosbag2_bag_v2_plugins::get_1to2_converter(
+      "test_registry_msgs/First", "test_registry_msgs/msg/Second"), IsNull());
+  EXPECT_THAT(
+    rosbag2_bag_v2_plugins::get_1to2_converter(
+      "unregistered_msgs/First", "unregistered_msgs/msg/First"), IsNull());
+}
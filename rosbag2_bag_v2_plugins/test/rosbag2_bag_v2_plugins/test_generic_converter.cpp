@@ -0,0 +1,374 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+
+#include <gmock/gmock.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ros/serialization.h"
+#include "rosidl_typesupport_introspection_cpp/field_types.hpp"
+#include "rosidl_typesupport_introspection_cpp/message_introspection.hpp"
+
+#include "rosbag2_bag_v2_plugins/generic_converter.hpp"
+#include "rosbag2_bag_v2_plugins/ros1_message_definition.hpp"
+
+using namespace ::testing;  // NOLINT
+using rosbag2_bag_v2_plugins::GenericConverter;
+using rosbag2_bag_v2_plugins::parse_ros1_message_definition;
+using rosidl_typesupport_introspection_cpp::MessageMember;
+using rosidl_typesupport_introspection_cpp::MessageMembers;
+
+namespace
+{
+namespace types = rosidl_typesupport_introspection_cpp;
+
+class ByteWriter
+{
+public:
+  ByteWriter & uint8(uint8_t value)
+  {
+    bytes.push_back(value);
+    return *this;
+  }
+
+  ByteWriter & uint32(uint32_t value)
+  {
+    return little_endian(value, 4);
+  }
+
+  ByteWriter & float32(float value)
+  {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return uint32(bits);
+  }
+
+  ByteWriter & float64(double value)
+  {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return little_endian(bits, 8);
+  }
+
+  ByteWriter & string(const std::string & value)
+  {
+    uint32(static_cast<uint32_t>(value.size()));
+    bytes.insert(bytes.end(), value.begin(), value.end());
+    return *this;
+  }
+
+  std::vector<uint8_t> bytes;
+
+private:
+  ByteWriter & little_endian(uint64_t value, size_t size)
+  {
+    for (size_t i = 0; i < size; ++i) {
+      bytes.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+    return *this;
+  }
+};
+
+// ROS 2 messages as generated, with their introspection type support written out by hand
+struct Time
+{
+  int32_t sec;
+  uint32_t nanosec;
+};
+
+struct Header
+{
+  Time stamp;
+  std::string frame_id;
+};
+
+struct Point
+{
+  double x;
+  double y;
+};
+
+struct Status
+{
+  Header header;
+  uint8_t level;
+  int64_t count;
+  std::vector<Point> points;
+  std::array<float, 2> gains;
+  std::vector<bool> flags;
+  std::vector<std::string> names;
+  std::string only_in_ros2;
+};
+
+template<typename T>
+void resize_vector(void * vector, size_t size)
+{
+  static_cast<std::vector<T> *>(vector)->resize(size);
+}
+
+template<typename T>
+void * get_vector_element(void * vector, size_t index)
+{
+  return &(*static_cast<std::vector<T> *>(vector))[index];
+}
+
+MessageMember make_member(
+  const char * name, uint8_t type_id, size_t offset,
+  const rosidl_message_type_support_t * members = nullptr)
+{
+  MessageMember member{};
+  member.name_ = name;
+  member.type_id_ = type_id;
+  member.members_ = members;
+  member.offset_ = static_cast<uint32_t>(offset);
+  return member;
+}
+
+template<typename T>
+MessageMember make_sequence_member(
+  const char * name, uint8_t type_id, size_t offset,
+  const rosidl_message_type_support_t * members = nullptr)
+{
+  auto member = make_member(name, type_id, offset, members);
+  member.is_array_ = true;
+  member.get_function = &get_vector_element<T>;
+  member.resize_function = &resize_vector<T>;
+  return member;
+}
+
+// std::vector<bool> has no elements to point to
+MessageMember make_bool_sequence_member(const char * name, size_t offset)
+{
+  auto member = make_member(name, types::ROS_TYPE_BOOLEAN, offset);
+  member.is_array_ = true;
+  member.resize_function = &resize_vector<bool>;
+  return member;
+}
+
+const MessageMember time_member_array[] = {
+  make_member("sec", types::ROS_TYPE_INT32, offsetof(Time, sec)),
+  make_member("nanosec", types::ROS_TYPE_UINT32, offsetof(Time, nanosec))};
+const MessageMembers time_members{
+  "builtin_interfaces::msg", "Time", 2, sizeof(Time), time_member_array, nullptr, nullptr};
+const rosidl_message_type_support_t time_type_support{
+  "rosidl_typesupport_introspection_cpp", &time_members, nullptr};
+
+const MessageMember header_member_array[] = {
+  make_member("stamp", types::ROS_TYPE_MESSAGE, offsetof(Header, stamp), &time_type_support),
+  make_member("frame_id", types::ROS_TYPE_STRING, offsetof(Header, frame_id))};
+const MessageMembers header_members{
+  "std_msgs::msg", "Header", 2, sizeof(Header), header_member_array, nullptr, nullptr};
+const rosidl_message_type_support_t header_type_support{
+  "rosidl_typesupport_introspection_cpp", &header_members, nullptr};
+
+const MessageMember point_member_array[] = {
+  make_member("x", types::ROS_TYPE_DOUBLE, offsetof(Point, x)),
+  make_member("y", types::ROS_TYPE_DOUBLE, offsetof(Point, y))};
+const MessageMembers point_members{
+  "test_msgs::msg", "Point", 2, sizeof(Point), point_member_array, nullptr, nullptr};
+const rosidl_message_type_support_t point_type_support{
+  "rosidl_typesupport_introspection_cpp", &point_members, nullptr};
+
+MessageMember make_gains_member()
+{
+  auto member = make_member("gains", types::ROS_TYPE_FLOAT, offsetof(Status, gains));
+  member.is_array_ = true;
+  member.array_size_ = 2;
+  return member;
+}
+
+const MessageMember status_member_array[] = {
+  make_member("header", types::ROS_TYPE_MESSAGE, offsetof(Status, header), &header_type_support),
+  make_member("level", types::ROS_TYPE_UINT8, offsetof(Status, level)),
+  make_member("count", types::ROS_TYPE_INT64, offsetof(Status, count)),
+  make_sequence_member<Point>(
+    "points", types::ROS_TYPE_MESSAGE, offsetof(Status, points), &point_type_support),
+  make_gains_member(),
+  make_bool_sequence_member("flags", offsetof(Status, flags)),
+  make_sequence_member<std::string>("names", types::ROS_TYPE_STRING, offsetof(Status, names)),
+  make_member("only_in_ros2", types::ROS_TYPE_STRING, offsetof(Status, only_in_ros2))};
+const MessageMembers status_members{
+  "test_msgs::msg", "Status", 8, sizeof(Status), status_member_array, nullptr, nullptr};
+const rosidl_message_type_support_t status_type_support{
+  "rosidl_typesupport_introspection_cpp", &status_members, nullptr};
+
+const char status_definition[] =
+  "Header header\n"
+  "uint8 OK=0\n"
+  "uint8 level\n"
+  "int32 count\n"
+  "Point[] points\n"
+  "float32[2] gains\n"
+  "bool[] flags\n"
+  "string[] names\n"
+  "string only_in_ros1\n"
+  "Point[2] corners_only_in_ros1\n"
+  "================================================================================\n"
+  "MSG: std_msgs/Header\n"
+  "uint32 seq\n"
+  "time stamp\n"
+  "string frame_id\n"
+  "================================================================================\n"
+  "MSG: test_msgs/Point\n"
+  "float64 x\n"
+  "float64 y\n";
+
+// Messages without fields take no space in ROS 1, but get a placeholder member in ROS 2
+struct Empty
+{
+  uint8_t structure_needs_at_least_one_member;
+};
+
+struct Events
+{
+  std::vector<Empty> empties;
+  uint8_t level;
+};
+
+const MessageMember empty_member_array[] = {
+  make_member(
+    "structure_needs_at_least_one_member", types::ROS_TYPE_UINT8,
+    offsetof(Empty, structure_needs_at_least_one_member))};
+const MessageMembers empty_members{
+  "test_msgs::msg", "Empty", 1, sizeof(Empty), empty_member_array, nullptr, nullptr};
+const rosidl_message_type_support_t empty_type_support{
+  "rosidl_typesupport_introspection_cpp", &empty_members, nullptr};
+
+const MessageMember events_member_array[] = {
+  make_sequence_member<Empty>(
+    "empties", types::ROS_TYPE_MESSAGE, offsetof(Events, empties), &empty_type_support),
+  make_member("level", types::ROS_TYPE_UINT8, offsetof(Events, level))};
+const MessageMembers events_members{
+  "test_msgs::msg", "Events", 2, sizeof(Events), events_member_array, nullptr, nullptr};
+const rosidl_message_type_support_t events_type_support{
+  "rosidl_typesupport_introspection_cpp", &events_members, nullptr};
+
+std::vector<uint8_t> make_ros1_status()
+{
+  return ByteWriter()
+         .uint32(42).uint32(7).uint32(500).string("base")  // header
+         .uint8(2)  // level
+         .uint32(static_cast<uint32_t>(-3))  // count
+         .uint32(2).float64(1.5).float64(2.5).float64(3.5).float64(4.5)  // points
+         .float32(0.25f).float32(0.75f)  // gains
+         .uint32(3).uint8(1).uint8(0).uint8(1)  // flags
+         .uint32(2).string("a").string("bc")  // names
+         .string("skipped")  // only_in_ros1
+         .float64(0).float64(0).float64(0).float64(0)  // corners_only_in_ros1
+         .bytes;
+}
+
+std::unique_ptr<GenericConverter> make_status_converter()
+{
+  return std::make_unique<GenericConverter>(
+    "test_msgs/Status", parse_ros1_message_definition("test_msgs/Status", status_definition),
+    &status_type_support);
+}
+}  // namespace
+
+TEST(GenericConverter, converts_fields_of_the_same_name)
+{
+  auto converter = make_status_converter();
+  auto bytes = make_ros1_status();
+  ros::serialization::IStream stream(bytes.data(), static_cast<uint32_t>(bytes.size()));
+  Status status;
+  status.only_in_ros2 = "kept";
+
+  converter->convert(stream, &status);
+
+  EXPECT_THAT(stream.getLength(), Eq(0u));
+  EXPECT_THAT(status.header.stamp.sec, Eq(7));
+  EXPECT_THAT(status.header.stamp.nanosec, Eq(500u));
+  EXPECT_THAT(status.header.frame_id, Eq("base"));
+  EXPECT_THAT(status.level, Eq(2));
+  EXPECT_THAT(status.count, Eq(-3));
+  ASSERT_THAT(status.points, SizeIs(2));
+  EXPECT_THAT(status.points[0].x, Eq(1.5));
+  EXPECT_THAT(status.points[1].y, Eq(4.5));
+  EXPECT_THAT(status.gains, ElementsAre(0.25f, 0.75f));
+  EXPECT_THAT(status.flags, ElementsAre(true, false, true));
+  EXPECT_THAT(status.names, ElementsAre("a", "bc"));
+  EXPECT_THAT(status.only_in_ros2, Eq("kept"));
+}
+
+TEST(GenericConverter, reused_messages_are_overwritten)
+{
+  auto converter = make_status_converter();
+  auto bytes = make_ros1_status();
+  Status status;
+  status.points.resize(5);
+  status.names = {"x", "y", "z"};
+
+  ros::serialization::IStream stream(bytes.data(), static_cast<uint32_t>(bytes.size()));
+  converter->convert(stream, &status);
+
+  EXPECT_THAT(status.points, SizeIs(2));
+  EXPECT_THAT(status.names, ElementsAre("a", "bc"));
+}
+
+TEST(GenericConverter, truncated_messages_throw)
+{
+  auto converter = make_status_converter();
+  auto bytes = make_ros1_status();
+  bytes.resize(bytes.size() - 1);
+  ros::serialization::IStream stream(bytes.data(), static_cast<uint32_t>(bytes.size()));
+  Status status;
+
+  EXPECT_THROW(converter->convert(stream, &status), ros::serialization::StreamOverrunException);
+}
+
+TEST(GenericConverter, fields_which_do_not_fit_the_ros2_member_throw)
+{
+  auto definitions = parse_ros1_message_definition(
+    "test_msgs/Point", "string x\nfloat64 y\n");
+  EXPECT_THROW(GenericConverter("test_msgs/Point", definitions, &point_type_support),
+    std::runtime_error);
+
+  definitions = parse_ros1_message_definition("test_msgs/Point", "float64[] x\nfloat64 y\n");
+  EXPECT_THROW(GenericConverter("test_msgs/Point", definitions, &point_type_support),
+    std::runtime_error);
+
+  // Unknown message types cannot even be skipped
+  definitions = parse_ros1_message_definition("test_msgs/Point", "Unknown x\n");
+  EXPECT_THROW(GenericConverter("test_msgs/Point", definitions, &point_type_support),
+    std::runtime_error);
+}
+
+TEST(GenericConverter, converts_sequences_of_messages_without_fields)
+{
+  auto definitions = parse_ros1_message_definition(
+    "test_msgs/Events",
+    "Empty[] empties\n"
+    "uint8 level\n"
+    "================================================================================\n"
+    "MSG: test_msgs/Empty\n");
+  GenericConverter converter("test_msgs/Events", definitions, &events_type_support);
+  auto bytes = ByteWriter().uint32(3).uint8(4).bytes;
+  ros::serialization::IStream stream(bytes.data(), static_cast<uint32_t>(bytes.size()));
+  Events events;
+
+  converter.convert(stream, &events);
+
+  EXPECT_THAT(events.empties, SizeIs(3));
+  EXPECT_THAT(events.level, Eq(4));
+}
@@ -0,0 +1,89 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gmock/gmock.h>
+
+#include <cstring>
+#include <memory>
+
+#include "rosbag2_bag_v2_plugins/storage/message_pool.hpp"
+
+using namespace ::testing;  // NOLINT
+
+TEST(MessagePool, released_buffers_are_reused)
+{
+  rosbag2_bag_v2_plugins::MessagePool pool(1024 * 1024);
+
+  auto buffer = pool.make_buffer(100);
+  EXPECT_THAT(buffer->buffer_capacity, Ge(100u));
+  EXPECT_THAT(buffer->buffer_length, Eq(0u));
+  auto first_data = buffer->buffer;
+  buffer.reset();
+  EXPECT_THAT(pool.get_statistics().bytes_held, Gt(0u));
+
+  auto hits = pool.get_statistics().hits;
+  buffer = pool.make_buffer(90);
+  EXPECT_THAT(buffer->buffer, Eq(first_data));
+  EXPECT_THAT(pool.get_statistics().hits, Gt(hits));
+}
+
+TEST(MessagePool, steady_state_allocations_are_all_served_by_the_pool)
+{
+  rosbag2_bag_v2_plugins::MessagePool pool(1024 * 1024);
+  for (int i = 0; i < 10; ++i) {
+    auto message = pool.make_message();
+    message->serialized_data = pool.make_buffer(200);
+  }
+
+  auto misses = pool.get_statistics().misses;
+  for (int i = 0; i < 10; ++i) {
+    auto message = pool.make_message();
+    message->serialized_data = pool.make_buffer(200);
+  }
+  EXPECT_THAT(pool.get_statistics().misses, Eq(misses));
+  EXPECT_THAT(pool.get_statistics().hit_rate(), Gt(0.5));
+}
+
+TEST(MessagePool, memory_beyond_max_bytes_held_is_freed)
+{
+  rosbag2_bag_v2_plugins::MessagePool pool(128);
+
+  pool.make_buffer(1000);
+
+  EXPECT_THAT(pool.get_statistics().bytes_held, Le(128u));
+  EXPECT_THAT(pool.get_statistics().bytes_discarded, Ge(1000u));
+}
+
+TEST(MessagePool, buffers_stay_valid_after_the_pool_is_destroyed)
+{
+  auto pool = std::make_unique<rosbag2_bag_v2_plugins::MessagePool>(1024 * 1024);
+  auto buffer = pool->make_buffer(16);
+  pool.reset();
+
+  memset(buffer->buffer, 42, 16);
+  EXPECT_THAT(buffer->buffer[15], Eq(42));
+}
+
+TEST(MessagePool, buffers_can_be_resized_with_their_allocator)
+{
+  rosbag2_bag_v2_plugins::MessagePool pool(1024 * 1024);
+  auto buffer = pool.make_buffer(16);
+  buffer->buffer_length = 16;
+  memset(buffer->buffer, 42, 16);
+
+  ASSERT_THAT(rcutils_uint8_array_resize(buffer.get(), 1000), Eq(RCUTILS_RET_OK));
+
+  EXPECT_THAT(buffer->buffer_capacity, Eq(1000u));
+  EXPECT_THAT(buffer->buffer[15], Eq(42));
+}
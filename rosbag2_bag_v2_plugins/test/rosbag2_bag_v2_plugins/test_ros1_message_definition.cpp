@@ -0,0 +1,96 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+
+#include <gmock/gmock.h>
+
+#include <stdexcept>
+#include <string>
+
+#include "rosbag2_bag_v2_plugins/ros1_message_definition.hpp"
+
+using namespace ::testing;  // NOLINT
+using rosbag2_bag_v2_plugins::Ros1ArrayKind;
+using rosbag2_bag_v2_plugins::parse_ros1_message_definition;
+
+namespace
+{
+const char status_definition[] =
+  "# An example status\n"
+  "Header header\n"
+  "uint8 OK=0  # constants are not serialized\n"
+  "string NAME=a=b\n"
+  "uint8 level\n"
+  "Point[] points\n"
+  "float32[2] gains  # in percent\n"
+  "\n"
+  "================================================================================\n"
+  "MSG: std_msgs/Header\n"
+  "uint32 seq\n"
+  "time stamp\n"
+  "string frame_id\n"
+  "================================================================================\n"
+  "MSG: test_msgs/Point\n"
+  "float64 x\n"
+  "float64 y\n";
+}  // namespace
+
+TEST(Ros1MessageDefinition, parses_the_fields_of_all_message_types)
+{
+  auto definitions = parse_ros1_message_definition("test_msgs/Status", status_definition);
+
+  ASSERT_THAT(definitions, SizeIs(3));
+  const auto & status = definitions.at("test_msgs/Status");
+  EXPECT_THAT(status.type_name, Eq("test_msgs/Status"));
+  ASSERT_THAT(status.fields, SizeIs(4));
+  EXPECT_THAT(status.fields[0].type, Eq("std_msgs/Header"));
+  EXPECT_THAT(status.fields[0].name, Eq("header"));
+  EXPECT_THAT(status.fields[0].array_kind, Eq(Ros1ArrayKind::NONE));
+  EXPECT_THAT(status.fields[1].type, Eq("uint8"));
+  EXPECT_THAT(status.fields[1].name, Eq("level"));
+  EXPECT_THAT(status.fields[2].type, Eq("test_msgs/Point"));
+  EXPECT_THAT(status.fields[2].array_kind, Eq(Ros1ArrayKind::SEQUENCE));
+  EXPECT_THAT(status.fields[3].type, Eq("float32"));
+  EXPECT_THAT(status.fields[3].array_kind, Eq(Ros1ArrayKind::FIXED_SIZE));
+  EXPECT_THAT(status.fields[3].array_size, Eq(2u));
+
+  const auto & header = definitions.at("std_msgs/Header");
+  ASSERT_THAT(header.fields, SizeIs(3));
+  EXPECT_THAT(header.fields[1].type, Eq("time"));
+  EXPECT_THAT(header.fields[2].type, Eq("string"));
+  EXPECT_THAT(definitions.at("test_msgs/Point").fields, SizeIs(2));
+}
+
+TEST(Ros1MessageDefinition, resolves_message_types_of_the_same_package)
+{
+  auto definitions = parse_ros1_message_definition(
+    "test_msgs/Path", "geometry_msgs/Pose[] poses\nPoint origin\n");
+
+  const auto & path = definitions.at("test_msgs/Path");
+  ASSERT_THAT(path.fields, SizeIs(2));
+  EXPECT_THAT(path.fields[0].type, Eq("geometry_msgs/Pose"));
+  EXPECT_THAT(path.fields[1].type, Eq("test_msgs/Point"));
+}
+
+TEST(Ros1MessageDefinition, throws_on_malformed_fields)
+{
+  EXPECT_THROW(
+    parse_ros1_message_definition("test_msgs/Status", "uint8\n"), std::runtime_error);
+  EXPECT_THROW(
+    parse_ros1_message_definition("test_msgs/Status", "uint8[x] values\n"), std::runtime_error);
+  EXPECT_THROW(
+    parse_ros1_message_definition("test_msgs/Status", "uint8 a\n====\nuint8 b\n"),
+    std::runtime_error);
+}
@@ -0,0 +1,212 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <gmock/gmock.h>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ros/serialization.h"
+
+#include "rosbag2_bag_v2_plugins/ros1_wire_reader.hpp"
+
+using namespace ::testing;  // NOLINT
+using rosbag2_bag_v2_plugins::Ros1WireReader;
+
+namespace
+{
+
+class ByteWriter
+{
+public:
+  ByteWriter & uint8(uint8_t value)
+  {
+    bytes.push_back(value);
+    return *this;
+  }
+
+  ByteWriter & uint16(uint16_t value)
+  {
+    bytes.push_back(static_cast<uint8_t>(value));
+    bytes.push_back(static_cast<uint8_t>(value >> 8));
+    return *this;
+  }
+
+  ByteWriter & uint32(uint32_t value)
+  {
+    for (size_t i = 0; i < 4; ++i) {
+      bytes.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+    return *this;
+  }
+
+  ByteWriter & characters(const std::string & value)
+  {
+    bytes.insert(bytes.end(), value.begin(), value.end());
+    return *this;
+  }
+
+  std::vector<uint8_t> bytes;
+};
+
+struct Time
+{
+  int32_t sec;
+  uint32_t nanosec;
+};
+
+void read_time(Ros1WireReader & reader, Time & time)
+{
+  rosbag2_bag_v2_plugins::read_ros1_time(reader, time);
+}
+
+// Like std_msgs/Empty
+struct Empty
+{
+  uint8_t structure_needs_at_least_one_member;
+};
+
+void read_empty(Ros1WireReader &, Empty &) {}
+
+}  // namespace
+
+TEST(Ros1WireReader, reads_primitives_and_strings)
+{
+  auto bytes = ByteWriter().uint32(7).uint16(300).uint8(2).uint32(2).characters("ab").bytes;
+  ros::serialization::IStream stream(bytes.data(), static_cast<uint32_t>(bytes.size()));
+  Ros1WireReader reader(stream);
+
+  uint32_t number;
+  uint16_t short_number;
+  bool flag;
+  std::string text;
+  reader.read(number);
+  reader.read(short_number);
+  reader.read(flag);
+  reader.read(text);
+
+  EXPECT_THAT(number, Eq(7u));
+  EXPECT_THAT(short_number, Eq(300u));
+  EXPECT_TRUE(flag);
+  EXPECT_THAT(text, StrEq("ab"));
+  EXPECT_THAT(stream.getLength(), Eq(0u));
+}
+
+TEST(Ros1WireReader, reads_primitive_sequences_and_fixed_size_arrays)
+{
+  auto bytes = ByteWriter().uint32(3).uint16(1).uint16(2).uint16(3).uint32(4).uint32(5).bytes;
+  ros::serialization::IStream stream(bytes.data(), static_cast<uint32_t>(bytes.size()));
+  Ros1WireReader reader(stream);
+
+  std::vector<uint16_t> sequence;
+  std::array<uint32_t, 2> array;
+  reader.read(sequence);
+  reader.read(array);
+
+  EXPECT_THAT(sequence, ElementsAre(1, 2, 3));
+  EXPECT_THAT(array, ElementsAre(4u, 5u));
+}
+
+TEST(Ros1WireReader, keeps_the_capacity_of_reused_sequences)
+{
+  auto bytes = ByteWriter().uint32(2).uint8(1).uint8(2).uint32(2).uint8(3).uint8(4).bytes;
+  ros::serialization::IStream stream(bytes.data(), static_cast<uint32_t>(bytes.size()));
+  Ros1WireReader reader(stream);
+
+  std::vector<uint8_t> data;
+  reader.read(data);
+  auto buffer = data.data();
+  reader.read(data);
+
+  EXPECT_THAT(data, ElementsAre(3, 4));
+  EXPECT_THAT(data.data(), Eq(buffer));
+}
+
+TEST(Ros1WireReader, reads_sequences_of_strings_bools_and_messages)
+{
+  auto bytes = ByteWriter()
+    .uint32(2).uint32(1).characters("a").uint32(0)
+    .uint32(2).uint8(0).uint8(5)
+    .uint32(1).uint32(3).uint32(4).bytes;
+  ros::serialization::IStream stream(bytes.data(), static_cast<uint32_t>(bytes.size()));
+  Ros1WireReader reader(stream);
+
+  std::vector<std::string> strings;
+  std::vector<bool> bools;
+  std::vector<Time> times;
+  reader.read(strings);
+  reader.read(bools);
+  reader.read_messages(times, &read_time, 8);
+
+  EXPECT_THAT(strings, ElementsAre("a", ""));
+  EXPECT_THAT(bools, ElementsAre(false, true));
+  ASSERT_THAT(times, SizeIs(1));
+  EXPECT_THAT(times[0].sec, Eq(3));
+  EXPECT_THAT(times[0].nanosec, Eq(4u));
+}
+
+TEST(Ros1WireReader, reads_sequences_of_messages_without_fields)
+{
+  auto bytes = ByteWriter().uint32(3).bytes;
+  ros::serialization::IStream stream(bytes.data(), static_cast<uint32_t>(bytes.size()));
+  Ros1WireReader reader(stream);
+
+  std::vector<Empty> empties;
+  reader.read_messages(empties, &read_empty, 0);
+
+  EXPECT_THAT(empties, SizeIs(3));
+}
+
+TEST(Ros1WireReader, skips_fields_which_only_exist_in_ros1)
+{
+  auto bytes = ByteWriter()
+    .uint32(7)
+    .uint32(2).uint16(1).uint16(2)
+    .uint32(1).characters("a").uint32(2).characters("bc")
+    .uint8(9).bytes;
+  ros::serialization::IStream stream(bytes.data(), static_cast<uint32_t>(bytes.size()));
+  Ros1WireReader reader(stream);
+
+  reader.skip(4);
+  reader.skip_sequence(2);
+  reader.skip_strings(2);
+  uint8_t last;
+  reader.read(last);
+
+  EXPECT_THAT(last, Eq(9));
+}
+
+TEST(Ros1WireReader, throws_on_truncated_messages)
+{
+  auto bytes = ByteWriter().uint32(3).uint8(1).bytes;
+  ros::serialization::IStream stream(bytes.data(), static_cast<uint32_t>(bytes.size()));
+  Ros1WireReader reader(stream);
+
+  std::vector<uint16_t> sequence;
+  EXPECT_THROW(reader.read(sequence), ros::serialization::StreamOverrunException);
+}
+
+TEST(Ros1WireReader, does_not_allocate_for_lengths_beyond_the_message)
+{
+  auto bytes = ByteWriter().uint32(0xffffffff).bytes;
+  ros::serialization::IStream stream(bytes.data(), static_cast<uint32_t>(bytes.size()));
+  Ros1WireReader reader(stream);
+
+  std::vector<std::string> strings;
+  EXPECT_THROW(reader.read(strings), ros::serialization::StreamOverrunException);
+  EXPECT_THAT(strings, IsEmpty());
+}
@@ -17,11 +17,56 @@
 #include <memory>
 #include <string>
 
+#include "rcpputils/filesystem_helper.hpp"
+#include "rcutils/allocator.h"
+#include "rosbag/bag.h"
+#include "rosbag/view.h"
+
+#include "../../src/rosbag2_bag_v2_plugins/converter_handle.hpp"
+#include "../../src/rosbag2_bag_v2_plugins/message_type_header.hpp"
 #include "../../src/rosbag2_bag_v2_plugins/storage/rosbag_output_stream.hpp"
 
 using namespace ::testing;  // NOLINT
 using RosbagOutputStream = rosbag2_bag_v2_plugins::RosbagOutputStream;
 
+namespace
+{
+
+struct AllocationCount
+{
+  size_t allocations = 0;
+  rcutils_allocator_t default_allocator = rcutils_get_default_allocator();
+};
+
+rcutils_allocator_t make_counting_allocator(AllocationCount & count)
+{
+  rcutils_allocator_t allocator = count.default_allocator;
+  allocator.allocate = [](size_t size, void * state) {
+      auto count = static_cast<AllocationCount *>(state);
+      ++count->allocations;
+      return count->default_allocator.allocate(size, count->default_allocator.state);
+    };
+  allocator.reallocate = [](void * pointer, size_t size, void * state) {
+      auto count = static_cast<AllocationCount *>(state);
+      ++count->allocations;
+      return count->default_allocator.reallocate(pointer, size, count->default_allocator.state);
+    };
+  allocator.zero_allocate = [](size_t number_of_elements, size_t size_of_element, void * state) {
+      auto count = static_cast<AllocationCount *>(state);
+      ++count->allocations;
+      return count->default_allocator.zero_allocate(
+        number_of_elements, size_of_element, count->default_allocator.state);
+    };
+  allocator.deallocate = [](void * pointer, void * state) {
+      auto count = static_cast<AllocationCount *>(state);
+      count->default_allocator.deallocate(pointer, count->default_allocator.state);
+    };
+  allocator.state = &count;
+  return allocator;
+}
+
+}  // namespace
+
 TEST(RosbagOutputStream, constructor_correctly_initializes_ros_message_type)
 {
   auto rosbag_output_stream = RosbagOutputStream("std_msgs/String");
@@ -31,6 +76,28 @@ TEST(RosbagOutputStream, constructor_correctly_initializes_ros_message_type)
   EXPECT_THAT(data_type, StrEq("std_msgs/String"));
 }
 
+TEST(RosbagOutputStream, constructor_with_converter_writes_compact_type_header)
+{
+  auto converter = rosbag2_bag_v2_plugins::resolve_converter_handle("std_msgs/String");
+  ASSERT_THAT(converter, NotNull());
+
+  auto rosbag_output_stream = RosbagOutputStream(*converter, 10);
+  auto data_pointer = rosbag_output_stream.advance(10);
+
+  auto serialized_message = rosbag_output_stream.get_content();
+  ASSERT_TRUE(rosbag2_bag_v2_plugins::has_compact_message_header(*serialized_message));
+  EXPECT_THAT(
+    rosbag2_bag_v2_plugins::read_compact_message_header(*serialized_message), Eq(converter->id));
+  EXPECT_THAT(
+    rosbag2_bag_v2_plugins::get_converter_handle(converter->id), Eq(converter));
+  EXPECT_THAT(
+    serialized_message->buffer_length,
+    Eq(rosbag2_bag_v2_plugins::COMPACT_MESSAGE_HEADER_LENGTH + 10));
+  EXPECT_THAT(
+    data_pointer,
+    Eq(serialized_message->buffer + rosbag2_bag_v2_plugins::COMPACT_MESSAGE_HEADER_LENGTH));
+}
+
 TEST(RosbagOutputStream, advance_correctly_make_space_for_message)
 {
   std::string expected_data_type = "std_msgs/String";
@@ -41,7 +108,7 @@ TEST(RosbagOutputStream, advance_correctly_make_space_for_message)
   auto serialized_message = rosbag_output_stream.get_content();
   auto data_type = std::string(reinterpret_cast<char *>(serialized_message->buffer));
   EXPECT_THAT(data_type, StrEq(expected_data_type));
-  EXPECT_THAT(serialized_message->buffer_capacity, Eq(10 + expected_data_type.length() + 1));
+  EXPECT_THAT(serialized_message->buffer_capacity, Ge(10 + expected_data_type.length() + 1));
   EXPECT_THAT(serialized_message->buffer_length, Eq(10 + expected_data_type.length() + 1));
   EXPECT_THAT(data_pointer, Eq(serialized_message->buffer + expected_data_type.length() + 1));
 }
@@ -61,10 +128,54 @@ TEST(RosbagOutputStream, adding_data_to_message_works_correctly)
   auto data_type = std::string(reinterpret_cast<char *>(serialized_message->buffer));
   EXPECT_THAT(data_type, StrEq(expected_data_type));
   EXPECT_THAT(
-    serialized_message->buffer_capacity, Eq(added_data.length() + expected_data_type.length() + 2));
+    serialized_message->buffer_capacity, Ge(added_data.length() + expected_data_type.length() + 2));
   EXPECT_THAT(
     serialized_message->buffer_length, Eq(added_data.length() + expected_data_type.length() + 2));
   auto additional_data_pointer = reinterpret_cast<char *>(
     serialized_message->buffer + expected_data_type.length() + 1);
   EXPECT_THAT(std::string(additional_data_pointer), StrEq(added_data));
 }
+
+TEST(RosbagOutputStream, advance_keeps_already_written_data_when_growing)
+{
+  std::string expected_data_type = "std_msgs/String";
+  auto rosbag_output_stream = RosbagOutputStream(expected_data_type);
+
+  std::string first_part = "first";
+  std::string second_part = "second";
+  memcpy(
+    rosbag_output_stream.advance(first_part.length()), first_part.c_str(), first_part.length());
+  memcpy(
+    rosbag_output_stream.advance(second_part.length() + 1),
+    second_part.c_str(),
+    second_part.length() + 1);
+
+  auto serialized_message = rosbag_output_stream.get_content();
+  EXPECT_THAT(
+    serialized_message->buffer_length,
+    Eq(expected_data_type.length() + 1 + first_part.length() + second_part.length() + 1));
+  auto additional_data_pointer = reinterpret_cast<char *>(
+    serialized_message->buffer + expected_data_type.length() + 1);
+  EXPECT_THAT(std::string(additional_data_pointer), StrEq(first_part + second_part));
+}
+
+TEST(RosbagOutputStream, writing_a_message_of_known_size_allocates_exactly_once)
+{
+  rosbag::Bag bag;
+  bag.open((rcpputils::fs::path(_SRC_RESOURCES_DIR_PATH) / "test_bag.bag").string());
+  rosbag::View view(bag);
+  ASSERT_TRUE(view.begin() != view.end());
+  auto message_instance = *view.begin();
+
+  AllocationCount count;
+  auto rosbag_output_stream = RosbagOutputStream(
+    message_instance.getDataType(), message_instance.size(), make_counting_allocator(count));
+  message_instance.write(rosbag_output_stream);
+
+  EXPECT_THAT(count.allocations, Eq(1u));
+  auto serialized_message = rosbag_output_stream.get_content();
+  EXPECT_THAT(
+    serialized_message->buffer_length,
+    Eq(message_instance.getDataType().length() + 1 + message_instance.size()));
+  bag.close();
+}
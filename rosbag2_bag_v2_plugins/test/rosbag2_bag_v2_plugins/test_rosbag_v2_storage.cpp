@@ -15,14 +15,23 @@
 
 #include <gmock/gmock.h>
 
+#include <algorithm>
+#include <cstring>
+#include <iterator>
 #include <memory>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 #include "rcpputils/filesystem_helper.hpp"
 #include "rosbag2_storage/topic_metadata.hpp"
 #include "rosbag_v2_storage_test_fixture.hpp"
+#include "../../src/rosbag2_bag_v2_plugins/lazy_ros1_message.hpp"
+#include "../../src/rosbag2_bag_v2_plugins/message_type_header.hpp"
 
 using namespace ::testing;  // NOLINT
 using namespace std::chrono_literals;  // NOLINT
@@ -143,3 +152,520 @@ TEST_F(RosbagV2StorageTestFixture, get_topics_and_types_will_only_return_one_ent
     EXPECT_THAT(topic_metadata[i], expected_topic_metadata[i]);
   }
 }
+
+TEST_F(RosbagV2StorageTestFixture, get_metadata_counts_messages_of_all_connections_of_a_topic)
+{
+  bag_path_ = (rcpputils::fs::path(database_path_) / "test_bag_multiple_connections.bag").string();
+  storage_ = std::make_shared<rosbag2_bag_v2_plugins::RosbagV2Storage>();
+  storage_->open(bag_path_, rosbag2_storage::storage_interfaces::IOFlag::READ_ONLY);
+
+  std::vector<rosbag2_storage::TopicInformation> expected_topics_with_message_count = {
+    {{"/rosout", "rcl_interfaces/msg/Log", "rosbag_v2"}, 2},
+    {{"/test_topic", "std_msgs/msg/String", "rosbag_v2"}, 2},
+    {{"/int_test_topic", "std_msgs/msg/Int32", "rosbag_v2"}, 2},
+  };
+
+  auto metadata = storage_->get_metadata();
+
+  EXPECT_THAT(metadata.message_count, Eq(6u));
+  EXPECT_THAT(
+    metadata.topics_with_message_count, ElementsAreArray(expected_topics_with_message_count));
+
+  size_t replayed_messages = 0;
+  while (storage_->has_next()) {
+    storage_->read_next();
+    ++replayed_messages;
+  }
+  EXPECT_THAT(replayed_messages, Eq(6u));
+}
+
+std::shared_ptr<rosbag2_bag_v2_plugins::RosbagV2Storage> open_storage(
+  const std::string & bag_path, const rosbag2_bag_v2_plugins::RosbagV2StorageOptions & options)
+{
+  auto storage = std::make_shared<rosbag2_bag_v2_plugins::RosbagV2Storage>();
+  storage->set_options(options);
+  storage->open(bag_path, rosbag2_storage::storage_interfaces::IOFlag::READ_ONLY);
+  return storage;
+}
+
+std::shared_ptr<rosbag2_bag_v2_plugins::RosbagV2Storage> open_storage(
+  const std::string & bag_path, bool zero_copy)
+{
+  rosbag2_bag_v2_plugins::RosbagV2StorageOptions options;
+  options.zero_copy = zero_copy;
+  return open_storage(bag_path, options);
+}
+
+void expect_same_message_data(
+  std::shared_ptr<rosbag2_storage::SerializedBagMessage> copied_message,
+  std::shared_ptr<rosbag2_storage::SerializedBagMessage> borrowed_message)
+{
+  // Copied messages start with the compact type header, borrowed ones do not
+  const auto & copied_data = *copied_message->serialized_data;
+  const auto & borrowed_data = *borrowed_message->serialized_data;
+  ASSERT_TRUE(rosbag2_bag_v2_plugins::has_compact_message_header(copied_data));
+  auto type_prefix_length = rosbag2_bag_v2_plugins::COMPACT_MESSAGE_HEADER_LENGTH;
+
+  EXPECT_THAT(borrowed_message->topic_name, StrEq(copied_message->topic_name));
+  EXPECT_THAT(borrowed_message->time_stamp, Eq(copied_message->time_stamp));
+  ASSERT_THAT(borrowed_data.buffer_length, Eq(copied_data.buffer_length - type_prefix_length));
+  EXPECT_THAT(
+    memcmp(borrowed_data.buffer, copied_data.buffer + type_prefix_length,
+    borrowed_data.buffer_length), Eq(0));
+}
+
+TEST_F(RosbagV2StorageTestFixture, zero_copy_messages_contain_the_same_data_as_copied_messages)
+{
+  auto copying_storage = open_storage(bag_path_, false);
+  auto zero_copy_storage = open_storage(bag_path_, true);
+
+  while (copying_storage->has_next()) {
+    ASSERT_TRUE(zero_copy_storage->has_next());
+    expect_same_message_data(copying_storage->read_next(), zero_copy_storage->read_next());
+  }
+  EXPECT_FALSE(zero_copy_storage->has_next());
+}
+
+TEST_F(RosbagV2StorageTestFixture, zero_copy_messages_stay_valid_after_the_storage_is_destroyed)
+{
+  auto copying_storage = open_storage(bag_path_, false);
+  auto zero_copy_storage = open_storage(bag_path_, true);
+
+  std::vector<std::shared_ptr<rosbag2_storage::SerializedBagMessage>> borrowed_messages;
+  while (zero_copy_storage->has_next()) {
+    borrowed_messages.push_back(zero_copy_storage->read_next());
+  }
+  zero_copy_storage.reset();
+
+  for (const auto & borrowed_message : borrowed_messages) {
+    ASSERT_TRUE(copying_storage->has_next());
+    expect_same_message_data(copying_storage->read_next(), borrowed_message);
+  }
+}
+
+void expect_same_messages(
+  std::shared_ptr<rosbag2_bag_v2_plugins::RosbagV2Storage> storage,
+  std::shared_ptr<rosbag2_bag_v2_plugins::RosbagV2Storage> other_storage)
+{
+  while (storage->has_next()) {
+    ASSERT_TRUE(other_storage->has_next());
+    auto message = storage->read_next();
+    auto other_message = other_storage->read_next();
+    EXPECT_THAT(other_message->topic_name, StrEq(message->topic_name));
+    EXPECT_THAT(other_message->time_stamp, Eq(message->time_stamp));
+    ASSERT_THAT(
+      other_message->serialized_data->buffer_length, Eq(message->serialized_data->buffer_length));
+    EXPECT_THAT(
+      memcmp(other_message->serialized_data->buffer, message->serialized_data->buffer,
+      message->serialized_data->buffer_length), Eq(0));
+  }
+  EXPECT_FALSE(other_storage->has_next());
+}
+
+TEST_F(RosbagV2StorageTestFixture, prefetching_chunks_does_not_change_the_messages_read)
+{
+  bag_path_ = (rcpputils::fs::path(database_path_) / "test_bag_multiple_connections.bag").string();
+  rosbag2_bag_v2_plugins::RosbagV2StorageOptions prefetch_options;
+  prefetch_options.prefetch_chunks = 2;
+  prefetch_options.prefetch_threads = 2;
+
+  expect_same_messages(open_storage(bag_path_, false), open_storage(bag_path_, prefetch_options));
+}
+
+TEST_F(RosbagV2StorageTestFixture, bulk_reading_does_not_change_the_messages_read)
+{
+  bag_path_ = (rcpputils::fs::path(database_path_) / "test_bag_multiple_connections.bag").string();
+  rosbag2_bag_v2_plugins::RosbagV2StorageOptions bulk_options;
+  bulk_options.bulk_read = true;
+
+  expect_same_messages(open_storage(bag_path_, false), open_storage(bag_path_, bulk_options));
+}
+
+TEST_F(RosbagV2StorageTestFixture, memory_mapped_reading_does_not_change_the_messages_read)
+{
+  bag_path_ = (rcpputils::fs::path(database_path_) / "test_bag_multiple_connections.bag").string();
+  rosbag2_bag_v2_plugins::RosbagV2StorageOptions memory_map_options;
+  memory_map_options.memory_map = true;
+  rosbag2_bag_v2_plugins::RosbagV2StorageOptions prefetch_options = memory_map_options;
+  prefetch_options.prefetch_chunks = 2;
+
+  expect_same_messages(open_storage(bag_path_, false), open_storage(bag_path_, memory_map_options));
+  expect_same_messages(open_storage(bag_path_, false), open_storage(bag_path_, prefetch_options));
+}
+
+TEST_F(RosbagV2StorageTestFixture, fast_opened_bags_have_the_same_topics_and_messages)
+{
+  bag_path_ = (rcpputils::fs::path(database_path_) / "test_bag_multiple_connections.bag").string();
+  rosbag2_bag_v2_plugins::RosbagV2StorageOptions fast_open_options;
+  fast_open_options.fast_open = true;
+  auto storage = open_storage(bag_path_, false);
+  auto fast_opened_storage = open_storage(bag_path_, fast_open_options);
+
+  // Listed without reading the chunk infos, which the metadata counts messages with
+  EXPECT_THAT(
+    fast_opened_storage->get_all_topics_and_types(),
+    ElementsAreArray(storage->get_all_topics_and_types()));
+  expect_same_messages(storage, fast_opened_storage);
+  EXPECT_THAT(
+    fast_opened_storage->get_metadata().topics_with_message_count,
+    ElementsAreArray(storage->get_metadata().topics_with_message_count));
+}
+
+TEST_F(RosbagV2StorageTestFixture, zero_copy_messages_can_point_into_the_memory_mapped_bag)
+{
+  rosbag2_bag_v2_plugins::RosbagV2StorageOptions options;
+  options.zero_copy = true;
+  options.memory_map = true;
+  auto copying_storage = open_storage(bag_path_, false);
+  auto zero_copy_storage = open_storage(bag_path_, options);
+
+  std::vector<std::shared_ptr<rosbag2_storage::SerializedBagMessage>> borrowed_messages;
+  while (zero_copy_storage->has_next()) {
+    borrowed_messages.push_back(zero_copy_storage->read_next());
+  }
+  zero_copy_storage.reset();
+
+  for (const auto & borrowed_message : borrowed_messages) {
+    ASSERT_TRUE(copying_storage->has_next());
+    expect_same_message_data(copying_storage->read_next(), borrowed_message);
+  }
+}
+
+std::vector<std::pair<std::string, rcutils_time_point_value_t>> read_topics_and_time_stamps(
+  rosbag2_bag_v2_plugins::RosbagV2Storage & storage)
+{
+  std::vector<std::pair<std::string, rcutils_time_point_value_t>> topics_and_time_stamps;
+  while (storage.has_next()) {
+    auto message = storage.read_next();
+    topics_and_time_stamps.emplace_back(message->topic_name, message->time_stamp);
+  }
+  return topics_and_time_stamps;
+}
+
+TEST_F(RosbagV2StorageTestFixture, set_filter_only_reads_messages_of_the_given_topics)
+{
+  auto all_messages = read_topics_and_time_stamps(*open_storage(bag_path_, false));
+  auto test_topic_message = std::find_if(
+    all_messages.begin(), all_messages.end(),
+    [](const std::pair<std::string, rcutils_time_point_value_t> & message) {
+      return message.first == "/test_topic";
+    });
+  ASSERT_THAT(test_topic_message, Ne(all_messages.end()));
+
+  storage_->set_filter({"/test_topic"});
+
+  std::vector<std::string> topics_read;
+  while (storage_->has_next()) {
+    topics_read.push_back(storage_->read_next()->topic_name);
+  }
+  EXPECT_THAT(topics_read, ElementsAre("/test_topic"));
+
+  // Reading continues after the message read last
+  storage_->reset_filter();
+  EXPECT_THAT(
+    read_topics_and_time_stamps(*storage_),
+    ElementsAreArray(std::vector<std::pair<std::string, rcutils_time_point_value_t>>(
+      test_topic_message + 1, all_messages.end())));
+}
+
+TEST_F(RosbagV2StorageTestFixture, set_filter_continues_after_the_message_read_last)
+{
+  auto all_messages = read_topics_and_time_stamps(*open_storage(bag_path_, false));
+  ASSERT_THAT(all_messages, SizeIs(Gt(2u)));
+  auto filtered_topic = all_messages[0].first;
+
+  storage_->read_next();
+  storage_->set_filter({filtered_topic});
+  auto filtered_messages = read_topics_and_time_stamps(*storage_);
+
+  std::vector<std::pair<std::string, rcutils_time_point_value_t>> expected_messages;
+  std::copy_if(
+    all_messages.begin() + 1, all_messages.end(), std::back_inserter(expected_messages),
+    [&filtered_topic](const std::pair<std::string, rcutils_time_point_value_t> & message) {
+      return message.first == filtered_topic;
+    });
+  EXPECT_THAT(filtered_messages, ElementsAreArray(expected_messages));
+
+  // Seeking drops the position, filtering again starts at the time stamp seeked to
+  storage_->seek(all_messages[1].second);
+  storage_->reset_filter();
+  auto first_message = std::find_if(
+    all_messages.begin(), all_messages.end(),
+    [&all_messages](const std::pair<std::string, rcutils_time_point_value_t> & message) {
+      return message.second >= all_messages[1].second;
+    });
+  EXPECT_THAT(
+    read_topics_and_time_stamps(*storage_),
+    ElementsAreArray(std::vector<std::pair<std::string, rcutils_time_point_value_t>>(
+      first_message, all_messages.end())));
+}
+
+TEST_F(RosbagV2StorageTestFixture, seek_continues_at_the_first_message_not_before_the_given_time)
+{
+  std::vector<rcutils_time_point_value_t> time_stamps;
+  while (storage_->has_next()) {
+    time_stamps.push_back(storage_->read_next()->time_stamp);
+  }
+  ASSERT_THAT(time_stamps, SizeIs(Gt(2u)));
+
+  storage_->seek(time_stamps[2]);
+
+  std::vector<rcutils_time_point_value_t> time_stamps_after_seek;
+  while (storage_->has_next()) {
+    time_stamps_after_seek.push_back(storage_->read_next()->time_stamp);
+  }
+  EXPECT_THAT(
+    time_stamps_after_seek,
+    ElementsAreArray(std::vector<rcutils_time_point_value_t>(
+      time_stamps.begin() + 2, time_stamps.end())));
+}
+
+TEST_F(RosbagV2StorageTestFixture, seeking_back_with_chunk_cache_reads_the_cached_chunks_again)
+{
+  rosbag2_bag_v2_plugins::RosbagV2StorageOptions cached_options;
+  cached_options.chunk_cache_chunks = 16;
+  auto storage = open_storage(bag_path_, cached_options);
+
+  std::vector<rcutils_time_point_value_t> time_stamps;
+  while (storage->has_next()) {
+    time_stamps.push_back(storage->read_next()->time_stamp);
+  }
+  ASSERT_THAT(time_stamps, SizeIs(Gt(2u)));
+  auto chunks_read = storage->get_statistics().chunks;
+
+  for (auto seek_time : {time_stamps[2], time_stamps[0], time_stamps[1]}) {
+    storage->seek(seek_time);
+    std::vector<rcutils_time_point_value_t> time_stamps_after_seek;
+    while (storage->has_next()) {
+      time_stamps_after_seek.push_back(storage->read_next()->time_stamp);
+    }
+    EXPECT_THAT(
+      time_stamps_after_seek,
+      ElementsAreArray(std::vector<rcutils_time_point_value_t>(
+        std::find(time_stamps.begin(), time_stamps.end(), seek_time), time_stamps.end())));
+  }
+  // Chunks are only counted when read from the file, so none has been decompressed again
+  EXPECT_THAT(storage->get_statistics().chunks, Eq(chunks_read));
+}
+
+TEST_F(RosbagV2StorageTestFixture, readers_of_other_topics_share_the_chunk_cache)
+{
+  rosbag2_bag_v2_plugins::RosbagV2StorageOptions cached_options;
+  cached_options.chunk_cache_chunks = 16;
+  auto storage = open_storage(bag_path_, cached_options);
+  storage->set_filter({"/test_topic"});
+  while (storage->has_next()) {
+    storage->read_next();
+  }
+
+  auto reader = storage->open_reader();
+  reader->set_filter({"/test_topic2"});
+  std::vector<std::string> topics_read;
+  while (reader->has_next()) {
+    topics_read.push_back(reader->read_next()->topic_name);
+  }
+  EXPECT_THAT(topics_read, ElementsAre("/test_topic2"));
+  // The chunk read by the first storage is not read again
+  EXPECT_THAT(reader->get_statistics().chunks, Eq(0u));
+}
+
+TEST_F(RosbagV2StorageTestFixture, read_next_batch_reads_the_same_messages_as_read_next)
+{
+  auto storage = open_storage(bag_path_, false);
+  auto batch_storage = open_storage(bag_path_, false);
+
+  std::vector<std::shared_ptr<rosbag2_storage::SerializedBagMessage>> batch;
+  EXPECT_THAT(batch_storage->read_next_batch(2, 1024 * 1024, batch), Eq(2u));
+  EXPECT_THAT(batch_storage->read_next_batch(100, 1024 * 1024, batch), Eq(3u));
+  EXPECT_THAT(batch_storage->read_next_batch(100, 1024 * 1024, batch), Eq(0u));
+  ASSERT_THAT(batch, SizeIs(5u));
+
+  for (const auto & batch_message : batch) {
+    ASSERT_TRUE(storage->has_next());
+    auto message = storage->read_next();
+    EXPECT_THAT(batch_message->topic_name, StrEq(message->topic_name));
+    EXPECT_THAT(batch_message->time_stamp, Eq(message->time_stamp));
+    ASSERT_THAT(
+      batch_message->serialized_data->buffer_length, Eq(message->serialized_data->buffer_length));
+    EXPECT_THAT(
+      memcmp(batch_message->serialized_data->buffer, message->serialized_data->buffer,
+      message->serialized_data->buffer_length), Eq(0));
+  }
+}
+
+TEST_F(RosbagV2StorageTestFixture, read_next_batch_ends_with_the_message_reaching_max_bytes)
+{
+  std::vector<std::shared_ptr<rosbag2_storage::SerializedBagMessage>> batch;
+  EXPECT_THAT(storage_->read_next_batch(100, 1, batch), Eq(1u));
+  EXPECT_THAT(storage_->read_next_batch(100, 0, batch), Eq(0u));
+  EXPECT_THAT(batch, SizeIs(1u));
+}
+
+TEST_F(RosbagV2StorageTestFixture, pooled_messages_contain_the_same_data_as_allocated_messages)
+{
+  rosbag2_bag_v2_plugins::RosbagV2StorageOptions pool_options;
+  pool_options.message_pool = true;
+  auto pooled_storage = open_storage(bag_path_, pool_options);
+
+  expect_same_messages(open_storage(bag_path_, false), pooled_storage);
+
+  auto statistics = pooled_storage->get_message_pool_statistics();
+  EXPECT_THAT(statistics.hits, Gt(0u));
+  EXPECT_THAT(statistics.bytes_held, Gt(0u));
+}
+
+TEST_F(RosbagV2StorageTestFixture, statistics_count_the_messages_read_if_compiled_in)
+{
+  while (storage_->has_next()) {
+    storage_->read_next();
+  }
+
+  auto statistics = storage_->get_statistics();
+  if (rosbag2_bag_v2_plugins::STATISTICS_ENABLED) {
+    ASSERT_THAT(statistics.topics.count("/test_topic"), Eq(1u));
+    EXPECT_THAT(statistics.topics.at("/test_topic").messages, Eq(1u));
+    EXPECT_THAT(statistics.topics.at("/test_topic").bytes, Gt(0u));
+    EXPECT_THAT(statistics.allocations, Gt(0u));
+  } else {
+    EXPECT_THAT(statistics.topics, IsEmpty());
+    EXPECT_THAT(statistics.chunks, Eq(0u));
+    EXPECT_THAT(statistics.allocations, Eq(0u));
+  }
+
+  std::ostringstream summary;
+  summary << statistics;
+  EXPECT_THAT(summary.str(), StartsWith("Read "));
+}
+
+TEST_F(RosbagV2StorageTestFixture, cdr_messages_are_transcoded_from_the_ros1_messages)
+{
+  rosbag2_bag_v2_plugins::RosbagV2StorageOptions cdr_options;
+  cdr_options.serialization_format = "cdr";
+  auto cdr_storage = open_storage(bag_path_, cdr_options);
+  auto storage = open_storage(bag_path_, false);
+  cdr_storage->set_filter({"/test_topic"});
+  storage->set_filter({"/test_topic"});
+
+  for (const auto & topic : cdr_storage->get_metadata().topics_with_message_count) {
+    EXPECT_THAT(topic.topic_metadata.serialization_format, StrEq("cdr"));
+  }
+
+  ASSERT_TRUE(cdr_storage->has_next());
+  ASSERT_TRUE(storage->has_next());
+  auto cdr_message = cdr_storage->read_next();
+  auto message = storage->read_next();
+  EXPECT_THAT(cdr_message->topic_name, StrEq(message->topic_name));
+  EXPECT_THAT(cdr_message->time_stamp, Eq(message->time_stamp));
+
+  // A std_msgs/String is a length-prefixed string in ROS 1 and a null-terminated one in CDR
+  const auto & ros1_data = *message->serialized_data;
+  const auto & cdr_data = *cdr_message->serialized_data;
+  auto ros1_string = ros1_data.buffer + rosbag2_bag_v2_plugins::COMPACT_MESSAGE_HEADER_LENGTH + 4;
+  auto string_length =
+    static_cast<size_t>(ros1_data.buffer + ros1_data.buffer_length - ros1_string);
+  ASSERT_THAT(cdr_data.buffer_length, Eq(4 + 4 + string_length + 1));
+  EXPECT_THAT(
+    std::vector<uint8_t>(cdr_data.buffer, cdr_data.buffer + 8),
+    ElementsAre(0x00, 0x01, 0x00, 0x00, string_length + 1, 0x00, 0x00, 0x00));
+  EXPECT_THAT(memcmp(cdr_data.buffer + 8, ros1_string, string_length), Eq(0));
+  EXPECT_THAT(cdr_data.buffer[8 + string_length], Eq('\0'));
+}
+
+TEST_F(RosbagV2StorageTestFixture, readers_opened_from_a_storage_read_the_same_messages)
+{
+  bag_path_ = (rcpputils::fs::path(database_path_) / "test_bag_multiple_connections.bag").string();
+  auto storage = open_storage(bag_path_, false);
+  std::shared_ptr<rosbag2_bag_v2_plugins::RosbagV2Storage> reader = storage->open_reader();
+
+  expect_same_messages(open_storage(bag_path_, false), reader);
+  EXPECT_TRUE(storage->has_next());
+}
+
+TEST_F(RosbagV2StorageTestFixture, readers_opened_from_a_storage_can_be_read_concurrently)
+{
+  auto reader = storage_->open_reader();
+  reader->set_filter({"/test_topic"});
+
+  std::vector<std::string> topics_read_by_reader;
+  std::thread reader_thread([&reader, &topics_read_by_reader]() {
+      while (reader->has_next()) {
+        topics_read_by_reader.push_back(reader->read_next()->topic_name);
+      }
+    });
+  size_t messages_read = 0;
+  while (storage_->has_next()) {
+    storage_->read_next();
+    ++messages_read;
+  }
+  reader_thread.join();
+
+  EXPECT_THAT(topics_read_by_reader, ElementsAre("/test_topic"));
+  EXPECT_THAT(messages_read, Eq(storage_->get_metadata().message_count));
+}
+
+TEST_F(RosbagV2StorageTestFixture, lazy_messages_expose_the_ros1_data_without_converting_it)
+{
+  auto copying_storage = open_storage(bag_path_, false);
+  auto zero_copy_storage = open_storage(bag_path_, true);
+  copying_storage->set_filter({"/test_topic"});
+  zero_copy_storage->set_filter({"/test_topic"});
+  ASSERT_TRUE(copying_storage->has_next());
+  ASSERT_TRUE(zero_copy_storage->has_next());
+
+  rosbag2_bag_v2_plugins::LazyRos1Message copied_message(copying_storage->read_next());
+  rosbag2_bag_v2_plugins::LazyRos1Message borrowed_message(zero_copy_storage->read_next());
+
+  EXPECT_THAT(copied_message.get_ros1_type_name(), StrEq("std_msgs/String"));
+  EXPECT_THAT(copied_message.get_ros2_type_name(), StrEq("std_msgs/msg/String"));
+  ASSERT_THAT(copied_message.get_ros1_data_length(), Eq(borrowed_message.get_ros1_data_length()));
+  EXPECT_THAT(
+    memcmp(
+      copied_message.get_ros1_data(), borrowed_message.get_ros1_data(),
+      copied_message.get_ros1_data_length()), Eq(0));
+  EXPECT_FALSE(copied_message.is_converted());
+}
+
+TEST_F(RosbagV2StorageTestFixture, lazy_messages_are_converted_once_on_first_access)
+{
+  storage_->set_filter({"/test_topic"});
+  ASSERT_TRUE(storage_->has_next());
+  rosbag2_bag_v2_plugins::LazyRos1Message message(storage_->read_next());
+
+  auto ros2_message = message.get_ros2_message();
+
+  ASSERT_THAT(ros2_message, NotNull());
+  EXPECT_TRUE(message.is_converted());
+  EXPECT_THAT(ros2_message->topic_name, StrEq("/test_topic"));
+  EXPECT_THAT(message.get_ros2_message(), Eq(ros2_message));
+}
+
+TEST(LazyRos1Message, throws_if_the_data_is_not_a_rosbag_v2_message)
+{
+  auto serialized_message = std::make_shared<rosbag2_storage::SerializedBagMessage>();
+  serialized_message->topic_name = "/test_topic";
+  serialized_message->serialized_data = std::make_shared<rcutils_uint8_array_t>();
+  uint8_t data[] = {'n', 'o', ' ', 't', 'y', 'p', 'e'};
+  serialized_message->serialized_data->buffer = data;
+  serialized_message->serialized_data->buffer_length = sizeof(data);
+
+  EXPECT_THROW(
+    rosbag2_bag_v2_plugins::LazyRos1Message message(serialized_message), std::runtime_error);
+}
+
+TEST_F(RosbagV2StorageTestFixture, get_ros1_connection_returns_the_connection_of_a_topic)
+{
+  auto connection = storage_->get_ros1_connection("/test_topic");
+
+  ASSERT_THAT(connection, NotNull());
+  EXPECT_THAT(connection->datatype, StrEq("std_msgs/String"));
+  EXPECT_THAT(connection->md5sum, StrEq("992ce8a1687cec8c8bd883ec73ca41d1"));
+  EXPECT_THAT(connection->message_definition, HasSubstr("string data"));
+  EXPECT_THAT(storage_->get_ros1_connection("/not_in_the_bag"), IsNull());
+}
+
+TEST(RosbagV2Storage, open_reader_throws_if_the_storage_is_not_open)
+{
+  rosbag2_bag_v2_plugins::RosbagV2Storage storage;
+
+  EXPECT_THROW(storage.open_reader(), std::runtime_error);
+}
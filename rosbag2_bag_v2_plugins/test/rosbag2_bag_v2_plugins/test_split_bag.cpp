@@ -0,0 +1,172 @@
+// Copyright 2018, Bosch Software Innovations GmbH.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <gmock/gmock.h>
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "rcpputils/filesystem_helper.hpp"
+#include "rcutils/filesystem.h"
+#include "rosbag2_test_common/temporary_directory_fixture.hpp"
+
+#include "rosbag2_bag_v2_plugins/storage/bag_index.hpp"
+#include "rosbag2_bag_v2_plugins/storage/bag_message_cursor.hpp"
+#include "rosbag2_bag_v2_plugins/storage/rosbag_v2_storage.hpp"
+#include "rosbag2_bag_v2_plugins/storage/split_bag.hpp"
+
+using namespace ::testing;  // NOLINT
+using rosbag2_bag_v2_plugins::BagIndex;
+
+class SplitBagTestFixture : public TemporaryDirectoryFixture
+{
+public:
+  SplitBagTestFixture()
+  {
+    // Two bags recorded at different times stand in for the files of a split bag
+    copy_resource("test_bag_multiple_connections.bag", "split_2.bag");
+    copy_resource("test_bag.bag", "split_10.bag");
+    write_file("notes.txt");
+  }
+
+  std::string path_of(const std::string & name)
+  {
+    return (rcpputils::fs::path(temporary_dir_path_) / name).string();
+  }
+
+  void copy_resource(const std::string & resource, const std::string & name)
+  {
+    std::ifstream source(
+      (rcpputils::fs::path(_SRC_RESOURCES_DIR_PATH) / resource).string(), std::ios::binary);
+    std::ofstream destination(path_of(name), std::ios::binary);
+    destination << source.rdbuf();
+  }
+
+  void write_file(const std::string & name)
+  {
+    std::ofstream file(path_of(name));
+    file << "not a bag";
+  }
+
+  size_t count_messages(const std::string & resource)
+  {
+    rosbag2_bag_v2_plugins::RosbagV2Storage storage;
+    storage.open(
+      (rcpputils::fs::path(_SRC_RESOURCES_DIR_PATH) / resource).string(),
+      rosbag2_storage::storage_interfaces::IOFlag::READ_ONLY);
+    return storage.get_metadata().message_count;
+  }
+};
+
+TEST(SplitBag, file_names_are_ordered_by_the_numbers_in_them)
+{
+  std::vector<std::string> names = {"run_10.bag", "run_2.bag", "run_1.bag", "other_0.bag"};
+
+  std::sort(names.begin(), names.end(), &rosbag2_bag_v2_plugins::compare_split_bag_file_names);
+
+  EXPECT_THAT(names, ElementsAre("other_0.bag", "run_1.bag", "run_2.bag", "run_10.bag"));
+}
+
+TEST_F(SplitBagTestFixture, a_directory_refers_to_its_bag_files_in_split_order)
+{
+  EXPECT_THAT(
+    rosbag2_bag_v2_plugins::find_split_bag_files(temporary_dir_path_),
+    ElementsAre(path_of("split_2.bag"), path_of("split_10.bag")));
+}
+
+TEST_F(SplitBagTestFixture, a_pattern_refers_to_the_matching_files)
+{
+  EXPECT_THAT(
+    rosbag2_bag_v2_plugins::find_split_bag_files(path_of("split_1*.bag")),
+    ElementsAre(path_of("split_10.bag")));
+  EXPECT_THAT(
+    rosbag2_bag_v2_plugins::find_split_bag_files(path_of("split_?.bag")),
+    ElementsAre(path_of("split_2.bag")));
+  EXPECT_THROW(
+    rosbag2_bag_v2_plugins::find_split_bag_files(path_of("missing_*.bag")), std::runtime_error);
+}
+
+TEST_F(SplitBagTestFixture, merged_index_keeps_the_connections_of_the_files_apart)
+{
+  auto first_index = BagIndex::read(path_of("split_2.bag"));
+  auto second_index = BagIndex::read(path_of("split_10.bag"));
+  auto index = rosbag2_bag_v2_plugins::read_split_bag_index(
+    rosbag2_bag_v2_plugins::find_split_bag_files(temporary_dir_path_), &BagIndex::read);
+
+  ASSERT_THAT(index->get_file_count(), Eq(2u));
+  EXPECT_THAT(index->get_file_path(1), StrEq(path_of("split_10.bag")));
+  ASSERT_THAT(
+    index->get_connections(),
+    SizeIs(first_index->get_connections().size() + second_index->get_connections().size()));
+  auto offset = index->get_connection_id_offset(1);
+  for (const auto & connection : second_index->get_connections()) {
+    auto merged_connection = index->get_connection(connection.id + offset);
+    ASSERT_THAT(merged_connection, NotNull());
+    EXPECT_THAT(merged_connection->topic, StrEq(connection.topic));
+  }
+  for (const auto & chunk_info : index->get_chunk_infos()) {
+    EXPECT_THAT(chunk_info.file_index, Lt(2u));
+  }
+}
+
+TEST_F(SplitBagTestFixture, messages_of_all_files_are_read_in_time_stamp_order)
+{
+  auto index = rosbag2_bag_v2_plugins::read_split_bag_index(
+    rosbag2_bag_v2_plugins::find_split_bag_files(temporary_dir_path_), &BagIndex::read);
+  std::unordered_set<uint32_t> connection_ids;
+  for (const auto & connection : index->get_connections()) {
+    connection_ids.insert(connection.id);
+  }
+
+  for (size_t read_ahead : {0u, 2u}) {
+    rosbag2_bag_v2_plugins::BagMessageCursor cursor(index, connection_ids, 0, read_ahead, 2);
+    std::vector<uint64_t> time_stamps;
+    while (cursor.has_next()) {
+      auto message = cursor.next();
+      EXPECT_THAT(index->get_connection(message.message->connection_id), NotNull());
+      time_stamps.push_back(message.message->time);
+    }
+
+    auto message_count =
+      count_messages("test_bag.bag") + count_messages("test_bag_multiple_connections.bag");
+    EXPECT_THAT(time_stamps, SizeIs(message_count));
+    EXPECT_TRUE(std::is_sorted(time_stamps.begin(), time_stamps.end()));
+  }
+}
+
+TEST_F(SplitBagTestFixture, storage_reads_a_split_bag_as_one_bag)
+{
+  rosbag2_bag_v2_plugins::RosbagV2Storage storage;
+  storage.open(temporary_dir_path_, rosbag2_storage::storage_interfaces::IOFlag::READ_ONLY);
+
+  auto metadata = storage.get_metadata();
+  EXPECT_THAT(metadata.relative_file_paths, SizeIs(1));
+  EXPECT_THAT(
+    metadata.bag_size,
+    Eq(rcutils_get_file_size(path_of("split_2.bag").c_str()) +
+    rcutils_get_file_size(path_of("split_10.bag").c_str())));
+
+  size_t messages_read = 0;
+  while (storage.has_next()) {
+    storage.read_next();
+    ++messages_read;
+  }
+  EXPECT_THAT(messages_read, Eq(metadata.message_count));
+}